@@ -1,73 +1,6 @@
 #version 330 core
 
-struct raytMaterial {
-	vec3 color;
-	vec3 absorb;
-
-	float diffuse;
-	float reflection;
-	float refraction;
-	int specular;
-	float kd;
-	float ks;
-};
-
-struct raytScene {
-	vec4 quat_camera_rotation;
-	vec3 camera_pos;
-	vec3 bg_color;
-
-	int canvas_width;
-	int canvas_height;
-
-	int reflect_depth;
-};
-
-struct raytLightDirect {
-	vec3 direction;
-	vec3 color;
-
-	float intensity;
-};
-
-struct raytLightPoint {
-	vec4 pos; //pos + radius
-	vec3 color;
-	float intensity;
-
-	float linear_k;
-	float quadratic_k;
-};
-
-struct raytSphere {
-	raytMaterial mat;
-	vec4 obj;
-	vec4 quat_rotation; // rotate normal
-	int textureNum;
-	bool hollow;
-};
-
-struct raytBox {
-	raytMaterial mat;
-	vec4 quat_rotation;
-	vec3 pos;
-	vec3 form;
-	int textureNum;
-};
-
-struct raytSurface {
-	raytMaterial mat;
-	vec4 quat_rotation;
-	vec3 v_min;
-	vec3 v_max;
-	vec3 pos;
-	float a; // x2
-	float b; // y2
-	float c; // z2
-	float d; // z
-	float e; // y
-	float f; // const	
-};
+#include "scene_types.glsl"
 
 struct hitRecord {
 	raytMaterial mat;
@@ -76,16 +9,33 @@ struct hitRecord {
 	float alpha;
 };
 
-int Total_Internal_Reflection = 1;
-int Do_Fresnel = 1;
-int Reflect_Reduce_Iteration = 1;
-int Shadow_Enabled = 1;
+// the variant, 0 or 1 each, see shaderFeatures
+{FEATURES}
 
 out vec4 FragColor;
 
-uniform sampler2D texture_sphere_1;
-
-uniform sampler2D texture_box;
+// textures of the same size share an array, see Texture_Arrays
+uniform sampler2DArray texture_array_0;
+uniform sampler2DArray texture_array_1;
+uniform sampler2DArray texture_array_2;
+uniform sampler2DArray texture_array_3;
+uniform sampler2DArray texture_array_4;
+uniform sampler2DArray texture_array_5;
+uniform sampler2DArray texture_array_6;
+uniform isamplerBuffer texture_slots; // per textureNum - 1: array, layer, array -1 is the virtual texture
+
+// virtual texture, see Virtual_Texture
+uniform sampler2D vt_cache; // resident tiles with their borders, one per page
+uniform usamplerBuffer vt_indirection; // per tile of every level: page x, page y, resident
+uniform ivec4 vt_params; // width, height, tile size, border
+uniform int vt_levels;
+uniform int feedback_pass; // 0 for the image, else the downscale of the feedback pass
+
+uniform samplerBuffer mesh_vertices;
+uniform isamplerBuffer mesh_triangles;
+uniform samplerBuffer mesh_nodes; // 2 texels per node: bmin + left_first, bmax + count
+uniform samplerBuffer mesh_instances; // 4 texels per instance, see get_Mesh_Instance()
+uniform samplerBuffer instance_nodes; // top level bvh over the instances, same node layout
 
 #define DBG 0
 #define DBG_First_Value 1
@@ -132,10 +82,10 @@ layout( std140 ) uniform spheres_buf
 #define Surface_Size {SURFACE_SIZE}
 layout( std140 ) uniform surfaces_buf
 {
-	#if Suface_Size == 0
+	#if Surface_Size == 0
 	raytSurface surfaces[1];
 	#else
-	raytSurface surfaces[Suface_Size];
+	raytSurface surfaces[Surface_Size];
 	#endif
 };
 
@@ -149,6 +99,58 @@ layout( std140 ) uniform boxes_buf
 	#endif
 };
 
+// packed copies read by the intersection loops, see Scene_Geometry
+layout( std140 ) uniform sphere_geo_buf
+{
+	#if Sphere_Size == 0
+	vec4 sphere_geo[1];
+	#else
+	vec4 sphere_geo[Sphere_Size]; // center + radius, negative radius for hollow spheres
+	#endif
+};
+
+#define Sphere_Rotation_Stride 3
+layout( std140 ) uniform sphere_rotation_buf
+{
+	#if Sphere_Size == 0
+	vec4 sphere_rotation[1];
+	#else
+	vec4 sphere_rotation[Sphere_Size * Sphere_Rotation_Stride]; // world to sphere rows
+	#endif
+};
+
+#define Box_Stride 4
+layout( std140 ) uniform box_geo_buf
+{
+	#if Box_Size == 0
+	vec4 box_geo[1];
+	#else
+	vec4 box_geo[Box_Size * Box_Stride]; // world to box rows with translation in w, form
+	#endif
+};
+
+#define Surface_Stride 6
+layout( std140 ) uniform surface_geo_buf
+{
+	#if Surface_Size == 0
+	vec4 surface_geo[1];
+	#else
+	vec4 surface_geo[Surface_Size * Surface_Stride]; // world to surface rows with translation in w, (a, b, c, d), v_min + e, v_max + f
+	#endif
+};
+
+#define Material_Size {MATERIAL_SIZE}
+layout( std140 ) uniform materials_buf
+{
+	#if Material_Size == 0
+	raytMaterial materials[1];
+	#else
+	raytMaterial materials[Material_Size];
+	#endif
+};
+
+#define Mesh_Instance_Size {MESH_INSTANCE_SIZE}
+
 int swap_xy(inout float x, inout float y)
 {
 	float temp = x;
@@ -185,7 +187,8 @@ vec3 get_Ray_Dir()
 {
     int cw = scene.canvas_width;
     int ch = scene.canvas_height;
-	vec3 result = vec3((gl_FragCoord.xy - vec2(cw, ch) / 2) / ch, 1);
+	vec2 frag_coord = gl_FragCoord.xy * float(max(feedback_pass, 1));
+	vec3 result = vec3((frag_coord - vec2(cw, ch) / 2) / ch, 1);
 	vec3 normalized_result = normalize(rotate(scene.quat_camera_rotation, result));
 	return normalized_result;
 }
@@ -235,10 +238,108 @@ int _dbg(vec3 value)
 	return 0;
 }
 
-vec4 Sphere_Texture(vec3 sphereNormal, vec4 quat, int texNum) {
-	if (quat != vec4(0,0,0,1)) {
-		sphereNormal = rotate(quat, sphereNormal);
+vec4 vt_feedback = vec4(0); // first tile this pixel asked for, the feedback pass output
+
+// begin texture section
+#if Has_Textures
+
+// nearest mip, from the cache page of the tile or the closest coarser level that is resident
+vec4 sample_Virtual(vec2 uv, float lod)
+{
+	// the feedback pass has fewer, larger pixels
+	lod -= log2(float(max(feedback_pass, 1)));
+	int mip = clamp(int(lod + 0.5), 0, vt_levels - 1);
+	int tile_size = vt_params.z;
+	int page_size = tile_size + 2 * vt_params.w;
+	uv = fract(uv);
+
+	int first = 0;
+	for (int level = 0; level < mip; level++)
+	{
+		ivec2 tiles = (max(vt_params.xy >> level, ivec2(1)) + tile_size - 1) / tile_size;
+		first += tiles.x * tiles.y;
+	}
+
+	for (int level = mip; level < vt_levels; level++)
+	{
+		ivec2 size = max(vt_params.xy >> level, ivec2(1));
+		ivec2 tiles = (size + tile_size - 1) / tile_size;
+		vec2 texel = uv * vec2(size);
+		ivec2 tile = min(ivec2(texel) / tile_size, tiles - 1);
+		if (level == mip && vt_feedback.a == 0)
+			vt_feedback = vec4(tile & 255, (tile.x >> 8) | ((tile.y >> 8) << 4), level + 1) / 255.0;
+
+		uvec4 entry = texelFetch(vt_indirection, first + tile.y * tiles.x + tile.x);
+		if (entry.z != 0u)
+		{
+			vec2 p = vec2(entry.xy) * float(page_size) + float(vt_params.w) + texel - vec2(tile * tile_size);
+			return textureLod(vt_cache, p / vec2(textureSize(vt_cache, 0)), 0);
+		}
+		first += tiles.x * tiles.y;
 	}
+	return vec4(0.5, 0.5, 0.5, 1);
+}
+
+ivec2 get_Texture_Slot(int texNum)
+{
+	return texelFetch(texture_slots, texNum - 1).xy;
+}
+
+// sampler arrays can only be indexed with constants in GLSL 3.30
+vec2 get_Texture_Size(ivec2 slot)
+{
+	switch (slot.x)
+	{
+	case -1: return vec2(vt_params.xy);
+	case 0: return vec2(textureSize(texture_array_0, 0).xy);
+	case 1: return vec2(textureSize(texture_array_1, 0).xy);
+	case 2: return vec2(textureSize(texture_array_2, 0).xy);
+	case 3: return vec2(textureSize(texture_array_3, 0).xy);
+	case 4: return vec2(textureSize(texture_array_4, 0).xy);
+	case 5: return vec2(textureSize(texture_array_5, 0).xy);
+	case 6: return vec2(textureSize(texture_array_6, 0).xy);
+	}
+	return vec2(1);
+}
+
+vec4 sample_Texture(ivec2 slot, vec2 uv)
+{
+	vec3 p = vec3(uv, slot.y);
+	switch (slot.x)
+	{
+	case -1: return sample_Virtual(uv, 0);
+	case 0: return texture(texture_array_0, p);
+	case 1: return texture(texture_array_1, p);
+	case 2: return texture(texture_array_2, p);
+	case 3: return texture(texture_array_3, p);
+	case 4: return texture(texture_array_4, p);
+	case 5: return texture(texture_array_5, p);
+	case 6: return texture(texture_array_6, p);
+	}
+	return vec4(0);
+}
+
+vec4 sample_Texture_Lod(ivec2 slot, vec2 uv, float lod)
+{
+	vec3 p = vec3(uv, slot.y);
+	switch (slot.x)
+	{
+	case -1: return sample_Virtual(uv, lod);
+	case 0: return textureLod(texture_array_0, p, lod);
+	case 1: return textureLod(texture_array_1, p, lod);
+	case 2: return textureLod(texture_array_2, p, lod);
+	case 3: return textureLod(texture_array_3, p, lod);
+	case 4: return textureLod(texture_array_4, p, lod);
+	case 5: return textureLod(texture_array_5, p, lod);
+	case 6: return textureLod(texture_array_6, p, lod);
+	}
+	return vec4(0);
+}
+
+vec4 Sphere_Texture(vec3 sphereNormal, int num, int texNum) {
+	int r = num * Sphere_Rotation_Stride;
+	sphereNormal = vec3(dot(sphere_rotation[r].xyz, sphereNormal), dot(sphere_rotation[r + 1].xyz, sphereNormal),
+						dot(sphere_rotation[r + 2].xyz, sphereNormal));
 	float Pi = 3.14159265358979;
 	float u = 0.5 + atan(sphereNormal.z, sphereNormal.x) / (2.*Pi);
 	float v = 0.5 - asin(sphereNormal.y) / Pi;
@@ -246,13 +347,11 @@ vec4 Sphere_Texture(vec3 sphereNormal, vec4 quat, int texNum) {
 	vec2 df = fwidth(uv);
 	if(df.x > 0.5) df.x = 0.;
 
-	vec4 color;
-	if (texNum == 1) {
-		color = textureLod(texture_sphere_1, uv, log2(max(df.x, df.y)*1024.));
-	}
-
-	return color;
+	ivec2 slot = get_Texture_Slot(texNum);
+	return sample_Texture_Lod(slot, uv, log2(max(df.x, df.y) * get_Texture_Size(slot).x));
 }
+#endif
+// end texture section
 
 bool intersect_Sphere(vec3 ro, vec3 rd, vec4 object, bool hollow, float tmin, out float t)
 {
@@ -271,11 +370,16 @@ vec3 optNormal;
 
 bool intersect_Box(vec3 ro, vec3 rd, int num, float tmin, out float t) 
 {
-	raytBox box = boxes[num];
-
-	// ray-box intersection in box space           
-    vec3 n = (1.0 / (rotate(box.quat_rotation, rd))) * (rotate(box.quat_rotation, ro - box.pos));
-    vec3 k = abs(1.0 / (rotate(box.quat_rotation, rd)))*box.form;             // rotate() -> convert from ray to box space
+	vec4 r0 = box_geo[num * Box_Stride];
+	vec4 r1 = box_geo[num * Box_Stride + 1];
+	vec4 r2 = box_geo[num * Box_Stride + 2];
+	vec3 form = box_geo[num * Box_Stride + 3].xyz;
+
+	// ray-box intersection in box space
+	vec3 d = vec3(dot(r0.xyz, rd), dot(r1.xyz, rd), dot(r2.xyz, rd));
+	vec3 m = 1.0 / d;
+    vec3 n = m * vec3(dot(r0.xyz, ro) + r0.w, dot(r1.xyz, ro) + r1.w, dot(r2.xyz, ro) + r2.w);
+    vec3 k = abs(m) * form;
 	
     vec3 t1 = -n - k;
     vec3 t2 = -n + k;
@@ -286,24 +390,30 @@ bool intersect_Box(vec3 ro, vec3 rd, int num, float tmin, out float t)
 	if ( max( max( t1.x, t1.y ), t1.z ) >= tmin)
 		return false;
 
-	vec3 nor = -sign(rotate(box.quat_rotation, rd)) * step(t1.yzx,t1.xyz) * step(t1.zxy,t1.xyz);
+	vec3 nor = -sign(d) * step(t1.yzx,t1.xyz) * step(t1.zxy,t1.xyz);
 	t = max( max( t1.x, t1.y ), t1.z );
 	// convert to ray space
-	optNormal = rotate(quatInv(box.quat_rotation), nor);
+	optNormal = r0.xyz * nor.x + r1.xyz * nor.y + r2.xyz * nor.z;
 	return true;
 }
 
-vec4 Box_Texture(vec3 pt, vec3 normal, int num) {
-	raytBox box = boxes[num];
-	vec3 pos = rotate(box.quat_rotation, box.pos);
-	pt = rotate(box.quat_rotation, pt);
-	normal = rotate(box.quat_rotation, normal);
-	return abs(normal.x)*texture(texture_box, 0.5*(pt.zy - pos.zy)-vec2(0.5)) + 
-			abs(normal.y)*texture(texture_box, 0.5*(pt.zx - pos.zx)-vec2(0.5)) + 
-			abs(normal.z)*texture(texture_box, 0.5*(pt.xy - pos.xy)-vec2(0.5));
+#if Has_Textures
+vec4 Box_Texture(vec3 pt, vec3 normal, int num, int texNum) {
+	vec4 r0 = box_geo[num * Box_Stride];
+	vec4 r1 = box_geo[num * Box_Stride + 1];
+	vec4 r2 = box_geo[num * Box_Stride + 2];
+	// hit point relative to the box center, in box space
+	pt = vec3(dot(r0.xyz, pt) + r0.w, dot(r1.xyz, pt) + r1.w, dot(r2.xyz, pt) + r2.w);
+	normal = vec3(dot(r0.xyz, normal), dot(r1.xyz, normal), dot(r2.xyz, normal));
+	ivec2 slot = get_Texture_Slot(texNum);
+	return abs(normal.x)*sample_Texture(slot, 0.5*pt.zy-vec2(0.5)) + 
+			abs(normal.y)*sample_Texture(slot, 0.5*pt.zx-vec2(0.5)) + 
+			abs(normal.z)*sample_Texture(slot, 0.5*pt.xy-vec2(0.5));
 }
+#endif
 
 // begin surface section
+#if Has_Surfaces
 bool check_Surface_Edges(vec3 o, vec3 d, inout float tMin, inout float tMax, vec3 v_min, vec3 v_max, float epsilon)
 {
 	vec3 pt = d * tMin + o;
@@ -321,18 +431,26 @@ bool check_Surface_Edges(vec3 o, vec3 d, inout float tMin, inout float tMax, vec
 bool intersect_Surface(vec3 ro, vec3 rd, int num, float tmin, out float t)
 {
     float Float_max = 3.402823466e+38;
-	raytSurface surface = surfaces[num];
-
-	float d1 = rotate(surface.quat_rotation, rd).x;
-	float d2 = rotate(surface.quat_rotation, rd).y;
-	float d3 = rotate(surface.quat_rotation, rd).z;
-	float o1 = rotate(surface.quat_rotation, ro - surface.pos).x;
-	float o2 = rotate(surface.quat_rotation, ro - surface.pos).y;
-	float o3 = rotate(surface.quat_rotation, ro - surface.pos).z;
-
-	float p1 = 2 * surface.a * d1 * o1 + 2 * surface.b * d2 * o2 + 2 * surface.c * d3 * o3 + surface.d * d3 + d2 * surface.e;
-	float p2 = surface.a * d1 * d1 + surface.b * d2 * d2 + surface.c * d3 * d3;
-	float p3 = surface.a * o1 * o1 + surface.b * o2 * o2 + surface.c * o3 * o3 + surface.d * o3 + surface.e * o2 + surface.f;
+	vec4 r0 = surface_geo[num * Surface_Stride];
+	vec4 r1 = surface_geo[num * Surface_Stride + 1];
+	vec4 r2 = surface_geo[num * Surface_Stride + 2];
+	vec4 g3 = surface_geo[num * Surface_Stride + 3];
+	vec4 g4 = surface_geo[num * Surface_Stride + 4];
+	vec4 g5 = surface_geo[num * Surface_Stride + 5];
+	float a = g3.x, b = g3.y, c = g3.z, d = g3.w, e = g4.w, f = g5.w;
+
+	vec3 rd_s = vec3(dot(r0.xyz, rd), dot(r1.xyz, rd), dot(r2.xyz, rd));
+	vec3 ro_s = vec3(dot(r0.xyz, ro) + r0.w, dot(r1.xyz, ro) + r1.w, dot(r2.xyz, ro) + r2.w);
+	float d1 = rd_s.x;
+	float d2 = rd_s.y;
+	float d3 = rd_s.z;
+	float o1 = ro_s.x;
+	float o2 = ro_s.y;
+	float o3 = ro_s.z;
+
+	float p1 = 2 * a * d1 * o1 + 2 * b * d2 * o2 + 2 * c * d3 * o3 + d * d3 + d2 * e;
+	float p2 = a * d1 * d1 + b * d2 * d2 + c * d3 * d3;
+	float p3 = a * o1 * o1 + b * o2 * o2 + c * o3 * o3 + d * o3 + e * o2 + f;
 	float p4 = sqrt(p1 * p1 - 4 * p2 * p3);
 
 	//division by zero
@@ -359,7 +477,7 @@ bool intersect_Surface(vec3 ro, vec3 rd, int num, float tmin, out float t)
 		max = (-p1 - p4) / (2 * p2);
 	}
 
-	if (!check_Surface_Edges(ro, rd, min, max, surface.v_min, surface.v_max, epsilon))
+	if (!check_Surface_Edges(ro, rd, min, max, g4.xyz, g5.xyz, epsilon))
 		return false;
 
 	t = min;
@@ -367,15 +485,187 @@ bool intersect_Surface(vec3 ro, vec3 rd, int num, float tmin, out float t)
 }
 
 vec3 get_Surface_Normal(vec3 ro, vec3 rd, float t, int num) {
-	raytSurface surface = surfaces[num];
+	vec4 r0 = surface_geo[num * Surface_Stride];
+	vec4 r1 = surface_geo[num * Surface_Stride + 1];
+	vec4 r2 = surface_geo[num * Surface_Stride + 2];
+	vec4 g3 = surface_geo[num * Surface_Stride + 3];
+	float e = surface_geo[num * Surface_Stride + 4].w;
+
+	vec3 pt = ro + rd * t;
+	vec3 tm = vec3(dot(r0.xyz, pt) + r0.w, dot(r1.xyz, pt) + r1.w, dot(r2.xyz, pt) + r2.w);
+
+	vec3 normal = vec3(2 * g3.x * tm.x, 2 * g3.y * tm.y + e, 2 * g3.z * tm.z + g3.w);
+	// the rows are orthonormal, the transpose takes the normal back to world space
+	return normalize(r0.xyz * normal.x + r1.xyz * normal.y + r2.xyz * normal.z);
+}
+#endif
+// end surface section
 
-	vec3 tm = rotate(surface.quat_rotation, rd) * t + rotate(surface.quat_rotation, ro - surface.pos);
+// begin mesh section
+#define BVH_Stack_Size 32
 
-	vec3 normal = vec3(2 * surface.a * tm.x, 2 * surface.b * tm.y + surface.e, 2 * surface.c * tm.z + surface.d);
-	normal = rotate(quatInv(surface.quat_rotation), normal);
-	return normalize(normal);
+vec3 meshNormal;
+
+bool intersect_Aabb(vec3 ro, vec3 inv_rd, vec3 bmin, vec3 bmax, float tmin)
+{
+	vec3 t1 = (bmin - ro) * inv_rd;
+	vec3 t2 = (bmax - ro) * inv_rd;
+	vec3 tn = min(t1, t2);
+	vec3 tf = max(t1, t2);
+	float tnear = max(max(tn.x, tn.y), tn.z);
+	float tfar = min(min(tf.x, tf.y), tf.z);
+	return tnear <= tfar && tfar > 0 && tnear < tmin;
 }
-// end surface section
+
+// watertight ray-triangle intersection (Woop, Benthin, Wald 2013)
+// k permutes the axes so that z is the dominant ray direction, s is the shear
+bool intersect_Triangle(vec3 ro, ivec3 k, vec3 s, vec3 a, vec3 b, vec3 c, float tmin, out float t)
+{
+	a = a - ro; b = b - ro; c = c - ro;
+	a = vec3(a[k.x], a[k.y], a[k.z]);
+	b = vec3(b[k.x], b[k.y], b[k.z]);
+	c = vec3(c[k.x], c[k.y], c[k.z]);
+
+	vec2 as = a.xy - s.xy * a.z;
+	vec2 bs = b.xy - s.xy * b.z;
+	vec2 cs = c.xy - s.xy * c.z;
+
+	float u = cs.x * bs.y - cs.y * bs.x;
+	float v = as.x * cs.y - as.y * cs.x;
+	float w = bs.x * as.y - bs.y * as.x;
+
+	if ((u < 0 || v < 0 || w < 0) && (u > 0 || v > 0 || w > 0))
+		return false;
+
+	float det = u + v + w;
+	if (det == 0)
+		return false;
+
+	float T = (u * a.z + v * b.z + w * c.z) * s.z;
+	if (det < 0 ? (T >= 0 || T < tmin * det) : (T <= 0 || T > tmin * det))
+		return false;
+
+	t = T / det;
+	return true;
+}
+
+raytMeshInstance get_Mesh_Instance(int num)
+{
+	vec4 r0 = texelFetch(mesh_instances, num * 4);
+	vec4 r1 = texelFetch(mesh_instances, num * 4 + 1);
+	vec4 r2 = texelFetch(mesh_instances, num * 4 + 2);
+	ivec4 offsets = floatBitsToInt(texelFetch(mesh_instances, num * 4 + 3));
+	return raytMeshInstance(vec4[3](r0, r1, r2), offsets.x, offsets.y, offsets.z, offsets.w);
+}
+
+// bottom level: triangles of one instance
+bool intersect_Mesh(vec3 ro, vec3 rd, raytMeshInstance mesh, float tmin, out float t)
+{
+	// ray in mesh space
+	vec3 o = vec3(dot(mesh.to_mesh[0].xyz, ro) + mesh.to_mesh[0].w, dot(mesh.to_mesh[1].xyz, ro) + mesh.to_mesh[1].w,
+				  dot(mesh.to_mesh[2].xyz, ro) + mesh.to_mesh[2].w);
+	vec3 d = vec3(dot(mesh.to_mesh[0].xyz, rd), dot(mesh.to_mesh[1].xyz, rd), dot(mesh.to_mesh[2].xyz, rd));
+	vec3 inv_d = 1.0 / d;
+
+	vec3 ad = abs(d);
+	int kz = ad.x > ad.y ? (ad.x > ad.z ? 0 : 2) : (ad.y > ad.z ? 1 : 2);
+	int kx = kz == 2 ? 0 : kz + 1;
+	int ky = kx == 2 ? 0 : kx + 1;
+	ivec3 k = d[kz] < 0 ? ivec3(ky, kx, kz) : ivec3(kx, ky, kz);
+	vec3 s = vec3(d[k.x] / d[kz], d[k.y] / d[kz], 1.0 / d[kz]);
+
+	int stack[BVH_Stack_Size];
+	int sp = 0;
+	int hit = -1;
+	stack[sp++] = 0;
+
+	while (sp > 0)
+	{
+		int node = mesh.node_offset + stack[--sp];
+		vec4 n0 = texelFetch(mesh_nodes, node * 2);
+		vec4 n1 = texelFetch(mesh_nodes, node * 2 + 1);
+		if (!intersect_Aabb(o, inv_d, n0.xyz, n1.xyz, tmin))
+			continue;
+
+		int first = floatBitsToInt(n0.w);
+		int count = floatBitsToInt(n1.w);
+		if (count > 0)
+		{
+			for (int i = mesh.tri_offset + first; i < mesh.tri_offset + first + count; i++)
+			{
+				ivec3 tri = texelFetch(mesh_triangles, i).xyz + mesh.vertex_offset;
+				float ti;
+				if (intersect_Triangle(o, k, s, texelFetch(mesh_vertices, tri.x).xyz, texelFetch(mesh_vertices, tri.y).xyz,
+									   texelFetch(mesh_vertices, tri.z).xyz, tmin, ti))
+				{
+					tmin = ti;
+					hit = i;
+				}
+			}
+		}
+		else
+		{
+			stack[sp++] = first + 1;
+			stack[sp++] = first;
+		}
+	}
+
+	if (hit == -1)
+		return false;
+
+	ivec3 tri = texelFetch(mesh_triangles, hit).xyz + mesh.vertex_offset;
+	vec3 v0 = texelFetch(mesh_vertices, tri.x).xyz;
+	vec3 nor = cross(texelFetch(mesh_vertices, tri.y).xyz - v0, texelFetch(mesh_vertices, tri.z).xyz - v0);
+	// convert to ray space
+	meshNormal = normalize(mesh.to_mesh[0].xyz * nor.x + mesh.to_mesh[1].xyz * nor.y + mesh.to_mesh[2].xyz * nor.z);
+	t = tmin;
+	return true;
+}
+// top level: instances, num is the index of the closest instance
+bool intersect_Mesh_Instances(vec3 ro, vec3 rd, float tmin, out float t, out int num)
+{
+	if (Mesh_Instance_Size == 0 || scene.mesh_instance_count == 0)
+		return false;
+
+	vec3 inv_rd = 1.0 / rd;
+	int stack[BVH_Stack_Size];
+	int sp = 0;
+	num = -1;
+	stack[sp++] = 0;
+
+	while (sp > 0)
+	{
+		int node = stack[--sp];
+		vec4 n0 = texelFetch(instance_nodes, node * 2);
+		vec4 n1 = texelFetch(instance_nodes, node * 2 + 1);
+		if (!intersect_Aabb(ro, inv_rd, n0.xyz, n1.xyz, tmin))
+			continue;
+
+		int first = floatBitsToInt(n0.w);
+		int count = floatBitsToInt(n1.w);
+		if (count > 0)
+		{
+			for (int i = first; i < first + count; i++)
+			{
+				float ti;
+				if (intersect_Mesh(ro, rd, get_Mesh_Instance(i), tmin, ti))
+				{
+					tmin = ti;
+					num = i;
+				}
+			}
+		}
+		else
+		{
+			stack[sp++] = first + 1;
+			stack[sp++] = first;
+		}
+	}
+
+	t = tmin;
+	return num != -1;
+}
+// end mesh section
 
 float maxDist = 1000000.0;
 
@@ -383,6 +673,7 @@ int SPHERE = 0;
 int SURFACE = 1;
 int BOX = 2;
 int POINT_LIGHT = 3;
+int MESH = 4;
 
 float calc_Inter(vec3 ro, vec3 rd, out int num, out int type)
 {
@@ -397,6 +688,7 @@ float calc_Inter(vec3 ro, vec3 rd, out int num, out int type)
 		i++;
 	}
     
+	#if Has_Surfaces
     i = 0;
 	while (i < Surface_Size) {
 		if (intersect_Surface(ro, rd, i, tmin, t)) {
@@ -404,22 +696,28 @@ float calc_Inter(vec3 ro, vec3 rd, out int num, out int type)
 		}
 		i++;
 	}
+	#endif
 
 	i = 0;
-	while (i < Sphere_Size) {
-		if (intersect_Sphere(ro, rd, spheres[i].obj, spheres[i].hollow, tmin, t)) {
+	while (i < scene.sphere_count) {
+		vec4 sphere = sphere_geo[i];
+		if (intersect_Sphere(ro, rd, vec4(sphere.xyz, abs(sphere.w)), sphere.w < 0, tmin, t)) {
 			num = i; tmin = t; type = SPHERE;
 		}
 		i++;
 	}
 
 	i = 0;
-	while (i < Box_Size) {
+	while (i < scene.box_count) {
 		if (intersect_Box(ro, rd, i, tmin, t)) {
 			num = i; tmin = t; type = BOX;
 		}
 		i++;
 	}
+
+	if (intersect_Mesh_Instances(ro, rd, tmin, t, i)) {
+		num = i; tmin = t; type = MESH;
+	}
 	
  	return tmin;
 }
@@ -430,25 +728,31 @@ float in_Shadow(vec3 ro, vec3 rd, float dist)
 	float shadow = 0;
 
 	int i = 0;
-	while (i < Sphere_Size) {
-		if (intersect_Sphere(ro, rd, spheres[i].obj, false, dist, t)) 
+	while (i < scene.sphere_count) {
+		vec4 sphere = sphere_geo[i];
+		if (intersect_Sphere(ro, rd, vec4(sphere.xyz, abs(sphere.w)), false, dist, t)) 
 		    shadow = 1;
 		i++;
 	}
 
     i = 0;
-	while (i < Box_Size) {
+	while (i < scene.box_count) {
 		if (intersect_Box(ro, rd, i, dist, t)) 
 		    shadow = 1;
 		i++;
 	}
 
+	#if Has_Surfaces
     i = 0;
 	while (i < Surface_Size) {
 		if (intersect_Surface(ro, rd, i, dist, t)) 
 		    shadow = 1;
 		i++;
 	}
+	#endif
+
+	if (intersect_Mesh_Instances(ro, rd, dist, t, i)) 
+	    shadow = 1;
 
 	return min(shadow, 1);
 }
@@ -459,11 +763,12 @@ int calculate_Shade2(vec3 light_dir, vec3 light_color, float intensity, vec3 pt,
 	light_dir = normalize(light_dir);
 	// diffuse
 	light_color *= clamp(dot(normal, light_dir), 0.0, 1.0);
-	if (Shadow_Enabled == 1)
+	#if Shadow_Enabled
 	    if (doShadow) {
 		    vec3 shadow = vec3(1 - in_Shadow(pt, light_dir, dist));
 		    light_color *= max(shadow, Shadow_Ambient);
 	}
+	#endif
 	
 	diffuse += light_color * material.color * material.diffuse * intensity / distDiv;
 	
@@ -498,6 +803,7 @@ vec3 calculate_Shade(vec3 pt, vec3 rd, raytMaterial material, vec3 normal, bool
 		i++;
 	}
 
+	#if Has_Lights_Direct
 	i = 0;
 	while (i < Light_Direct_Size) {
 		light_color = lights_direct[i].color;
@@ -508,6 +814,7 @@ vec3 calculate_Shade(vec3 pt, vec3 rd, raytMaterial material, vec3 normal, bool
 		calculate_Shade2(light_dir, light_color, lights_direct[i].intensity, pt, rd, material, normal, doShadow, dist, distDiv, diffuse, specular);
 		i++;
 	}
+	#endif
 
 	pixelColor = pixelColor + diffuse * material.kd + specular * material.ks;
 	return pixelColor;
@@ -519,9 +826,10 @@ float get_Fresnel(vec3 normal, vec3 rd, float reflection)
 	return reflection + (1.0 - reflection) * pow(1.0 - n_dot_v, 5.0);
 }
 
+#if Has_Refraction
 float Fresnel_Reflect_Amount(float n1, float n2, vec3 normal, vec3 incident, float refl)
 {
-    if (Do_Fresnel == 1) {
+    #if Do_Fresnel
         // Schlick aproximation
         float r0 = (n1-n2) / (n1+n2);
         r0 *= r0;
@@ -540,31 +848,41 @@ float Fresnel_Reflect_Amount(float n1, float n2, vec3 normal, vec3 incident, flo
         // adjust reflect multiplier for object reflectivity
         ret = (refl + (1.0 - refl) * ret);
         return ret;
-    }
-    else
+    #else
     	return refl;
+    #endif
 }
+#endif
 
 hitRecord get_hit_info(vec3 ro, vec3 rd, vec3 pt, float t, int num, int type) {
 	hitRecord hr;
 	if (type == SPHERE) {
 		raytSphere sphere = spheres[num];
-		hr = hitRecord(sphere.mat, normalize(pt - sphere.obj.xyz), 0, 1);
+		hr = hitRecord(materials[sphere.material], normalize(pt - sphere.obj.xyz), 0, 1);
+		#if Has_Textures
 		if (sphere.textureNum != 0) {
-			vec4 texColor = Sphere_Texture(hr.normal, sphere.quat_rotation, sphere.textureNum);
+			vec4 texColor = Sphere_Texture(hr.normal, num, sphere.textureNum);
 			hr.mat.color = texColor.rgb;
 			hr.alpha = texColor.a;
 		}
+		#endif
 	}
 	if (type == BOX) {
 		raytBox box = boxes[num];
-		hr = hitRecord(box.mat, optNormal, 0, 1);
+		hr = hitRecord(materials[box.material], optNormal, 0, 1);
+		#if Has_Textures
 		if (box.textureNum != 0) {
-			hr.mat.color = Box_Texture(pt, optNormal, num).rgb;
+			hr.mat.color = Box_Texture(pt, optNormal, num, box.textureNum).rgb;
 		}
+		#endif
 	}
+	#if Has_Surfaces
 	if (type == SURFACE) {
-		hr = hitRecord(surfaces[num].mat, get_Surface_Normal(ro, rd, t, num), 0, 1);
+		hr = hitRecord(materials[surfaces[num].material], get_Surface_Normal(ro, rd, t, num), 0, 1);
+	}
+	#endif
+	if (type == MESH) {
+		hr = hitRecord(materials[get_Mesh_Instance(num).material], meshNormal, 0, 1);
 	}
 	
 	float distance = length(pt - ro);
@@ -573,6 +891,7 @@ hitRecord get_hit_info(vec3 ro, vec3 rd, vec3 pt, float t, int num, int type) {
 	return hr;
 }
 
+#if Has_Refraction
 // get one-step reflection color for refractive objects
 vec3 Reflected_Color(vec3 ro, vec3 rd)
 {
@@ -591,6 +910,7 @@ vec3 Reflected_Color(vec3 ro, vec3 rd)
 	}
 	return color;
 }
+#endif
 
 #define Iterations {ITERATIONS}
 
@@ -631,17 +951,19 @@ void main()
 			bool outside = dot(rd, n) < 0;
 			n = outside ? n : -n;
 
-			if (Total_Internal_Reflection == 1)
+			#if Has_Refraction && Total_Internal_Reflection
 			    if (mat.refraction > 0) 
 				    reflect_Multiplier = Fresnel_Reflect_Amount( outside ? 1 : mat.refraction,
 													  	  outside ? mat.refraction : 1,
 											 		      rd, n, mat.reflection);
 			    else reflect_Multiplier = get_Fresnel(n,rd,mat.reflection);
-			else
+			#else
 			    reflect_Multiplier = get_Fresnel(n,rd,mat.reflection);
+			#endif
 
 			refract_Multiplier = 1 - reflect_Multiplier;
 
+			#if Has_Refraction
 			if (mat.refraction > 0.0) // Refractive
 			{
 				if (outside && mat.reflection > 0)
@@ -654,17 +976,21 @@ void main()
         			vec3 absorb = exp(-mat.absorb * absorb_Distance);
 					mask *= absorb;
 				}
-				if (Total_Internal_Reflection == 1)
+				#if Total_Internal_Reflection
 				    //todo: rd = reflect(..) instead of break
 				    if (reflect_Multiplier >= 1)
 					    break;
+				#endif
 				
 				ro = pt - n * hr.bias_mult;
 				rd = refract(rd, n, outside ? 1 / mat.refraction : mat.refraction);
-				if (Reflect_Reduce_Iteration == 1)
+				#if Reflect_Reduce_Iteration
 				    i--;
+				#endif
 			}
-			else if (mat.reflection > 0.0) // Reflective
+			else
+			#endif
+			if (mat.reflection > 0.0) // Reflective
 			{
 				ro = pt + n * hr.bias_mult;
 				color += calculate_Shade(ro, rd, mat, n, true) * refract_Multiplier * mask;
@@ -685,6 +1011,11 @@ void main()
 		} 
 		i++;
 	}
+	if (feedback_pass != 0)
+	{
+		FragColor = vt_feedback;
+		return;
+	}
 	#if DBG == 0
 	FragColor = vec4(color,1);
 	#else
@@ -0,0 +1,83 @@
+// the layouts of the structs in scene.h, as the uniform blocks hold them
+
+struct raytMaterial {
+	vec3 color;
+	vec3 absorb;
+
+	float diffuse;
+	float reflection;
+	float refraction;
+	int specular;
+	float kd;
+	float ks;
+};
+
+struct raytScene {
+	vec4 quat_camera_rotation;
+	vec3 camera_pos;
+	vec3 bg_color;
+
+	int canvas_width;
+	int canvas_height;
+
+	int reflect_depth;
+	// filled part of the arrays below, the rest is room for a scene still streaming in
+	int sphere_count;
+	int box_count;
+	int mesh_instance_count;
+};
+
+struct raytLightDirect {
+	vec3 direction;
+	vec3 color;
+
+	float intensity;
+};
+
+struct raytLightPoint {
+	vec4 pos; //pos + radius
+	vec3 color;
+	float intensity;
+
+	float linear_k;
+	float quadratic_k;
+};
+
+struct raytSphere {
+	vec4 obj;
+	vec4 quat_rotation; // compiled into sphere_rotation_buf for texturing
+	int textureNum;
+	bool hollow;
+	int material;
+};
+
+struct raytBox {
+	vec4 quat_rotation;
+	vec3 pos;
+	int material;
+	vec3 form;
+	int textureNum;
+};
+
+struct raytSurface {
+	vec4 quat_rotation;
+	vec3 v_min;
+	int material;
+	vec3 v_max;
+	vec3 pos;
+	float a; // x2
+	float b; // y2
+	float c; // z2
+	float d; // z
+	float e; // y
+	float f; // const	
+};
+
+// as packed by Instance_Tree
+struct raytMeshInstance {
+	vec4 to_mesh[3]; // world to mesh rows with the translation in w
+	int material;
+	int node_offset;
+	int tri_offset;
+	int vertex_offset;
+};
@@ -0,0 +1,90 @@
+#include "AllocationCounter.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <algorithm>
+
+using namespace std;
+
+#ifdef COUNT_ALLOCATIONS
+static atomic<uint64_t> allocations{ 0 };
+
+// the array and nothrow forms of the library call these
+void* operator new(size_t size)
+{
+	allocations.fetch_add(1, memory_order_relaxed);
+	void* p = malloc(size ? size : 1);
+	if (!p)
+		throw bad_alloc();
+	return p;
+}
+
+void* operator new(size_t size, const nothrow_t&) noexcept
+{
+	allocations.fetch_add(1, memory_order_relaxed);
+	return malloc(size ? size : 1);
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, const nothrow_t&) noexcept
+{
+	free(p);
+}
+#endif
+
+Allocation_Counter::Allocation_Counter(int warmupFrames)
+	: warmupFrames(warmupFrames)
+{
+}
+
+bool Allocation_Counter::enabled()
+{
+#ifdef COUNT_ALLOCATIONS
+	return true;
+#else
+	return false;
+#endif
+}
+
+uint64_t Allocation_Counter::total()
+{
+#ifdef COUNT_ALLOCATIONS
+	return allocations.load(memory_order_relaxed);
+#else
+	return 0;
+#endif
+}
+
+void Allocation_Counter::frame()
+{
+	uint64_t now = total();
+	if (frames++ > warmupFrames)
+	{
+		uint64_t count = now - last;
+		counted += count;
+		worst = max(worst, count);
+		if (count > 0)
+			allocating++;
+	}
+	last = now;
+}
+
+void Allocation_Counter::report() const
+{
+	if (!enabled())
+		return;
+	int measured = max(frames - warmupFrames - 1, 0);
+	if (measured == 0)
+	{
+		printf("Allocations: no frames after the first %d\n", warmupFrames);
+		return;
+	}
+	printf("Allocations: %llu in %d frames after the first %d, %.2f per frame, at most %llu, %d frames allocating\n",
+		static_cast<unsigned long long>(counted), measured, warmupFrames, static_cast<double>(counted) / measured,
+		static_cast<unsigned long long>(worst), allocating);
+}
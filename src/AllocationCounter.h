@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+
+using namespace std;
+
+// Counts heap allocations per frame, to check that frames in the steady state allocate
+// nothing. The count comes from a global operator new that is only replaced in builds
+// with COUNT_ALLOCATIONS, elsewhere enabled() is false and every frame counts 0. What is
+// allocated by any thread between two calls of frame() is charged to the frame, malloc
+// calls of C code are not seen.
+class Allocation_Counter
+{
+public:
+	// frames before the first counted one, loading and the first uploads allocate
+	explicit Allocation_Counter(int warmupFrames = 120);
+
+	static bool enabled();
+	// operator new calls of the process so far
+	static uint64_t total();
+
+	// once per frame, at the same point of the loop
+	void frame();
+	void report() const;
+
+private:
+	int warmupFrames;
+	int frames = 0;
+	uint64_t last = 0;
+	uint64_t counted = 0;
+	uint64_t worst = 0;
+	int allocating = 0; // frames with at least one allocation
+};
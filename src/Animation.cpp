@@ -0,0 +1,203 @@
+#include "Animation.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+Animation_System::Animation_System(Thread_Pool& workers)
+	: workers(workers)
+{
+}
+
+int Animation_System::add(sceneContainer& scene, animTarget target, int index)
+{
+	scene.sync_slots();
+	const Slot_Map& slots = slots_of(scene, target);
+	if (index < 0 || index >= static_cast<int>(slots.size()))
+		return -1;
+	int slot = slots.slot_of(index);
+	return add(scene, target, slot, slots.generation_of(slot));
+}
+
+int Animation_System::add(sceneContainer& scene, animTarget target, int slot, uint32_t generation)
+{
+	scene.sync_slots();
+	int index = slots_of(scene, target).find(slot, generation);
+	if (index < 0)
+		return -1;
+
+	animComponent component = {};
+	component.target = target;
+	component.slot = slot;
+	component.generation = generation;
+	switch (target)
+	{
+	case ANIM_SPHERE:
+		component.base_pos = glm::vec3(scene.spheres[index].obj);
+		component.base_rotation = scene.spheres[index].quat_rotation;
+		break;
+	case ANIM_SURFACE:
+		component.base_pos = scene.surfaces[index].pos;
+		component.base_rotation = scene.surfaces[index].quat_rotation;
+		break;
+	case ANIM_BOX:
+		component.base_pos = scene.boxes[index].pos;
+		component.base_rotation = scene.boxes[index].quat_rotation;
+		break;
+	case ANIM_MESH_INSTANCE:
+		component.base_pos = scene.mesh_instances[index].pos;
+		component.base_rotation = scene.mesh_instances[index].quat_rotation;
+		break;
+	}
+
+	components.push_back(component);
+	indices.push_back(index);
+	return static_cast<int>(components.size()) - 1;
+}
+
+const Slot_Map& Animation_System::slots_of(const sceneContainer& scene, animTarget target)
+{
+	switch (target)
+	{
+	case ANIM_SPHERE:
+		return scene.sphere_slots;
+	case ANIM_SURFACE:
+		return scene.surface_slots;
+	case ANIM_BOX:
+		return scene.box_slots;
+	default:
+		return scene.mesh_instance_slots;
+	}
+}
+
+unsigned Animation_System::dirty_of(animTarget target)
+{
+	switch (target)
+	{
+	case ANIM_SPHERE:
+		return DIRTY_SPHERES;
+	case ANIM_SURFACE:
+		return DIRTY_SURFACES;
+	case ANIM_BOX:
+		return DIRTY_BOXES;
+	default:
+		return DIRTY_MESH_INSTANCES;
+	}
+}
+
+void Animation_System::set_track(int component, const vector<animKey>& track, bool loop)
+{
+	animComponent& c = components[component];
+	c.first_key = static_cast<int>(keys.size());
+	c.key_count = static_cast<int>(track.size());
+	c.loop = loop;
+	keys.insert(keys.end(), track.begin(), track.end());
+}
+
+void Animation_System::set_orbit(int component, glm::vec3 center, glm::vec3 axis, float radius, float speed, float phase)
+{
+	animComponent& c = components[component];
+	axis = glm::normalize(axis);
+	glm::vec3 reference = abs(axis.z) > 0.999f ? glm::vec3(1, 0, 0) : glm::vec3(0, 0, 1);
+	c.orbit = true;
+	c.center = center;
+	c.orbit_u = glm::normalize(glm::cross(axis, reference));
+	c.orbit_v = glm::cross(c.orbit_u, axis);
+	c.radius = radius;
+	c.orbit_speed = speed;
+	c.phase = phase;
+}
+
+void Animation_System::set_spin(int component, glm::vec3 axis, float speed)
+{
+	animComponent& c = components[component];
+	c.spin = true;
+	c.spin_axis = glm::normalize(axis);
+	c.spin_speed = speed;
+}
+
+void Animation_System::sample_track(const animComponent& c, float time, glm::vec3& pos, glm::quat& rotation) const
+{
+	const animKey* first = &keys[c.first_key];
+	const animKey* last = first + c.key_count - 1;
+	float duration = last->time - first->time;
+	if (c.loop && duration > 0)
+		time = first->time + fmod(fmod(time - first->time, duration) + duration, duration);
+
+	if (time <= first->time || c.key_count == 1)
+	{
+		pos = first->pos;
+		rotation = first->rotation;
+		return;
+	}
+	if (time >= last->time)
+	{
+		pos = last->pos;
+		rotation = last->rotation;
+		return;
+	}
+	// the first key after time, there is one before it
+	const animKey* next = upper_bound(first, last + 1, time, [](float t, const animKey& key) { return t < key.time; });
+	const animKey* previous = next - 1;
+	float f = (time - previous->time) / (next->time - previous->time);
+	pos = glm::mix(previous->pos, next->pos, f);
+	rotation = glm::slerp(previous->rotation, next->rotation, f);
+}
+
+// writes only the element of its own object, components of different objects can run at once
+void Animation_System::evaluate(const animComponent& c, int index, float time, sceneContainer& scene) const
+{
+	glm::vec3 pos = c.base_pos;
+	glm::quat rotation = c.base_rotation;
+	if (c.key_count > 0)
+		sample_track(c, time, pos, rotation);
+	else if (c.orbit)
+	{
+		float angle = c.phase + time * c.orbit_speed;
+		pos = c.center + c.radius * (cos(angle) * c.orbit_u + sin(angle) * c.orbit_v);
+	}
+	if (c.spin)
+		rotation = rotation * glm::angleAxis(time * c.spin_speed, c.spin_axis);
+
+	switch (c.target)
+	{
+	case ANIM_SPHERE:
+		scene.spheres[index].obj = glm::vec4(pos, scene.spheres[index].obj.w);
+		scene.spheres[index].quat_rotation = rotation;
+		break;
+	case ANIM_SURFACE:
+		scene.surfaces[index].pos = pos;
+		scene.surfaces[index].quat_rotation = rotation;
+		break;
+	case ANIM_BOX:
+		scene.boxes[index].pos = pos;
+		scene.boxes[index].quat_rotation = rotation;
+		break;
+	case ANIM_MESH_INSTANCE:
+		scene.mesh_instances[index].pos = pos;
+		scene.mesh_instances[index].quat_rotation = rotation;
+		break;
+	}
+}
+
+// the objects are looked up and patched first, the batches only write them
+void Animation_System::update(sceneContainer& scene, float time)
+{
+	if (components.empty())
+		return;
+	scene.sync_slots();
+	for (size_t i = 0; i < components.size(); i++)
+	{
+		const animComponent& c = components[i];
+		indices[i] = slots_of(scene, c.target).find(c.slot, c.generation);
+		if (indices[i] >= 0)
+			scene.patch(dirty_of(c.target), indices[i], indices[i] + 1);
+	}
+
+	workers.parallel_for(components.size(), Batch_Size, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+			if (indices[i] >= 0)
+				evaluate(components[i], indices[i], time, scene);
+	});
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include "scene.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+enum animTarget
+{
+	ANIM_SPHERE,
+	ANIM_SURFACE,
+	ANIM_BOX,
+	ANIM_MESH_INSTANCE,
+};
+
+struct animKey
+{
+	float time;
+	glm::vec3 pos;
+	glm::quat rotation;
+};
+
+// what moves one object, the parts are optional and combine: the position comes from
+// the track, else the orbit, the rotation from the track, else the object's own, and
+// the spin turns on top of that
+struct animComponent
+{
+	animTarget target;
+	int slot; // the object's handle, see Slot_Map
+	uint32_t generation;
+	glm::vec3 base_pos; // the object's at add()
+	glm::quat base_rotation;
+
+	int first_key = 0; // into Animation_System's keys, sorted by time
+	int key_count = 0;
+	bool loop = false;
+
+	bool orbit = false;
+	glm::vec3 center;
+	glm::vec3 orbit_u, orbit_v; // the plane of the orbit, angle 0 is along u
+	float radius = 0;
+	float orbit_speed = 0; // radians per second
+	float phase = 0;
+
+	bool spin = false;
+	glm::vec3 spin_axis;
+	float spin_speed = 0; // radians per second
+};
+
+// Moves objects of the scene by components instead of per object code. Every update
+// evaluates all components for the given time, in batches spread over the thread pool,
+// writes the positions and rotations straight into the scene's arrays and patches the
+// range of each array the animated objects are in. The result depends only on the time,
+// not on the steps before it. Components are added before the scene is handed to the
+// simulation, one per object, which is what lets the batches write without locking.
+// Components follow their object through removals of others and stop once it is removed.
+class Animation_System
+{
+public:
+	explicit Animation_System(Thread_Pool& workers);
+
+	// the component of the object, the object's transform at this point is where the
+	// parts start from, -1 if index is out of range
+	int add(sceneContainer& scene, animTarget target, int index);
+	int add(sceneContainer& scene, sphereHandle sphere) { return add(scene, ANIM_SPHERE, sphere.index, sphere.generation); }
+	int add(sceneContainer& scene, surfaceHandle surface) { return add(scene, ANIM_SURFACE, surface.index, surface.generation); }
+	int add(sceneContainer& scene, boxHandle box) { return add(scene, ANIM_BOX, box.index, box.generation); }
+	int add(sceneContainer& scene, meshInstanceHandle instance)
+	{
+		return add(scene, ANIM_MESH_INSTANCE, instance.index, instance.generation);
+	}
+	// keys sorted by time, a looping track repeats from the first key after the last one
+	void set_track(int component, const vector<animKey>& keys, bool loop);
+	// circles center in the plane normal to axis, counterclockwise seen from below, angle
+	// 0 is along cross(axis, z), or cross(axis, x) for an axis along z
+	void set_orbit(int component, glm::vec3 center, glm::vec3 axis, float radius, float speed, float phase = 0);
+	void set_spin(int component, glm::vec3 axis, float speed);
+
+	// simulation thread
+	void update(sceneContainer& scene, float time);
+	size_t size() const { return components.size(); }
+
+	static const size_t Batch_Size = 256;
+
+private:
+	Thread_Pool& workers;
+	vector<animComponent> components;
+	vector<animKey> keys;
+	vector<int> indices; // per component, its object's index in this update, -1 once removed
+
+	int add(sceneContainer& scene, animTarget target, int slot, uint32_t generation);
+	static const Slot_Map& slots_of(const sceneContainer& scene, animTarget target);
+	static unsigned dirty_of(animTarget target);
+	void sample_track(const animComponent& component, float time, glm::vec3& pos, glm::quat& rotation) const;
+	void evaluate(const animComponent& component, int index, float time, sceneContainer& scene) const;
+};
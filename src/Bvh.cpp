@@ -0,0 +1,174 @@
+#include "Bvh.h"
+#include <cfloat>
+
+using namespace std;
+
+void Bvh::build(vector<Bvh_Primitive>& prims, vector<raytBvhNode>& nodes, vector<int>& order, bool shrink)
+{
+	nodes.clear();
+	order.resize(prims.size());
+	for (size_t i = 0; i < prims.size(); i++)
+		order[i] = static_cast<int>(i);
+
+	if (prims.empty())
+		return;
+
+	nodes.reserve(prims.size() * 2);
+	raytBvhNode root = {};
+	root.left_first = 0;
+	root.count = static_cast<int>(prims.size());
+	nodes.push_back(root);
+
+	update_bounds(nodes[0], prims);
+	subdivide(0, 0, prims, nodes, order);
+	if (shrink)
+		nodes.shrink_to_fit();
+}
+
+void Bvh::update_bounds(raytBvhNode& n, const vector<Bvh_Primitive>& prims)
+{
+	n.bmin = glm::vec3(FLT_MAX);
+	n.bmax = glm::vec3(-FLT_MAX);
+	for (int i = n.left_first; i < n.left_first + n.count; i++)
+	{
+		n.bmin = glm::min(n.bmin, prims[i].bmin);
+		n.bmax = glm::max(n.bmax, prims[i].bmax);
+	}
+}
+
+static float half_area(glm::vec3 bmin, glm::vec3 bmax)
+{
+	glm::vec3 e = bmax - bmin;
+	return e.x * e.y + e.y * e.z + e.z * e.x;
+}
+
+// binned SAH split
+void Bvh::subdivide(int node, int depth, vector<Bvh_Primitive>& prims, vector<raytBvhNode>& nodes, vector<int>& order)
+{
+	const int Bins = 16;
+
+	int first = nodes[node].left_first;
+	int count = nodes[node].count;
+	if (count <= 2 || depth >= Max_Depth)
+		return;
+
+	glm::vec3 cmin(FLT_MAX), cmax(-FLT_MAX);
+	for (int i = first; i < first + count; i++)
+	{
+		cmin = glm::min(cmin, prims[i].centroid);
+		cmax = glm::max(cmax, prims[i].centroid);
+	}
+
+	// one traversal step costs about as much as one triangle test
+	float area = half_area(nodes[node].bmin, nodes[node].bmax);
+	int bestAxis = -1, bestSplit = 0;
+	float bestCost = count * area;
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if (cmax[axis] <= cmin[axis])
+			continue;
+
+		glm::vec3 binMin[Bins], binMax[Bins];
+		int binCount[Bins] = {};
+		for (int b = 0; b < Bins; b++)
+		{
+			binMin[b] = glm::vec3(FLT_MAX);
+			binMax[b] = glm::vec3(-FLT_MAX);
+		}
+
+		float scale = Bins / (cmax[axis] - cmin[axis]);
+		for (int i = first; i < first + count; i++)
+		{
+			int b = glm::min(Bins - 1, static_cast<int>((prims[i].centroid[axis] - cmin[axis]) * scale));
+			binMin[b] = glm::min(binMin[b], prims[i].bmin);
+			binMax[b] = glm::max(binMax[b], prims[i].bmax);
+			binCount[b]++;
+		}
+
+		// sweep from the right, then from the left
+		float rightArea[Bins - 1];
+		int rightCount[Bins - 1];
+		glm::vec3 bmin(FLT_MAX), bmax(-FLT_MAX);
+		int sum = 0;
+		for (int b = Bins - 1; b > 0; b--)
+		{
+			sum += binCount[b];
+			bmin = glm::min(bmin, binMin[b]);
+			bmax = glm::max(bmax, binMax[b]);
+			rightCount[b - 1] = sum;
+			rightArea[b - 1] = sum ? half_area(bmin, bmax) : 0;
+		}
+
+		bmin = glm::vec3(FLT_MAX);
+		bmax = glm::vec3(-FLT_MAX);
+		sum = 0;
+		for (int b = 0; b < Bins - 1; b++)
+		{
+			sum += binCount[b];
+			bmin = glm::min(bmin, binMin[b]);
+			bmax = glm::max(bmax, binMax[b]);
+			if (sum == 0 || rightCount[b] == 0)
+				continue;
+			float cost = area + sum * half_area(bmin, bmax) + rightCount[b] * rightArea[b];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = b + 1;
+			}
+		}
+	}
+
+	if (bestAxis == -1)
+		return;
+
+	// partition primitives around the best bin boundary
+	float scale = Bins / (cmax[bestAxis] - cmin[bestAxis]);
+	int i = first, j = first + count - 1;
+	while (i <= j)
+	{
+		int b = glm::min(Bins - 1, static_cast<int>((prims[i].centroid[bestAxis] - cmin[bestAxis]) * scale));
+		if (b < bestSplit)
+			i++;
+		else
+		{
+			swap(order[i], order[j]);
+			swap(prims[i], prims[j]);
+			j--;
+		}
+	}
+
+	int leftCount = i - first;
+	if (leftCount == 0 || leftCount == count)
+		return;
+
+	int left = static_cast<int>(nodes.size());
+	raytBvhNode child = {};
+	child.left_first = first;
+	child.count = leftCount;
+	nodes.push_back(child);
+	child.left_first = i;
+	child.count = count - leftCount;
+	nodes.push_back(child);
+
+	nodes[node].left_first = left;
+	nodes[node].count = 0;
+
+	update_bounds(nodes[left], prims);
+	update_bounds(nodes[left + 1], prims);
+	subdivide(left, depth + 1, prims, nodes, order);
+	subdivide(left + 1, depth + 1, prims, nodes, order);
+}
+
+bool Bvh::intersect_aabb(glm::vec3 ro, glm::vec3 inv_rd, glm::vec3 bmin, glm::vec3 bmax, float tmax)
+{
+	glm::vec3 t1 = (bmin - ro) * inv_rd;
+	glm::vec3 t2 = (bmax - ro) * inv_rd;
+	glm::vec3 tn = glm::min(t1, t2);
+	glm::vec3 tf = glm::max(t1, t2);
+	float tnear = glm::max(glm::max(tn.x, tn.y), tn.z);
+	float tfar = glm::min(glm::min(tf.x, tf.y), tf.z);
+	return tnear <= tfar && tfar > 0 && tnear < tmax;
+}
+
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+
+using namespace std;
+
+// 32 bytes, uploaded as two RGBA32F texels.
+// leaf: count > 0, left_first = first primitive
+// inner: count == 0, left_first = left child (right child is left_first + 1)
+struct raytBvhNode
+{
+	glm::vec3 bmin;
+	int left_first;
+	glm::vec3 bmax;
+	int count;
+};
+
+struct Bvh_Primitive
+{
+	glm::vec3 bmin, bmax, centroid;
+};
+
+class Bvh
+{
+public:
+	// binned SAH build, order receives the primitive index stored in each leaf slot;
+	// without shrink nodes keeps its capacity, for trees rebuilt into the same vector
+	static void build(vector<Bvh_Primitive>& prims, vector<raytBvhNode>& nodes, vector<int>& order, bool shrink = true);
+
+	static bool intersect_aabb(glm::vec3 ro, glm::vec3 inv_rd, glm::vec3 bmin, glm::vec3 bmax, float tmax);
+
+	// stack size of the shader traversal loops bounds the tree depth
+	static const int Max_Depth = 31;
+
+private:
+	static void update_bounds(raytBvhNode& node, const vector<Bvh_Primitive>& prims);
+	static void subdivide(int node, int depth, vector<Bvh_Primitive>& prims, vector<raytBvhNode>& nodes, vector<int>& order);
+};
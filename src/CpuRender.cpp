@@ -0,0 +1,215 @@
+#include "CpuRender.h"
+#include <cmath>
+#include <algorithm>
+
+using namespace std;
+
+Cpu_Renderer::Cpu_Renderer(Thread_Pool& pool)
+	: pool(pool)
+{
+}
+
+void Cpu_Renderer::update(const sceneContainer& scene, unsigned dirty)
+{
+	geometry.build(scene, dirty);
+	geometry.patch(scene, scene.patched & ~dirty);
+	features = scene.get_features();
+}
+
+void Cpu_Renderer::render(const sceneContainer& scene, int x, int y, int width, int height, unsigned char* rgba)
+{
+	pool.parallel_for(static_cast<size_t>(height), 4, [&](size_t begin, size_t end)
+	{
+		for (size_t row = begin; row < end; row++)
+		{
+			unsigned char* p = rgba + row * width * 4;
+			for (int col = 0; col < width; col++, p += 4)
+			{
+				// pixel centers, as gl_FragCoord has them
+				glm::vec3 rd = ray_dir(scene.scene, x + col + 0.5f, y + static_cast<int>(row) + 0.5f);
+				glm::vec3 color = glm::clamp(trace(scene, scene.scene.camera_pos, rd), 0.0f, 1.0f);
+				for (int c = 0; c < 3; c++)
+					p[c] = static_cast<unsigned char>(color[c] * 255.0f + 0.5f);
+				p[3] = 255;
+			}
+		}
+	});
+}
+
+glm::vec3 Cpu_Renderer::ray_dir(const raytScene& scene, float x, float y)
+{
+	glm::vec3 d((x - scene.canvas_width / 2.0f) / scene.canvas_height, (y - scene.canvas_height / 2.0f) / scene.canvas_height, 1);
+	return glm::normalize(scene.quat_camera_rotation * d);
+}
+
+const raytMaterial& Cpu_Renderer::material_of(const sceneContainer& scene, int num, int type) const
+{
+	if (type == HIT_SPHERE)
+		return scene.materials[scene.spheres[num].material];
+	if (type == HIT_BOX)
+		return scene.materials[scene.boxes[num].material];
+	if (type == HIT_SURFACE)
+		return scene.materials[scene.surfaces[num].material];
+	return scene.materials[geometry.instance_tree.instances[num].material];
+}
+
+// offset of the next ray's origin from the hit, grows with the distance travelled
+static float bias_of(glm::vec3 ro, glm::vec3 pt)
+{
+	return (9e-3f * glm::length(pt - ro) + 35) / 35e3f;
+}
+
+static float fresnel(glm::vec3 normal, glm::vec3 rd, float reflection)
+{
+	float nDotV = glm::clamp(glm::dot(normal, -rd), 0.0f, 1.0f);
+	return reflection + (1.0f - reflection) * pow(1.0f - nDotV, 5.0f);
+}
+
+// Schlick's approximation with total internal reflection, mirrors Fresnel_Reflect_Amount
+static float fresnel_reflect_amount(float n1, float n2, glm::vec3 normal, glm::vec3 incident, float reflection, bool doFresnel)
+{
+	if (!doFresnel)
+		return reflection;
+	float r0 = (n1 - n2) / (n1 + n2);
+	r0 *= r0;
+	float cosX = -glm::dot(normal, incident);
+	if (n1 > n2)
+	{
+		float n = n1 / n2;
+		float sinT2 = n * n * (1.0f - cosX * cosX);
+		if (sinT2 > 1.0f)
+			return 1.0f;
+		cosX = sqrt(1.0f - sinT2);
+	}
+	float x = 1.0f - cosX;
+	float amount = r0 + (1.0f - r0) * pow(x, 5.0f);
+	return reflection + (1.0f - reflection) * amount;
+}
+
+void Cpu_Renderer::shade_light(const sceneContainer& scene, glm::vec3 lightDir, glm::vec3 lightColor, float intensity, glm::vec3 pt,
+	glm::vec3 rd, const raytMaterial& material, glm::vec3 normal, float dist, float distDiv, glm::vec3& diffuse, glm::vec3& specular) const
+{
+	lightDir = glm::normalize(lightDir);
+	lightColor *= glm::clamp(glm::dot(normal, lightDir), 0.0f, 1.0f);
+	if (features & FEATURE_SHADOWS)
+	{
+		float lit = geometry.occluded(scene, pt, lightDir, dist) ? 0.0f : 1.0f;
+		lightColor *= glm::max(glm::vec3(lit), scene.shadow_ambient);
+	}
+
+	diffuse += lightColor * material.color * material.diffuse * intensity / distDiv;
+	if (material.specular > 0)
+	{
+		glm::vec3 reflection = glm::reflect(lightDir, normal);
+		specular += lightColor * pow(glm::clamp(glm::dot(rd, reflection), 0.0f, 1.0f), static_cast<float>(material.specular)) *
+			intensity / distDiv;
+	}
+}
+
+// mirrors calculate_Shade
+glm::vec3 Cpu_Renderer::shade(const sceneContainer& scene, glm::vec3 pt, glm::vec3 rd, const raytMaterial& material, glm::vec3 normal) const
+{
+	glm::vec3 diffuse(0), specular(0);
+	for (const raytLightPoint& light : scene.lights_point)
+	{
+		glm::vec3 lightDir = glm::vec3(light.pos) - pt;
+		float dist = glm::length(lightDir);
+		float distDiv = 1 + light.linear_k * dist + light.quadratic_k * dist * dist;
+		shade_light(scene, lightDir, light.color, light.intensity, pt, rd, material, normal, dist, distDiv, diffuse, specular);
+	}
+	for (const raytLightDirect& light : scene.lights_direct)
+		shade_light(scene, -light.direction, light.color, light.intensity, pt, rd, material, normal, Scene_Geometry::Max_Dist, 1,
+			diffuse, specular);
+
+	return scene.ambient_color * material.color + diffuse * material.kd + specular * material.ks;
+}
+
+// one bounce of reflection off a refractive object, mirrors Reflected_Color
+glm::vec3 Cpu_Renderer::reflected_color(const sceneContainer& scene, glm::vec3 ro, glm::vec3 rd) const
+{
+	int num = 0, type = -1;
+	glm::vec3 normal;
+	float t = geometry.intersect(scene, ro, rd, num, type, normal);
+	if (type == HIT_POINT_LIGHT)
+		return scene.lights_point[num].color;
+	if (t >= Scene_Geometry::Max_Dist)
+		return glm::vec3(0);
+
+	glm::vec3 pt = ro + rd * t;
+	float bias = bias_of(ro, pt);
+	ro = glm::dot(rd, normal) < 0 ? pt + normal * bias : pt - normal * bias;
+	return shade(scene, ro, rd, material_of(scene, num, type), normal);
+}
+
+// mirrors main() of the fragment shader
+glm::vec3 Cpu_Renderer::trace(const sceneContainer& scene, glm::vec3 ro, glm::vec3 rd) const
+{
+	bool refraction = (features & FEATURE_REFRACTION) != 0;
+	bool totalInternal = refraction && (features & FEATURE_TOTAL_INTERNAL_REFLECTION);
+	glm::vec3 mask(1), color(0);
+	float absorbDistance = 0;
+
+	for (int i = 0; i < scene.scene.reflect_depth; i++)
+	{
+		int num = 0, type = -1;
+		glm::vec3 normal;
+		float t = geometry.intersect(scene, ro, rd, num, type, normal);
+		// the shader goes on with the same ray, which misses again
+		if (t >= Scene_Geometry::Max_Dist)
+			break;
+		if (type == HIT_POINT_LIGHT)
+		{
+			color += scene.lights_point[num].color * mask;
+			break;
+		}
+
+		glm::vec3 pt = ro + rd * t;
+		const raytMaterial& mat = material_of(scene, num, type);
+		float bias = bias_of(ro, pt);
+		bool outside = glm::dot(rd, normal) < 0;
+		glm::vec3 n = outside ? normal : -normal;
+
+		float reflectMultiplier;
+		if (totalInternal && mat.refract > 0)
+			reflectMultiplier = fresnel_reflect_amount(outside ? 1 : mat.refract, outside ? mat.refract : 1, rd, n, mat.reflect,
+				(features & FEATURE_FRESNEL) != 0);
+		else
+			reflectMultiplier = fresnel(n, rd, mat.reflect);
+		float refractMultiplier = 1 - reflectMultiplier;
+
+		if (refraction && mat.refract > 0.0f)
+		{
+			if (outside && mat.reflect > 0)
+			{
+				color += reflected_color(scene, pt + n * bias, glm::reflect(rd, n)) * reflectMultiplier * mask;
+				mask *= refractMultiplier;
+			}
+			else if (!outside)
+			{
+				absorbDistance += t;
+				mask *= glm::exp(-mat.absorb * absorbDistance);
+			}
+			if (totalInternal && reflectMultiplier >= 1)
+				break;
+
+			ro = pt - n * bias;
+			rd = glm::refract(rd, n, outside ? 1 / mat.refract : mat.refract);
+			if (features & FEATURE_REFRACTION_FREE_ITERATION)
+				i--;
+		}
+		else if (mat.reflect > 0.0f)
+		{
+			ro = pt + n * bias;
+			color += shade(scene, ro, rd, mat, n) * refractMultiplier * mask;
+			rd = glm::reflect(rd, n);
+			mask *= reflectMultiplier;
+		}
+		else
+		{
+			// diffuse, opaque without textures
+			color += shade(scene, pt + n * bias, rd, mat, n) * mask;
+			break;
+		}
+	}
+	return color;
+}
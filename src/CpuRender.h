@@ -0,0 +1,41 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include "scene.h"
+#include "SceneGeometry.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+// Draws the scene on the CPU with the intersection routines of Scene_Geometry, for tile
+// workers without a GPU (rt --tiles n --cpu). The shading mirrors main() of the fragment
+// shader with the same shader features; textures are not sampled, textured primitives
+// show their material's color.
+class Cpu_Renderer
+{
+public:
+	explicit Cpu_Renderer(Thread_Pool& pool);
+
+	// rebuilds the intersection data of the arrays in dirty and packs scene.patches of the
+	// ones only patched, like Scene_Manager::update
+	void update(const sceneContainer& scene, unsigned dirty);
+	// the pixels [x, x + width) x [y, y + height) of the canvas, from the bottom left, into
+	// rgba as RGBA8 rows bottom up, the layout glReadPixels returns, rows split over the pool
+	void render(const sceneContainer& scene, int x, int y, int width, int height, unsigned char* rgba);
+
+	// the color the fragment shader computes for the ray
+	glm::vec3 trace(const sceneContainer& scene, glm::vec3 ro, glm::vec3 rd) const;
+	// the camera ray through the point x, y of the canvas, mirrors get_Ray_Dir
+	static glm::vec3 ray_dir(const raytScene& scene, float x, float y);
+
+private:
+	Thread_Pool& pool;
+	Scene_Geometry geometry;
+	unsigned features = 0; // shaderFeatures, as the scene's shader variant has them
+
+	const raytMaterial& material_of(const sceneContainer& scene, int num, int type) const;
+	glm::vec3 shade(const sceneContainer& scene, glm::vec3 pt, glm::vec3 rd, const raytMaterial& material, glm::vec3 normal) const;
+	void shade_light(const sceneContainer& scene, glm::vec3 lightDir, glm::vec3 lightColor, float intensity, glm::vec3 pt, glm::vec3 rd,
+		const raytMaterial& material, glm::vec3 normal, float dist, float distDiv, glm::vec3& diffuse, glm::vec3& specular) const;
+	glm::vec3 reflected_color(const sceneContainer& scene, glm::vec3 ro, glm::vec3 rd) const;
+};
@@ -0,0 +1,101 @@
+#include "FileSystem.h"
+#include <cstdio>
+#include <iostream>
+#include <sys/stat.h>
+
+using namespace std;
+
+File_System& File_System::assets()
+{
+	static File_System instance;
+	return instance;
+}
+
+bool File_System::mount_pack(const char* path)
+{
+	shared_ptr<Mapped_File> file = make_shared<Mapped_File>();
+	if (!file->open(path, false))
+		return false;
+	const rpakEntry* index = rpak_entries(file->data(), file->size());
+	if (!index)
+	{
+		cout << "Malformed pack file: " << path << endl;
+		return false;
+	}
+
+	pack = file;
+	entries = index;
+	entryCount = reinterpret_cast<const rpakHeader*>(file->data())->entries;
+	printf("Pack '%s': %u files, %zu bytes\n", path, entryCount, file->size());
+	return true;
+}
+
+void File_System::mount_dir(const string& prefix, const string& dir)
+{
+	mounts.push_back({ prefix, dir });
+}
+
+// binary search, the index is sorted by name
+const rpakEntry* File_System::find(const string& name) const
+{
+	uint32_t first = 0, last = entryCount;
+	while (first < last)
+	{
+		uint32_t middle = first + (last - first) / 2;
+		int order = name.compare(entries[middle].name);
+		if (order == 0)
+			return &entries[middle];
+		if (order < 0)
+			last = middle;
+		else
+			first = middle + 1;
+	}
+	return nullptr;
+}
+
+string File_System::loose_path(const string& name) const
+{
+	for (const Mount& mount : mounts)
+	{
+		if (name.compare(0, mount.prefix.size(), mount.prefix) != 0)
+			continue;
+		string path = mount.dir + "/" + name.substr(mount.prefix.size());
+		struct stat info;
+		if (stat(path.c_str(), &info) == 0)
+			return path;
+	}
+	return string();
+}
+
+bool File_System::open(const string& name, Asset_Span& span, bool populate) const
+{
+	for (const Mount& mount : mounts)
+	{
+		if (name.compare(0, mount.prefix.size(), mount.prefix) != 0)
+			continue;
+		shared_ptr<Mapped_File> file = make_shared<Mapped_File>();
+		if (!file->open((mount.dir + "/" + name.substr(mount.prefix.size())).c_str(), populate))
+			continue;
+		span.bytes = file->data();
+		span.length = file->size();
+		span.file = file;
+		return true;
+	}
+
+	const rpakEntry* entry = pack ? find(name) : nullptr;
+	if (!entry)
+		return false;
+	span.bytes = pack->data() + entry->offset;
+	span.length = static_cast<size_t>(entry->size);
+	span.file = pack;
+	return true;
+}
+
+bool File_System::read_string(const string& name, string& text) const
+{
+	Asset_Span span;
+	if (!open(name, span))
+		return false;
+	text.assign(reinterpret_cast<const char*>(span.data()), span.size());
+	return true;
+}
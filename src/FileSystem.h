@@ -0,0 +1,63 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include "MappedFile.h"
+#include "PackFile.h"
+
+using namespace std;
+
+// bytes of one asset file, a span into the mapped pack or a loose file mapped on its
+// own, valid as long as the span is held
+class Asset_Span
+{
+public:
+	const unsigned char* data() const { return bytes; }
+	size_t size() const { return length; }
+	bool empty() const { return !file; }
+
+private:
+	friend class File_System;
+	shared_ptr<const Mapped_File> file; // keeps the mapping alive
+	const unsigned char* bytes = nullptr;
+	size_t length = 0;
+};
+
+// Assets are looked up by name, "shaders/fshader.fs", first in the mounted loose
+// directories, then in the mounted pack. Release builds serve everything from the one
+// mapped pack; during development the source directories are mounted on top of it so
+// edited files win without repacking. Mount before the first lookup, lookups are safe
+// from any thread after that.
+class File_System
+{
+public:
+	// the one the renderer loads shaders and textures through
+	static File_System& assets();
+
+	// false if the pack is missing or malformed, mapped without populating, entries
+	// are read in as they are used
+	bool mount_pack(const char* path);
+	// names starting with prefix are looked for under dir, prefix ends in '/'
+	void mount_dir(const string& prefix, const string& dir);
+
+	// populate as for Mapped_File, for loose files, the pack is mapped once
+	bool open(const string& name, Asset_Span& span, bool populate = true) const;
+	bool read_string(const string& name, string& text) const;
+	// path of the loose file name resolves to, empty if it is in the pack or missing
+	string loose_path(const string& name) const;
+
+private:
+	struct Mount
+	{
+		string prefix;
+		string dir;
+	};
+
+	vector<Mount> mounts;
+	shared_ptr<Mapped_File> pack;
+	const rpakEntry* entries = nullptr;
+	uint32_t entryCount = 0;
+
+	const rpakEntry* find(const string& name) const;
+};
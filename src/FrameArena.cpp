@@ -0,0 +1,60 @@
+#include "FrameArena.h"
+#include <cstdio>
+#include <new>
+#include <algorithm>
+
+using namespace std;
+
+Frame_Arena::Frame_Arena(size_t bytesPerFrame)
+{
+	halves[0].resize(bytesPerFrame);
+	halves[1].resize(bytesPerFrame);
+}
+
+Frame_Arena& Frame_Arena::render()
+{
+	static Frame_Arena instance;
+	return instance;
+}
+
+void Frame_Arena::begin_frame()
+{
+	current ^= 1;
+	offset = 0;
+}
+
+void* Frame_Arena::allocate(size_t bytes, size_t alignment)
+{
+	vector<unsigned char>& half = halves[current];
+	uintptr_t base = reinterpret_cast<uintptr_t>(half.data());
+	size_t start = ((base + offset + alignment - 1) & ~(alignment - 1)) - base;
+	if (start + bytes > half.size())
+	{
+		overflows++;
+		return ::operator new(bytes);
+	}
+	offset = start + bytes;
+	peak = max(peak, offset);
+	return half.data() + start;
+}
+
+void Frame_Arena::deallocate(void* p)
+{
+	if (!owns(p))
+		::operator delete(p);
+}
+
+bool Frame_Arena::owns(const void* p) const
+{
+	const unsigned char* byte = static_cast<const unsigned char*>(p);
+	for (const vector<unsigned char>& half : halves)
+		if (byte >= half.data() && byte < half.data() + half.size())
+			return true;
+	return false;
+}
+
+void Frame_Arena::report() const
+{
+	printf("Frame arena: %zu of %zu bytes at most in a frame, %llu allocations went to the heap\n", peak, halves[0].size(),
+		static_cast<unsigned long long>(overflows));
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+// Linear allocator for what the render thread builds and throws away within a frame:
+// allocation bumps an offset, nothing is freed on its own, begin_frame() drops
+// everything at once. There are two halves used in turns, what was allocated in the
+// previous frame stays valid through the current one, for data a transfer or draw of
+// that frame may still read. What does not fit in the half goes to the heap and is
+// counted, report() tells whether the arena should be larger.
+class Frame_Arena
+{
+public:
+	explicit Frame_Arena(size_t bytesPerFrame = Default_Size);
+
+	Frame_Arena(const Frame_Arena&) = delete;
+	Frame_Arena& operator=(const Frame_Arena&) = delete;
+
+	// the render thread's arena, begun by the frame loop
+	static Frame_Arena& render();
+
+	// switches halves, the one written two frames ago is reused
+	void begin_frame();
+
+	void* allocate(size_t bytes, size_t alignment);
+	// only frees what overflowed to the heap
+	void deallocate(void* p);
+
+	template<typename T>
+	T* allocate(size_t count)
+	{
+		return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+	}
+
+	void report() const;
+
+	static const size_t Default_Size = 1 << 20;
+
+private:
+	vector<unsigned char> halves[2];
+	int current = 0;
+	size_t offset = 0;
+	size_t peak = 0;
+	uint64_t overflows = 0;
+
+	bool owns(const void* p) const;
+};
+
+// Standard allocator over a Frame_Arena, for containers that live no longer than the
+// frame after the one they were made in:
+//   vector<int, Frame_Allocator<int>> list(Frame_Allocator<int>(Frame_Arena::render()));
+template<typename T>
+class Frame_Allocator
+{
+public:
+	typedef T value_type;
+
+	explicit Frame_Allocator(Frame_Arena& arena) : arena(&arena) {}
+	template<typename U>
+	Frame_Allocator(const Frame_Allocator<U>& other) : arena(other.arena) {}
+
+	T* allocate(size_t count) { return arena->allocate<T>(count); }
+	void deallocate(T* p, size_t) { arena->deallocate(p); }
+
+	template<typename U>
+	bool operator==(const Frame_Allocator<U>& other) const { return arena == other.arena; }
+	template<typename U>
+	bool operator!=(const Frame_Allocator<U>& other) const { return arena != other.arena; }
+
+private:
+	template<typename U>
+	friend class Frame_Allocator;
+	Frame_Arena* arena;
+};
@@ -0,0 +1,168 @@
+#include "FrameCapture.h"
+#include "ImageWriter.h"
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <iostream>
+
+using namespace std;
+
+static double elapsed_ms(chrono::steady_clock::time_point since)
+{
+	return chrono::duration<double, milli>(chrono::steady_clock::now() - since).count();
+}
+
+Frame_Capture::Frame_Capture(Thread_Pool& pool, int width, int height, const string& outputPath)
+	: pool(pool), width(width), height(height)
+{
+	size_t dot = outputPath.find_last_of('.');
+	size_t slash = outputPath.find_last_of('/');
+	if (dot != string::npos && (slash == string::npos || dot > slash))
+	{
+		prefix = outputPath.substr(0, dot);
+		extension = outputPath.substr(dot);
+	}
+	else
+	{
+		prefix = outputPath;
+		extension = ".png";
+	}
+	hdr = extension == ".exr" || extension == ".EXR";
+	frameBytes = static_cast<size_t>(width) * height * 4 * (hdr ? sizeof(float) : 1);
+}
+
+Frame_Capture::~Frame_Capture()
+{
+	for (Slot& slot : slots)
+	{
+		if (slot.fence)
+			glDeleteSync(slot.fence);
+		if (slot.pbo)
+			glDeleteBuffers(1, &slot.pbo);
+	}
+	if (framebuffer)
+		glDeleteFramebuffers(1, &framebuffer);
+	if (colorTex)
+		glDeleteTextures(1, &colorTex);
+	wait_encodes();
+}
+
+void Frame_Capture::wait_encodes()
+{
+	for (Job_Counter& counter : encodes)
+		pool.wait(counter);
+}
+
+bool Frame_Capture::init()
+{
+	glGenTextures(1, &colorTex);
+	glBindTexture(GL_TEXTURE_2D, colorTex);
+	glTexImage2D(GL_TEXTURE_2D, 0, hdr ? GL_RGBA16F : GL_RGBA8, width, height, 0, GL_RGBA, hdr ? GL_FLOAT : GL_UNSIGNED_BYTE, nullptr);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTex, 0);
+	bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if (!complete)
+	{
+		cout << "Frame capture: the offscreen framebuffer is incomplete" << endl;
+		return false;
+	}
+
+	for (Slot& slot : slots)
+	{
+		glGenBuffers(1, &slot.pbo);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+		glBufferData(GL_PIXEL_PACK_BUFFER, frameBytes, nullptr, GL_STREAM_READ);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	printf("Frame capture: %dx%d %s to %s_####%s, %d buffers of %zu bytes\n", width, height, hdr ? "half float" : "8 bit",
+		prefix.c_str(), extension.c_str(), Ring_Size, frameBytes);
+	return true;
+}
+
+void Frame_Capture::begin_frame()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glViewport(0, 0, width, height);
+}
+
+void Frame_Capture::end_frame()
+{
+	// the readback only starts the transfer, nothing waits for it here
+	Slot& slot = slots[queued % Ring_Size];
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+	glReadPixels(0, 0, width, height, GL_RGBA, hdr ? GL_FLOAT : GL_UNSIGNED_BYTE, nullptr);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	queued++;
+
+	if (queued - collected > Readback_Lag)
+		collect();
+}
+
+// the oldest frame in the ring, its slot is free again afterwards
+void Frame_Capture::collect()
+{
+	auto start = chrono::steady_clock::now();
+	Slot& slot = slots[collected % Ring_Size];
+	while (glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 100000000) == GL_TIMEOUT_EXPIRED)
+		;
+	glDeleteSync(slot.fence);
+	slot.fence = nullptr;
+	// the frame Max_Encoding before this one is written
+	Job_Counter& counter = encodes[collected % Max_Encoding];
+	pool.wait(counter);
+	waitMs += elapsed_ms(start);
+
+	shared_ptr<vector<unsigned char>> pixels = make_shared<vector<unsigned char>>(frameBytes);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+	const void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frameBytes, GL_MAP_READ_BIT);
+	if (mapped)
+		memcpy(pixels->data(), mapped, frameBytes);
+	glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	string path = frame_path(collected);
+	collected++;
+	if (!mapped)
+	{
+		cout << "Frame capture: failed to map the readback of " << path << endl;
+		failed++;
+		return;
+	}
+
+	bool hdr = this->hdr;
+	int width = this->width, height = this->height;
+	pool.submit([this, pixels, path, hdr, width, height]
+	{
+		auto start = chrono::steady_clock::now();
+		bool ok = hdr ? write_exr(path, width, height, reinterpret_cast<const float*>(pixels->data()), true)
+			: write_png(path, width, height, pixels->data(), true);
+		encodeNs += static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
+		if (!ok)
+			failed++;
+	}, &counter);
+}
+
+bool Frame_Capture::finish()
+{
+	while (collected < queued)
+		collect();
+	wait_encodes();
+	if (collected > 0)
+		printf("Frame capture: %d frames, %.1f ms waited on readback and the pool, %.1f ms encoding per frame on the pool\n", collected,
+			waitMs, encodeNs / 1e6 / collected);
+	return failed == 0;
+}
+
+string Frame_Capture::frame_path(int frame) const
+{
+	char number[16];
+	snprintf(number, sizeof(number), "_%04d", frame);
+	return prefix + number + extension;
+}
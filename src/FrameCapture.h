@@ -0,0 +1,71 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <string>
+#include <atomic>
+#include "ThreadPool.h"
+
+using namespace std;
+
+// Writes a sequence of rendered frames to numbered image files without stalling the
+// renderer on them. Frames are drawn into an offscreen framebuffer and read back into
+// a ring of pixel buffer objects, each with a fence; a frame's buffer is mapped only
+// Readback_Lag frames later, when the GPU is long done with it, and the copy is encoded
+// and written on the thread pool. Drawing, the transfer and the encoding of different
+// frames overlap, and at most Max_Encoding frames wait for the pool before end_frame()
+// holds the renderer back, which then runs pool jobs itself until the oldest is written.
+// Output ending in .exr is written as half float EXR from an RGBA16F framebuffer,
+// anything else as PNG.
+class Frame_Capture
+{
+public:
+	// outputPath "shots/frame.png" writes shots/frame_0000.png and on
+	Frame_Capture(Thread_Pool& pool, int width, int height, const string& outputPath);
+	~Frame_Capture();
+
+	Frame_Capture(const Frame_Capture&) = delete;
+	Frame_Capture& operator=(const Frame_Capture&) = delete;
+
+	// GL thread, false with a message if the framebuffer cannot be created
+	bool init();
+	// binds the framebuffer and the viewport, draw the frame after this
+	void begin_frame();
+	// queues the frame's readback and hands the one Readback_Lag behind to the pool
+	void end_frame();
+	// reads back the frames still queued and waits until every file is written, false
+	// if one could not be
+	bool finish();
+
+	static const int Ring_Size = 3;
+	static const int Readback_Lag = 2;
+	static const int Max_Encoding = 8;
+
+private:
+	struct Slot
+	{
+		GLuint pbo = 0;
+		GLsync fence = nullptr;
+	};
+
+	Thread_Pool& pool;
+	int width, height;
+	string prefix, extension;
+	bool hdr;
+	size_t frameBytes;
+
+	GLuint framebuffer = 0;
+	GLuint colorTex = 0;
+	Slot slots[Ring_Size];
+	int queued = 0; // frames read back into the ring
+	int collected = 0; // frames taken out of it
+
+	// frame i's encoding is counted in encodes[i % Max_Encoding]
+	Job_Counter encodes[Max_Encoding];
+	atomic<int> failed{ 0 };
+	double waitMs = 0; // on fences and on encodes, the stalls the lag did not hide
+	atomic<uint64_t> encodeNs{ 0 };
+
+	void collect();
+	void wait_encodes();
+	string frame_path(int frame) const;
+};
@@ -0,0 +1,76 @@
+#include "FramePacer.h"
+#include <chrono>
+#include <cstdio>
+#include <algorithm>
+
+using namespace std;
+
+static void print_percentiles(const char* what, vector<double> samples)
+{
+	if (samples.empty())
+	{
+		printf("%s: no samples\n", what);
+		return;
+	}
+	sort(samples.begin(), samples.end());
+	auto at = [&](double p) { return samples[min(samples.size() - 1, static_cast<size_t>(p * samples.size()))]; };
+	printf("%s: %zu samples, p50 %.2f ms, p90 %.2f ms, p99 %.2f ms, max %.2f ms\n", what, samples.size(), at(0.5), at(0.9),
+		at(0.99), samples.back());
+}
+
+Frame_Pacer::Frame_Pacer(int framesInFlight)
+	: framesInFlight(max(framesInFlight, -1))
+{
+	frameMs.reserve(Reserved_Samples);
+	latencyMs.reserve(Reserved_Samples);
+}
+
+Frame_Pacer::~Frame_Pacer()
+{
+	for (GLsync fence : fences)
+		glDeleteSync(fence);
+}
+
+double Frame_Pacer::now()
+{
+	return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Frame_Pacer::begin_frame()
+{
+	while (framesInFlight > 0 && static_cast<int>(fences.size()) >= framesInFlight)
+	{
+		GLsync fence = fences.front();
+		fences.pop_front();
+		// flushes on the first wait, in case the fence was not submitted yet
+		while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 100000000) == GL_TIMEOUT_EXPIRED)
+			;
+		glDeleteSync(fence);
+	}
+}
+
+void Frame_Pacer::presented(double oldestInput)
+{
+	if (framesInFlight == 0)
+		glFinish();
+	else if (framesInFlight > 0)
+		fences.push_back(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+
+	double time = now();
+	if (lastPresent >= 0)
+		frameMs.push_back((time - lastPresent) * 1000);
+	lastPresent = time;
+	if (oldestInput >= 0)
+		latencyMs.push_back((time - oldestInput) * 1000);
+}
+
+void Frame_Pacer::report() const
+{
+	const char* modes[] = { "driver", "glFinish" };
+	if (framesInFlight < 1)
+		printf("Frame pacing: %s\n", modes[framesInFlight + 1]);
+	else
+		printf("Frame pacing: at most %d frames in flight\n", framesInFlight);
+	print_percentiles("Frame time", frameMs);
+	print_percentiles("Input to present", latencyMs);
+}
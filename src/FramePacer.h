@@ -0,0 +1,46 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <vector>
+#include <deque>
+
+using namespace std;
+
+// Paces the render loop and measures it. begin_frame() holds the CPU back until the GPU
+// is close enough behind, presented() follows glfwSwapBuffers and records the frame time
+// and, for frames that showed new input, the time from the input callback to the
+// present. With framesInFlight -1 the driver decides how far the CPU runs ahead, with
+// 0 every frame is finished with glFinish before the next one starts, and with n > 0 a
+// fence per frame lets at most n frames be queued. Fewer frames in flight means input
+// is sampled later, closer to when its frame is shown, at some cost in throughput. The
+// present is taken as the return of glfwSwapBuffers, or of the glFinish after it.
+class Frame_Pacer
+{
+public:
+	explicit Frame_Pacer(int framesInFlight = -1);
+	~Frame_Pacer();
+
+	Frame_Pacer(const Frame_Pacer&) = delete;
+	Frame_Pacer& operator=(const Frame_Pacer&) = delete;
+
+	// seconds on a monotonic clock, full double precision, for input time stamps
+	static double now();
+
+	// before the frame's input is sampled
+	void begin_frame();
+	// after glfwSwapBuffers, oldestInput as from Simulation::take_shown_input
+	void presented(double oldestInput);
+
+	// frame times and input to present latencies as percentiles
+	void report() const;
+
+	// the sample lists only grow after this many frames, about 18 minutes at 60 Hz
+	static const size_t Reserved_Samples = 1 << 16;
+
+private:
+	int framesInFlight;
+	deque<GLsync> fences; // of the frames queued, oldest first
+	double lastPresent = -1;
+	vector<double> frameMs;
+	vector<double> latencyMs;
+};
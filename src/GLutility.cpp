@@ -1,8 +1,8 @@
 #include "GLutility.h"
 #include <iostream>
 #include "scene.h"
-#include <stb_image.h>
 #include "shader.h"
+#include "ShaderPreprocessor.h"
 
 using namespace std;
 
@@ -19,7 +19,7 @@ GL_Utility::GL_Utility(int width, int height, bool fullScreen)
 	this->useCustomResolution = true;
 }
 
-bool GL_Utility::setup_window()
+bool GL_Utility::setup_window(bool visible)
 {
 	if (!glfwInit())
 		return false;
@@ -28,6 +28,7 @@ bool GL_Utility::setup_window()
 
 	glfwSetErrorCallback(glfw_error_callback);
 
+	glfwWindowHint(GLFW_VISIBLE, visible ? GLFW_TRUE : GLFW_FALSE);
 	window = glfwCreateWindow(width, height, "RayTracing", fullScreen ? monitor : NULL, NULL);
 	glfwGetWindowSize(window, &width, &height);
 
@@ -59,79 +60,123 @@ void GL_Utility::draw(GLuint quadVAO)
 	return;
 }
 
+bool GL_Utility::open_program_cache(const string& dir)
+{
+	return programs.open(dir);
+}
+
 void GL_Utility::create_shaders(raytDefines& defines)
 {
-	const std::string vertexShaderSrc = readStringFromFile(ASSETS_DIR "/shaders/vshader.vs");
-	std::string fragmentShaderSrc = readStringFromFile(ASSETS_DIR "/shaders/fshader.fs");
-	
-	replace(fragmentShaderSrc, "{SPHERE_SIZE}", std::to_string(defines.sphere_size));
-	replace(fragmentShaderSrc, "{SURFACE_SIZE}", std::to_string(defines.surface_size));
-	replace(fragmentShaderSrc, "{BOX_SIZE}", std::to_string(defines.box_size));
-	replace(fragmentShaderSrc, "{LIGHT_POINT_SIZE}", std::to_string(defines.light_point_size));
-	replace(fragmentShaderSrc, "{LIGHT_DIRECT_SIZE}", std::to_string(defines.light_direct_size));
-	replace(fragmentShaderSrc, "{ITERATIONS}", std::to_string(defines.iterations));
-	replace(fragmentShaderSrc, "{AMBIENT_COLOR}", to_string(defines.ambient_color));
-	replace(fragmentShaderSrc, "{SHADOW_AMBIENT}", to_string(defines.shadow_ambient));
+	std::string vertexShaderSrc, fragmentShaderSrc, errors;
+	uint64_t hash;
+	if (!shader_sources(defines, vertexShaderSrc, fragmentShaderSrc, hash, errors))
+	{
+		std::cout << "ERROR::SHADER_PREPROCESSING\n" << errors << std::endl;
+		exit(1);
+	}
+	this->defines = defines;
 
-	shader.createShader(vertexShaderSrc.c_str(), fragmentShaderSrc.c_str());
+	// a variant built in an earlier run is loaded from the cache
+	double start = glfwGetTime();
+	shader.ID = programs.load(hash);
+	bool cached = shader.ID != 0;
+	if (!cached)
+	{
+		shader.createShader(vertexShaderSrc.c_str(), fragmentShaderSrc.c_str());
+		programs.store(hash, shader.ID);
+	}
+	printf("Shader variant %02x %s in %.1f ms\n", defines.features, cached ? "loaded from the cache" : "compiled",
+		(glfwGetTime() - start) * 1000);
 
 	shader.use();
 
 	checkGlErrors("Shader creation");
 }
 
-std::string GL_Utility::to_string(glm::vec3 v)
+bool GL_Utility::shader_sources(const raytDefines& defines, string& vertexShaderSrc, string& fragmentShaderSrc, uint64_t& hash,
+	string& errors)
 {
-	return std::string().append("vec3(").append(std::to_string(v.x)).append(",").append(std::to_string(v.y)).append(",").append(std::to_string(v.z)).append(")");
+	Shader_Preprocessor vertex;
+	if (!vertex.process("shaders/vshader.vs", vertexShaderSrc, errors))
+		return false;
+
+	Shader_Preprocessor fragment;
+	fragment.define("SPHERE_SIZE", defines.sphere_size);
+	fragment.define("SURFACE_SIZE", defines.surface_size);
+	fragment.define("BOX_SIZE", defines.box_size);
+	fragment.define("MESH_INSTANCE_SIZE", defines.mesh_instance_size);
+	fragment.define("MATERIAL_SIZE", defines.material_size);
+	fragment.define("LIGHT_POINT_SIZE", defines.light_point_size);
+	fragment.define("LIGHT_DIRECT_SIZE", defines.light_direct_size);
+	fragment.define("ITERATIONS", defines.iterations);
+	fragment.define("AMBIENT_COLOR", to_string(defines.ambient_color));
+	fragment.define("SHADOW_AMBIENT", to_string(defines.shadow_ambient));
+	fragment.define("FEATURES", feature_defines(defines.features));
+	if (!fragment.process("shaders/fshader.fs", fragmentShaderSrc, errors))
+		return false;
+
+	uint64_t stages[2] = { vertex.hash(), fragment.hash() };
+	hash = hash_bytes(stages, sizeof(stages));
+	return true;
 }
 
-unsigned int GL_Utility::load_texture(char const* path, GLuint wrapMode)
+std::string GL_Utility::feature_defines(unsigned features)
 {
-	unsigned int textureID;
-	glGenTextures(1, &textureID);
+	static const struct { unsigned feature; const char* name; } names[] = {
+		{ FEATURE_REFRACTION, "Has_Refraction" },
+		{ FEATURE_TEXTURES, "Has_Textures" },
+		{ FEATURE_SURFACES, "Has_Surfaces" },
+		{ FEATURE_LIGHTS_DIRECT, "Has_Lights_Direct" },
+		{ FEATURE_SHADOWS, "Shadow_Enabled" },
+		{ FEATURE_FRESNEL, "Do_Fresnel" },
+		{ FEATURE_TOTAL_INTERNAL_REFLECTION, "Total_Internal_Reflection" },
+		{ FEATURE_REFRACTION_FREE_ITERATION, "Reflect_Reduce_Iteration" },
+	};
+	std::string lines;
+	for (const auto& name : names)
+		lines.append("#define ").append(name.name).append((features & name.feature) ? " 1\n" : " 0\n");
+	return lines;
+}
 
-	int width, height, nrComponents;
-	unsigned char* data = stbi_load(path, &width, &height, &nrComponents, 0);
-	if (data)
-	{
-		GLenum format;
-		if (nrComponents == 1)
-			format = GL_RED;
-		else if (nrComponents == 3)
-			format = GL_RGB;
-		else if (nrComponents == 4)
-			format = GL_RGBA;
-
-		glBindTexture(GL_TEXTURE_2D, textureID);
-		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
-		
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapMode);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapMode);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		stbi_image_free(data);
-	}
-	else
+void GL_Utility::swap_program(GLuint program)
+{
+	glDeleteProgram(shader.ID);
+	shader.ID = program;
+	shader.use();
+
+	// a block or sampler the new source no longer declares is skipped
+	for (const auto& binding : blockBindings)
 	{
-		cout << "Texture failed to load at path: " << path << endl;
-		stbi_image_free(data);
+		GLuint blockIndex = glGetUniformBlockIndex(program, binding.first.c_str());
+		if (blockIndex != GL_INVALID_INDEX)
+			glUniformBlockBinding(program, blockIndex, binding.second);
 	}
+	for (const auto& uniform : intUniforms)
+		shader.setInt(uniform.first, uniform.second);
+	for (const auto& uniform : ivec4Uniforms)
+		shader.setIVec4(uniform.first, uniform.second.x, uniform.second.y, uniform.second.z, uniform.second.w);
+
+	checkGlErrors("Shader swap");
+}
+
+std::string GL_Utility::to_string(glm::vec3 v)
+{
+	return std::string().append("vec3(").append(std::to_string(v.x)).append(",").append(std::to_string(v.y)).append(",").append(std::to_string(v.z)).append(")");
+}
 
-	return textureID;
+void GL_Utility::set_int(const char* uniformName, int value)
+{
+	shader.setInt(uniformName, value);
+	intUniforms[uniformName] = value;
 }
 
-GLuint GL_Utility::load_texture(int texNum, const char* name, const char* uniformName, GLuint wrapMode)
+void GL_Utility::set_ivec4(const char* uniformName, int x, int y, int z, int w)
 {
-	const std::string path = ASSETS_DIR "/textures/" + std::string(name);
-	const unsigned int tex = load_texture(path.c_str(), wrapMode);
-	shader.setInt(uniformName, texNum);
-	textures.push_back(tex);
-	return tex;
+	shader.setIVec4(uniformName, x, y, z, w);
+	ivec4Uniforms[uniformName] = glm::ivec4(x, y, z, w);
 }
 
-void GL_Utility::init_buffer(GLuint* ubo, const char* name, int bindingPoint, size_t size, void* data) const
+void GL_Utility::init_buffer(GLuint* ubo, const char* name, int bindingPoint, size_t size, void* data)
 {
 	glGenBuffers(1, ubo);
 	glBindBuffer(GL_UNIFORM_BUFFER, *ubo);
@@ -143,13 +188,47 @@ void GL_Utility::init_buffer(GLuint* ubo, const char* name, int bindingPoint, si
 		exit(1);
 	}
 	glUniformBlockBinding(shader.ID, blockIndex, bindingPoint);
+	blockBindings[name] = bindingPoint;
 	glBindBufferBase(GL_UNIFORM_BUFFER, bindingPoint, *ubo);
 	glBindBuffer(GL_UNIFORM_BUFFER, 0);
 }
 
-void GL_Utility::update_buffer(GLuint ubo, size_t size, void* data)
+void GL_Utility::init_texture_buffer(GLuint* tbo, GLuint* tex, GLenum format, int texNum, const char* uniformName, size_t size, const void* data)
+{
+	// empty buffer textures are not allowed, keep at least one texel
+	const float empty[4] = {};
+	if (size == 0)
+	{
+		size = sizeof(empty);
+		data = empty;
+	}
+
+	glGenBuffers(1, tbo);
+	glBindBuffer(GL_TEXTURE_BUFFER, *tbo);
+	glBufferData(GL_TEXTURE_BUFFER, size, data, GL_STATIC_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	glGenTextures(1, tex);
+	glActiveTexture(GL_TEXTURE0 + texNum);
+	glBindTexture(GL_TEXTURE_BUFFER, *tex);
+	glTexBuffer(GL_TEXTURE_BUFFER, format, *tbo);
+	glActiveTexture(GL_TEXTURE0);
+
+	set_int(uniformName, texNum);
+	textures.push_back(*tex);
+}
+
+void GL_Utility::update_buffer(GLuint ubo, size_t size, const void* data, size_t offset)
 {
 	glBindBuffer(GL_UNIFORM_BUFFER, ubo);
-	glBufferSubData(GL_UNIFORM_BUFFER, 0, size, data);
+	glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
 	glBindBuffer(GL_UNIFORM_BUFFER, 0);
 }
+
+void GL_Utility::update_texture_buffer(GLuint tbo, size_t size, const void* data)
+{
+	// orphan the old storage, the size may change
+	glBindBuffer(GL_TEXTURE_BUFFER, tbo);
+	glBufferData(GL_TEXTURE_BUFFER, size, data, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
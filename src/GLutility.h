@@ -4,31 +4,53 @@
 #include <GLFW/glfw3.h>
 #include <string>
 #include <vector>
+#include <map>
 #include <glm/glm.hpp>
 #include "shader.h"
 #include "utils.h"
+#include "ShaderCache.h"
 
 using namespace std;
 
-struct raytDefines;
+#include "scene.h"
 
 class GL_Utility
 {
 public:
 	GL_Utility(int width, int height, bool fullScreen);
 
-	bool setup_window();
+	// a hidden window only provides the context, for offscreen rendering
+	bool setup_window(bool visible = true);
+	// linked variants are kept in dir and loaded by create_shaders, after setup_window
+	bool open_program_cache(const string& dir);
 	void create_shaders(raytDefines& defines);
+	// the sources create_shaders compiles, see Shader_Preprocessor, with the placeholders
+	// filled in from defines, hash identifies the pair, false with the reasons in errors
+	static bool shader_sources(const raytDefines& defines, string& vertex, string& fragment, uint64_t& hash, string& errors);
+	const raytDefines& shader_defines() const { return defines; }
+	// replaces the program with one built from shader_sources, block bindings and the
+	// uniforms set through this class carry over, the old program is deleted
+	void swap_program(GLuint program);
 
 	GLFWwindow* window;
 
 	void draw(GLuint quadVAO);
-	GLuint load_texture(int texNum, const char* name, const char* uniformName, GLuint wrapMode = GL_REPEAT);
-	void init_buffer(GLuint* ubo, const char* name, int bindingPoint, size_t size, void* data) const;
-	static void update_buffer(GLuint ubo, size_t size, void* data);
+	void set_int(const char* uniformName, int value);
+	void set_ivec4(const char* uniformName, int x, int y, int z, int w);
+	void init_buffer(GLuint* ubo, const char* name, int bindingPoint, size_t size, void* data);
+	void init_texture_buffer(GLuint* tbo, GLuint* tex, GLenum format, int texNum, const char* uniformName, size_t size, const void* data);
+	// size bytes from data to offset bytes into the buffer
+	static void update_buffer(GLuint ubo, size_t size, const void* data, size_t offset = 0);
+	static void update_texture_buffer(GLuint tbo, size_t size, const void* data);
 
 private:
 	Shader shader;
+	Shader_Cache programs;
+	raytDefines defines = {};
+	// what was set on the program, to set again on a swapped in one
+	map<string, int> blockBindings;
+	map<string, int> intUniforms;
+	map<string, glm::ivec4> ivec4Uniforms;
 	GLuint fboColor, fboTexColor, fboEdge, fboTexEdge, fboBlend, fboTexBlend;
 	vector<GLuint> textures;
 
@@ -39,8 +61,8 @@ private:
 	bool useCustomResolution = false;
 
 	void gen_framebuffer(GLuint* fbo, GLuint* fboTex, GLenum internalFormat, GLenum format) const;
-	
-	static GLuint load_texture(char const* path, GLuint wrapMode = GL_REPEAT);
+
 	static std::string to_string(glm::vec3 v);
+	static std::string feature_defines(unsigned features);
 };
 
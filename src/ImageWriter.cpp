@@ -0,0 +1,318 @@
+#include "ImageWriter.h"
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <iostream>
+#include <glm/gtc/packing.hpp>
+
+using namespace std;
+
+// LSB first, as deflate wants it
+class Bit_Writer
+{
+public:
+	explicit Bit_Writer(vector<unsigned char>& out) : out(out) {}
+
+	void bits(uint32_t value, int count)
+	{
+		buffer |= static_cast<uint64_t>(value) << used;
+		used += count;
+		while (used >= 8)
+		{
+			out.push_back(static_cast<unsigned char>(buffer));
+			buffer >>= 8;
+			used -= 8;
+		}
+	}
+	// Huffman codes go out most significant bit first
+	void code(uint32_t value, int count)
+	{
+		uint32_t reversed = 0;
+		for (int i = 0; i < count; i++)
+			reversed |= ((value >> i) & 1) << (count - 1 - i);
+		bits(reversed, count);
+	}
+	void flush()
+	{
+		if (used > 0)
+			out.push_back(static_cast<unsigned char>(buffer));
+		buffer = 0;
+		used = 0;
+	}
+
+private:
+	vector<unsigned char>& out;
+	uint64_t buffer = 0;
+	int used = 0;
+};
+
+static const uint16_t Length_Base[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83,
+	99, 115, 131, 163, 195, 227, 258 };
+static const uint8_t Length_Extra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const uint16_t Distance_Base[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769,
+	1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const uint8_t Distance_Extra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11,
+	12, 12, 13, 13 };
+
+static void literal(Bit_Writer& out, int symbol)
+{
+	if (symbol < 144)
+		out.code(0x30 + symbol, 8);
+	else if (symbol < 256)
+		out.code(0x190 + symbol - 144, 9);
+	else if (symbol < 280)
+		out.code(symbol - 256, 7);
+	else
+		out.code(0xc0 + symbol - 280, 8);
+}
+
+static void match(Bit_Writer& out, int length, int distance)
+{
+	int l = 28;
+	while (Length_Base[l] > length)
+		l--;
+	literal(out, 257 + l);
+	out.bits(length - Length_Base[l], Length_Extra[l]);
+	int d = 29;
+	while (Distance_Base[d] > distance)
+		d--;
+	out.code(d, 5);
+	out.bits(distance - Distance_Base[d], Distance_Extra[d]);
+}
+
+// zlib stream of one fixed Huffman block, LZ77 matches from a hash chain of bounded length
+static void zlib_compress(const vector<unsigned char>& data, vector<unsigned char>& out)
+{
+	const int Window = 32768, Max_Match = 258, Max_Chain = 32, Hash_Bits = 15;
+	out.push_back(0x78);
+	out.push_back(0x01);
+
+	Bit_Writer bits(out);
+	bits.bits(1, 1); // final
+	bits.bits(1, 2); // fixed codes
+	vector<int> head(1 << Hash_Bits, -1), previous(Window, -1);
+	auto hash = [&](size_t i) { return ((data[i] << 10) ^ (data[i + 1] << 5) ^ data[i + 2]) & ((1 << Hash_Bits) - 1); };
+	auto insert = [&](size_t i)
+	{
+		int h = hash(i);
+		previous[i % Window] = head[h];
+		head[h] = static_cast<int>(i);
+	};
+
+	size_t size = data.size(), i = 0;
+	while (i < size)
+	{
+		int bestLength = 0, bestDistance = 0;
+		if (i + 3 <= size)
+		{
+			int limit = static_cast<int>(min<size_t>(Max_Match, size - i));
+			int candidate = head[hash(i)];
+			for (int chain = 0; candidate >= 0 && chain < Max_Chain && i - candidate <= Window; chain++)
+			{
+				int length = 0;
+				while (length < limit && data[candidate + length] == data[i + length])
+					length++;
+				if (length > bestLength)
+				{
+					bestLength = length;
+					bestDistance = static_cast<int>(i - candidate);
+					if (length == limit)
+						break;
+				}
+				candidate = previous[candidate % Window];
+			}
+		}
+
+		if (bestLength >= 3)
+		{
+			match(bits, bestLength, bestDistance);
+			for (int k = 0; k < bestLength; k++, i++)
+				if (i + 3 <= size)
+					insert(i);
+		}
+		else
+		{
+			literal(bits, data[i]);
+			if (i + 3 <= size)
+				insert(i);
+			i++;
+		}
+	}
+	literal(bits, 256);
+	bits.flush();
+
+	uint32_t a = 1, b = 0;
+	for (unsigned char byte : data)
+	{
+		a = (a + byte) % 65521;
+		b = (b + a) % 65521;
+	}
+	uint32_t adler = (b << 16) | a;
+	for (int shift = 24; shift >= 0; shift -= 8)
+		out.push_back(static_cast<unsigned char>(adler >> shift));
+}
+
+static uint32_t crc32(const unsigned char* data, size_t size, uint32_t crc = 0)
+{
+	static uint32_t table[256];
+	static bool filled = [] {
+		for (uint32_t n = 0; n < 256; n++)
+		{
+			uint32_t c = n;
+			for (int k = 0; k < 8; k++)
+				c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+			table[n] = c;
+		}
+		return true;
+	}();
+	(void)filled;
+	crc = ~crc;
+	for (size_t i = 0; i < size; i++)
+		crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+	return ~crc;
+}
+
+static void put32(vector<unsigned char>& out, uint32_t value)
+{
+	for (int shift = 24; shift >= 0; shift -= 8)
+		out.push_back(static_cast<unsigned char>(value >> shift));
+}
+
+static void chunk(vector<unsigned char>& out, const char* type, const vector<unsigned char>& data)
+{
+	put32(out, static_cast<uint32_t>(data.size()));
+	size_t start = out.size();
+	out.insert(out.end(), type, type + 4);
+	out.insert(out.end(), data.begin(), data.end());
+	put32(out, crc32(&out[start], out.size() - start));
+}
+
+static bool write_file(const string& path, const vector<unsigned char>& bytes)
+{
+	FILE* file = fopen(path.c_str(), "wb");
+	bool ok = file && fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+	ok = file && fclose(file) == 0 && ok;
+	if (!ok)
+		cout << "Failed to write " << path << endl;
+	return ok;
+}
+
+static int paeth(int a, int b, int c)
+{
+	int p = a + b - c, pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+	return pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+}
+
+bool write_png(const string& path, int width, int height, const unsigned char* rgba, bool bottomUp)
+{
+	// every row takes the filter with the smallest sum of magnitudes
+	size_t stride = static_cast<size_t>(width) * 3;
+	vector<unsigned char> filtered((stride + 1) * height);
+	vector<unsigned char> row(stride), above(stride, 0), candidate(stride), best(stride);
+	for (int y = 0; y < height; y++)
+	{
+		const unsigned char* source = rgba + static_cast<size_t>(bottomUp ? height - 1 - y : y) * width * 4;
+		for (int x = 0; x < width; x++)
+			memcpy(&row[x * 3], source + x * 4, 3);
+
+		int bestFilter = 0;
+		long bestSum = -1;
+		for (int filter = 0; filter < 5; filter++)
+		{
+			long sum = 0;
+			for (size_t i = 0; i < stride; i++)
+			{
+				int left = i >= 3 ? row[i - 3] : 0, up = above[i], corner = i >= 3 ? above[i - 3] : 0;
+				int predicted = filter == 1 ? left : filter == 2 ? up : filter == 3 ? (left + up) / 2 : filter == 4 ? paeth(left, up, corner) : 0;
+				candidate[i] = static_cast<unsigned char>(row[i] - predicted);
+				sum += static_cast<signed char>(candidate[i]) < 0 ? -static_cast<signed char>(candidate[i]) : candidate[i];
+			}
+			if (bestSum < 0 || sum < bestSum)
+			{
+				bestSum = sum;
+				bestFilter = filter;
+				best.swap(candidate);
+			}
+		}
+		filtered[y * (stride + 1)] = static_cast<unsigned char>(bestFilter);
+		memcpy(&filtered[y * (stride + 1) + 1], best.data(), stride);
+		above.swap(row);
+	}
+
+	vector<unsigned char> file = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	vector<unsigned char> header;
+	put32(header, width);
+	put32(header, height);
+	header.insert(header.end(), { 8, 2, 0, 0, 0 }); // 8 bit RGB, deflate, adaptive filters, no interlace
+	chunk(file, "IHDR", header);
+	vector<unsigned char> compressed;
+	zlib_compress(filtered, compressed);
+	chunk(file, "IDAT", compressed);
+	chunk(file, "IEND", {});
+	return write_file(path, file);
+}
+
+static void attribute(vector<unsigned char>& out, const char* name, const char* type, const void* value, uint32_t size)
+{
+	out.insert(out.end(), name, name + strlen(name) + 1);
+	out.insert(out.end(), type, type + strlen(type) + 1);
+	const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&size);
+	out.insert(out.end(), bytes, bytes + 4);
+	bytes = static_cast<const unsigned char*>(value);
+	out.insert(out.end(), bytes, bytes + size);
+}
+
+// OpenEXR is little endian throughout, as is every platform the renderer runs on
+bool write_exr(const string& path, int width, int height, const float* rgba, bool bottomUp)
+{
+	vector<unsigned char> file = { 0x76, 0x2f, 0x31, 0x01, 2, 0, 0, 0 }; // magic, version 2, single part scanlines
+
+	// channels sorted by name, each a half with sampling 1
+	vector<unsigned char> channels;
+	for (const char* name : { "B", "G", "R" })
+	{
+		const int32_t description[4] = { 1, 0, 1, 1 }; // HALF, pLinear and reserved, x and y sampling
+		channels.push_back(name[0]);
+		channels.push_back(0);
+		const unsigned char* bytes = reinterpret_cast<const unsigned char*>(description);
+		channels.insert(channels.end(), bytes, bytes + sizeof(description));
+	}
+	channels.push_back(0);
+	attribute(file, "channels", "chlist", channels.data(), static_cast<uint32_t>(channels.size()));
+	const unsigned char none = 0, increasingY = 0;
+	attribute(file, "compression", "compression", &none, 1);
+	const int32_t window[4] = { 0, 0, width - 1, height - 1 };
+	attribute(file, "dataWindow", "box2i", window, sizeof(window));
+	attribute(file, "displayWindow", "box2i", window, sizeof(window));
+	attribute(file, "lineOrder", "lineOrder", &increasingY, 1);
+	const float aspect = 1, center[2] = { 0, 0 };
+	attribute(file, "pixelAspectRatio", "float", &aspect, sizeof(aspect));
+	attribute(file, "screenWindowCenter", "v2f", center, sizeof(center));
+	attribute(file, "screenWindowWidth", "float", &aspect, sizeof(aspect));
+	file.push_back(0);
+
+	// one scanline per block: y, byte count, then each channel's row
+	uint32_t lineBytes = static_cast<uint32_t>(width) * 3 * 2;
+	uint64_t offset = file.size() + static_cast<uint64_t>(height) * 8;
+	for (int y = 0; y < height; y++, offset += 8 + lineBytes)
+	{
+		const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&offset);
+		file.insert(file.end(), bytes, bytes + 8);
+	}
+	vector<uint16_t> line(static_cast<size_t>(width) * 3);
+	for (int y = 0; y < height; y++)
+	{
+		const float* source = rgba + static_cast<size_t>(bottomUp ? height - 1 - y : y) * width * 4;
+		for (int x = 0; x < width; x++)
+			for (int c = 0; c < 3; c++)
+				line[(2 - c) * width + x] = glm::packHalf1x16(source[x * 4 + c]); // B, G, R
+		const int32_t block[2] = { y, static_cast<int32_t>(lineBytes) };
+		const unsigned char* bytes = reinterpret_cast<const unsigned char*>(block);
+		file.insert(file.end(), bytes, bytes + sizeof(block));
+		bytes = reinterpret_cast<const unsigned char*>(line.data());
+		file.insert(file.end(), bytes, bytes + lineBytes);
+	}
+	return write_file(path, file);
+}
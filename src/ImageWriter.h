@@ -0,0 +1,13 @@
+#pragma once
+
+#include <string>
+
+using namespace std;
+
+// Image files for rendered frames, safe to call from any thread. Pixels are RGBA as read
+// back from the framebuffer, bottomUp for rows in GL order; alpha is not written.
+
+// 8 bit RGB, deflated with fixed Huffman codes, a fast setting rather than the smallest file
+bool write_png(const string& path, int width, int height, const unsigned char* rgba, bool bottomUp);
+// half float RGB, uncompressed scanlines, values above 1 are kept
+bool write_exr(const string& path, int width, int height, const float* rgba, bool bottomUp);
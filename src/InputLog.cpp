@@ -0,0 +1,101 @@
+#include "InputLog.h"
+#include <iostream>
+
+using namespace std;
+
+Input_Log::~Input_Log()
+{
+	close();
+}
+
+bool Input_Log::open_write(const char* path)
+{
+	close();
+	file = fopen(path, "wb");
+	if (!file)
+	{
+		cout << "Failed to create the input log " << path << endl;
+		return false;
+	}
+	rinpHeader header = { RINP_MAGIC, RINP_VERSION };
+	fwrite(&header, sizeof(header), 1, file);
+	reading = false;
+	return true;
+}
+
+bool Input_Log::open_read(const char* path)
+{
+	close();
+	file = fopen(path, "rb");
+	if (!file)
+	{
+		cout << "Failed to open the input log " << path << endl;
+		return false;
+	}
+	rinpHeader header;
+	if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != RINP_MAGIC || header.version != RINP_VERSION)
+	{
+		cout << "Not an input log, or of another version: " << path << endl;
+		close();
+		return false;
+	}
+	reading = true;
+	return true;
+}
+
+void Input_Log::close()
+{
+	if (!file)
+		return;
+	if (!reading && (ferror(file) || failed))
+		cout << "Failed to write the input log, it ends early" << endl;
+	fclose(file);
+	file = nullptr;
+	failed = false;
+	stepCount = 0;
+}
+
+void Input_Log::write_step(double time, float deltaTime, const vector<inputEvent>& events)
+{
+	if (!writing() || failed)
+		return;
+	if (stepCount == 0)
+		start = time;
+
+	packed.resize(events.size());
+	for (size_t i = 0; i < events.size(); i++)
+	{
+		const inputEvent& event = events[i];
+		packed[i] = { static_cast<uint8_t>(event.type), static_cast<uint8_t>(event.action), static_cast<int16_t>(event.key),
+			static_cast<float>(event.time - start), event.x, event.y };
+	}
+	rinpStep step = { time, deltaTime, static_cast<uint32_t>(events.size()) };
+	failed = fwrite(&step, sizeof(step), 1, file) != 1 || fwrite(packed.data(), sizeof(rinpEvent), packed.size(), file) != packed.size();
+	stepCount++;
+}
+
+bool Input_Log::read_step(double& time, float& deltaTime, vector<inputEvent>& events)
+{
+	if (!file || !reading)
+		return false;
+	rinpStep step;
+	if (fread(&step, sizeof(step), 1, file) != 1 || step.events > Max_Step_Events)
+		return false;
+	packed.resize(step.events);
+	if (fread(packed.data(), sizeof(rinpEvent), packed.size(), file) != packed.size())
+		return false;
+	if (stepCount == 0)
+		start = step.time;
+
+	events.resize(packed.size());
+	for (size_t i = 0; i < packed.size(); i++)
+	{
+		const rinpEvent& event = packed[i];
+		events[i] = { event.type == inputEvent::CURSOR ? inputEvent::CURSOR : inputEvent::KEY, event.key, event.action,
+			event.x, event.y, start + event.time };
+	}
+	time = step.time;
+	deltaTime = step.deltaTime;
+	stepCount++;
+	return true;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+using namespace std;
+
+// one key or cursor callback, as the simulation thread takes it in
+struct inputEvent
+{
+	enum { KEY, CURSOR } type;
+	int key;
+	int action;
+	double x, y;
+	double time; // Frame_Pacer::now() in the callback
+};
+
+// .rinp, the input of a session step by step, written and read by Input_Log:
+// rinpHeader, then per simulation step an rinpStep followed by its rinpEvent[events].
+// Cursor positions are kept as the doubles GLFW reported, the step's time and
+// deltaTime as the update functions were given them, so replaying the steps in order
+// reproduces the camera path bit for bit. A log that was cut off ends at its last
+// complete step.
+
+#define RINP_MAGIC 0x504e4952 // "RINP"
+#define RINP_VERSION 1
+
+struct rinpHeader
+{
+	uint32_t magic;
+	uint32_t version;
+};
+
+struct rinpStep
+{
+	double time; // glfwGetTime() the step ran at
+	float deltaTime;
+	uint32_t events;
+};
+
+struct rinpEvent
+{
+	uint8_t type;
+	uint8_t action;
+	int16_t key;
+	float time; // seconds since the first step, for inspecting a log only
+	double x, y;
+};
+
+// Records or replays an .rinp log, used by the simulation thread only.
+class Input_Log
+{
+public:
+	Input_Log() = default;
+	~Input_Log();
+
+	Input_Log(const Input_Log&) = delete;
+	Input_Log& operator=(const Input_Log&) = delete;
+
+	bool open_write(const char* path);
+	bool open_read(const char* path);
+	void close();
+
+	bool writing() const { return file && !reading; }
+	bool is_open() const { return file != nullptr; }
+
+	void write_step(double time, float deltaTime, const vector<inputEvent>& events);
+	// false at the end of the log, or at a step that was cut off
+	bool read_step(double& time, float& deltaTime, vector<inputEvent>& events);
+
+	uint64_t steps() const { return stepCount; }
+
+	// more in one step is taken as a damaged log
+	static const uint32_t Max_Step_Events = 1 << 16;
+
+private:
+	FILE* file = nullptr;
+	bool reading = false;
+	bool failed = false;
+	double start = 0;
+	uint64_t stepCount = 0;
+	vector<rinpEvent> packed;
+};
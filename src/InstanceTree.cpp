@@ -0,0 +1,92 @@
+#include "InstanceTree.h"
+#include <cfloat>
+
+using namespace std;
+
+void Instance_Tree::build(const vector<raytMeshInstance>& scene_instances, const vector<Mesh>& meshes)
+{
+	prims.resize(scene_instances.size());
+	rotation_cache.resize(scene_instances.size());
+	for (size_t i = 0; i < scene_instances.size(); i++)
+	{
+		const raytMeshInstance& instance = scene_instances[i];
+		const Mesh& mesh = meshes[instance.geometry];
+		glm::vec3 lo = mesh.bounds_min(), hi = mesh.bounds_max();
+
+		// world space bounds of the rotated mesh bounds
+		const glm::mat3& rows = rotation_cache[i].update(instance.quat_rotation);
+		prims[i].bmin = glm::vec3(FLT_MAX);
+		prims[i].bmax = glm::vec3(-FLT_MAX);
+		for (int c = 0; c < 8; c++)
+		{
+			glm::vec3 corner(c & 1 ? hi.x : lo.x, c & 2 ? hi.y : lo.y, c & 4 ? hi.z : lo.z);
+			glm::vec3 p = rows * corner + instance.pos;
+			prims[i].bmin = glm::min(prims[i].bmin, p);
+			prims[i].bmax = glm::max(prims[i].bmax, p);
+		}
+		prims[i].centroid = (prims[i].bmin + prims[i].bmax) * 0.5f;
+	}
+
+	// rebuilt whenever an instance moves, every vector keeps its capacity
+	Bvh::build(prims, nodes, order, false);
+
+	instances.resize(order.size());
+	packed.resize(order.size() * Instance_Stride);
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		const raytMeshInstance& instance = scene_instances[order[i]];
+		instances[i] = instance;
+		glm::vec4* g = &packed[i * Instance_Stride];
+		pack_transform(rotation_cache[order[i]].rows, instance.pos, g);
+		g[3] = glm::vec4(glm::intBitsToFloat(instance.material), glm::intBitsToFloat(instance.node_offset),
+			glm::intBitsToFloat(instance.tri_offset), glm::intBitsToFloat(instance.vertex_offset));
+	}
+}
+
+bool Instance_Tree::intersect(const vector<Mesh>& meshes, glm::vec3 ro, glm::vec3 rd, float tmax, float& t, glm::vec3& normal, int& instance) const
+{
+	if (nodes.empty())
+		return false;
+
+	glm::vec3 inv_rd = 1.0f / rd;
+	int stack[Bvh::Max_Depth + 1];
+	int sp = 0;
+	instance = -1;
+	stack[sp++] = 0;
+
+	while (sp > 0)
+	{
+		const raytBvhNode& node = nodes[stack[--sp]];
+		if (!Bvh::intersect_aabb(ro, inv_rd, node.bmin, node.bmax, tmax))
+			continue;
+
+		if (node.count > 0)
+		{
+			for (int i = node.left_first; i < node.left_first + node.count; i++)
+			{
+				const glm::vec4* g = &packed[i * Instance_Stride];
+				float ti;
+				glm::vec3 n;
+				if (meshes[instances[i].geometry].intersect(to_object(g, ro), to_object_dir(g, rd), tmax, ti, n))
+				{
+					tmax = ti;
+					instance = i;
+					normal = to_world_dir(g, n);
+				}
+			}
+		}
+		else
+		{
+			stack[sp++] = node.left_first + 1;
+			stack[sp++] = node.left_first;
+		}
+	}
+
+	t = tmax;
+	return instance != -1;
+}
+
+size_t Instance_Tree::memory_bytes() const
+{
+	return packed.size() * sizeof(glm::vec4) + nodes.size() * sizeof(raytBvhNode);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "scene.h"
+#include "Mesh.h"
+#include "Transform.h"
+
+using namespace std;
+
+// top level bvh over mesh instances, the meshes' own bvhs are the bottom level
+class Instance_Tree
+{
+public:
+	vector<raytBvhNode> nodes;
+	vector<raytMeshInstance> instances; // in leaf order
+	// what gets uploaded, per leaf ordered instance: world to mesh rows with the
+	// translation in w, then material, node, triangle and vertex offsets as int bits
+	vector<glm::vec4> packed;
+
+	static const int Instance_Stride = 4;
+
+	void build(const vector<raytMeshInstance>& scene_instances, const vector<Mesh>& meshes);
+	// ray in world space, instance is the index into the leaf ordered instances
+	bool intersect(const vector<Mesh>& meshes, glm::vec3 ro, glm::vec3 rd, float tmax, float& t, glm::vec3& normal, int& instance) const;
+
+	size_t memory_bytes() const;
+
+private:
+	vector<Compiled_Rotation> rotation_cache; // in scene order
+	vector<Bvh_Primitive> prims;
+	vector<int> order;
+};
@@ -0,0 +1,93 @@
+#include "MappedFile.h"
+#include <cstdio>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+Mapped_File::~Mapped_File()
+{
+	close();
+}
+
+#ifndef _WIN32
+
+bool Mapped_File::open(const char* path, bool populate)
+{
+	close();
+
+	int fd = ::open(path, O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size == 0)
+	{
+		::close(fd);
+		return false;
+	}
+
+	int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+	// fault the pages in now, on the opening thread, rather than on first access
+	if (populate)
+		flags |= MAP_POPULATE;
+#endif
+	void* view = mmap(nullptr, info.st_size, PROT_READ, flags, fd, 0);
+	// the mapping keeps the file alive
+	::close(fd);
+	if (view == MAP_FAILED)
+		return false;
+
+	bytes = static_cast<const unsigned char*>(view);
+	length = static_cast<size_t>(info.st_size);
+	return true;
+}
+
+void Mapped_File::close()
+{
+	if (bytes)
+		munmap(const_cast<unsigned char*>(bytes), length);
+	bytes = nullptr;
+	length = 0;
+}
+
+#else
+
+bool Mapped_File::open(const char* path, bool populate)
+{
+	close();
+
+	FILE* file = fopen(path, "rb");
+	if (!file)
+		return false;
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	buffer.resize(size > 0 ? size : 0);
+	bool ok = size > 0 && fread(buffer.data(), 1, buffer.size(), file) == buffer.size();
+	fclose(file);
+	if (!ok)
+	{
+		buffer.clear();
+		return false;
+	}
+
+	bytes = buffer.data();
+	length = buffer.size();
+	return true;
+}
+
+void Mapped_File::close()
+{
+	buffer.clear();
+	bytes = nullptr;
+	length = 0;
+}
+
+#endif
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+using namespace std;
+
+// read-only view of a whole file, memory-mapped where the platform allows it
+class Mapped_File
+{
+public:
+	Mapped_File() = default;
+	~Mapped_File();
+
+	Mapped_File(const Mapped_File&) = delete;
+	Mapped_File& operator=(const Mapped_File&) = delete;
+
+	// populate reads the whole file in up front, leave it off for files that are consumed
+	// piecewise over time
+	bool open(const char* path, bool populate = true);
+	void close();
+
+	const unsigned char* data() const { return bytes; }
+	size_t size() const { return length; }
+
+private:
+	const unsigned char* bytes = nullptr;
+	size_t length = 0;
+#ifdef _WIN32
+	vector<unsigned char> buffer; // no mmap, the file is read in
+#endif
+};
@@ -0,0 +1,273 @@
+#include "Mesh.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <iostream>
+#include <algorithm>
+
+using namespace std;
+
+static double elapsed_ms(chrono::steady_clock::time_point since)
+{
+	return chrono::duration<double, milli>(chrono::steady_clock::now() - since).count();
+}
+
+static int resolve_index(long index, size_t count)
+{
+	// obj indices are 1-based, negative ones are relative to the end
+	long i = index < 0 ? static_cast<long>(count) + index : index - 1;
+	return i >= 0 && i < static_cast<long>(count) ? static_cast<int>(i) : -1;
+}
+
+// the line at text of the size bytes left, however long, in line with its end cut off and
+// a terminating zero; returns the bytes it took up
+static size_t read_line(const char* text, size_t size, vector<char>& line)
+{
+	const char* end = static_cast<const char*>(memchr(text, '\n', size));
+	size_t length = end ? end - text : size;
+	line.resize(max(line.size(), length + 1));
+	memcpy(line.data(), text, length);
+	line[length] = 0;
+	return end ? length + 1 : length;
+}
+
+bool Mesh::load_obj(const char* path, Mesh& mesh)
+{
+	FILE* file = fopen(path, "rb");
+	if (!file)
+	{
+		cout << "Mesh failed to load at path: " << path << endl;
+		return false;
+	}
+	vector<char> text;
+	char buffer[65536];
+	size_t got;
+	while ((got = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		text.insert(text.end(), buffer, buffer + got);
+	fclose(file);
+	return load_obj_from_memory(path, text.data(), text.size(), mesh);
+}
+
+bool Mesh::load_obj_from_memory(const char* name, const char* text, size_t size, Mesh& mesh)
+{
+	auto start = chrono::steady_clock::now();
+
+	mesh.vertices.clear();
+	mesh.triangles.clear();
+
+	// line by line, only positions and faces are kept
+	vector<char> line(4096);
+	vector<int> face;
+	size_t lineNum = 0, offset = 0;
+	while (offset < size)
+	{
+		offset += read_line(text + offset, size - offset, line);
+		lineNum++;
+		char* p = line.data();
+		while (*p == ' ' || *p == '\t')
+			p++;
+
+		if (p[0] == 'v' && (p[1] == ' ' || p[1] == '\t'))
+		{
+			glm::vec4 v(0, 0, 0, 1);
+			p += 2;
+			v.x = strtof(p, &p);
+			v.y = strtof(p, &p);
+			v.z = strtof(p, &p);
+			mesh.vertices.push_back(v);
+		}
+		else if (p[0] == 'f' && (p[1] == ' ' || p[1] == '\t'))
+		{
+			face.clear();
+			p += 2;
+			for (;;)
+			{
+				char* end;
+				long index = strtol(p, &end, 10);
+				if (end == p)
+					break;
+				face.push_back(resolve_index(index, mesh.vertices.size()));
+				if (face.back() < 0)
+				{
+					cout << "Invalid face index in " << name << ":" << lineNum << endl;
+					return false;
+				}
+				// skip the texture coordinate and normal references
+				p = end;
+				while (*p && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n')
+					p++;
+			}
+
+			// triangle fan for polygons
+			for (size_t i = 2; i < face.size(); i++)
+				mesh.triangles.push_back({ face[0], face[i - 1], face[i], 0 });
+		}
+	}
+
+	double loadTime = elapsed_ms(start);
+	start = chrono::steady_clock::now();
+	mesh.build_bvh();
+	double buildTime = elapsed_ms(start);
+
+	printf("Mesh '%s': %zu triangles, %zu vertices, %zu bvh nodes, %.1f bytes/triangle, load %.1f ms, bvh build %.1f ms\n",
+		name, mesh.triangles.size(), mesh.vertices.size(), mesh.nodes.size(),
+		mesh.triangles.empty() ? 0.0 : static_cast<double>(mesh.memory_bytes()) / mesh.triangles.size(),
+		loadTime, buildTime);
+
+	return !mesh.triangles.empty();
+}
+
+size_t Mesh::memory_bytes() const
+{
+	return vertices.size() * sizeof(glm::vec4) + triangles.size() * sizeof(raytTriangle) + nodes.size() * sizeof(raytBvhNode);
+}
+
+bool Mesh::valid() const
+{
+	int vertexCount = static_cast<int>(vertices.size());
+	for (const raytTriangle& tri : triangles)
+		if (tri.v0 < 0 || tri.v0 >= vertexCount || tri.v1 < 0 || tri.v1 >= vertexCount || tri.v2 < 0 || tri.v2 >= vertexCount)
+			return false;
+
+	if (nodes.empty())
+		return triangles.empty();
+	// children always have larger indices, so one pass in order sees every parent first
+	vector<int> depth(nodes.size(), -1);
+	depth[0] = 0;
+	for (size_t i = 0; i < nodes.size(); i++)
+	{
+		const raytBvhNode& node = nodes[i];
+		if (depth[i] < 0)
+			continue;
+		if (node.count > 0)
+		{
+			if (node.left_first < 0 || static_cast<size_t>(node.left_first) + node.count > triangles.size())
+				return false;
+			continue;
+		}
+		if (node.count < 0 || node.left_first <= static_cast<int>(i) || static_cast<size_t>(node.left_first) + 1 >= nodes.size() ||
+			depth[i] >= Bvh::Max_Depth)
+			return false;
+		for (int child = node.left_first; child <= node.left_first + 1; child++)
+			depth[child] = max(depth[child], depth[i] + 1);
+	}
+	return true;
+}
+
+void Mesh::build_bvh()
+{
+	vector<Bvh_Primitive> prims(triangles.size());
+	for (size_t i = 0; i < triangles.size(); i++)
+	{
+		const raytTriangle& tri = triangles[i];
+		glm::vec3 v0 = glm::vec3(vertices[tri.v0]), v1 = glm::vec3(vertices[tri.v1]), v2 = glm::vec3(vertices[tri.v2]);
+		prims[i].bmin = glm::min(v0, glm::min(v1, v2));
+		prims[i].bmax = glm::max(v0, glm::max(v1, v2));
+		prims[i].centroid = (prims[i].bmin + prims[i].bmax) * 0.5f;
+	}
+
+	vector<int> order;
+	Bvh::build(prims, nodes, order);
+
+	// store triangles in leaf order
+	vector<raytTriangle> sorted(triangles.size());
+	for (size_t i = 0; i < order.size(); i++)
+		sorted[i] = triangles[order[i]];
+	triangles.swap(sorted);
+}
+
+// watertight ray-triangle intersection (Woop, Benthin, Wald 2013)
+bool Mesh::intersect_triangle(const raytTriangle& tri, glm::vec3 ro, glm::vec3 rd, float tmax, float& t) const
+{
+	glm::vec3 ad = glm::abs(rd);
+	int kz = ad.x > ad.y ? (ad.x > ad.z ? 0 : 2) : (ad.y > ad.z ? 1 : 2);
+	int kx = (kz + 1) % 3;
+	int ky = (kx + 1) % 3;
+	if (rd[kz] < 0)
+		swap(kx, ky);
+
+	float sx = rd[kx] / rd[kz];
+	float sy = rd[ky] / rd[kz];
+	float sz = 1.0f / rd[kz];
+
+	glm::vec3 a = glm::vec3(vertices[tri.v0]) - ro;
+	glm::vec3 b = glm::vec3(vertices[tri.v1]) - ro;
+	glm::vec3 c = glm::vec3(vertices[tri.v2]) - ro;
+
+	float ax = a[kx] - sx * a[kz], ay = a[ky] - sy * a[kz];
+	float bx = b[kx] - sx * b[kz], by = b[ky] - sy * b[kz];
+	float cx = c[kx] - sx * c[kz], cy = c[ky] - sy * c[kz];
+
+	float u = cx * by - cy * bx;
+	float v = ax * cy - ay * cx;
+	float w = bx * ay - by * ax;
+
+	// edge hit, recompute in double precision
+	if (u == 0 || v == 0 || w == 0)
+	{
+		u = static_cast<float>(static_cast<double>(cx) * by - static_cast<double>(cy) * bx);
+		v = static_cast<float>(static_cast<double>(ax) * cy - static_cast<double>(ay) * cx);
+		w = static_cast<float>(static_cast<double>(bx) * ay - static_cast<double>(by) * ax);
+	}
+
+	if ((u < 0 || v < 0 || w < 0) && (u > 0 || v > 0 || w > 0))
+		return false;
+
+	float det = u + v + w;
+	if (det == 0)
+		return false;
+
+	float T = u * sz * a[kz] + v * sz * b[kz] + w * sz * c[kz];
+	if (det < 0 ? (T >= 0 || T < tmax * det) : (T <= 0 || T > tmax * det))
+		return false;
+
+	t = T / det;
+	return true;
+}
+
+bool Mesh::intersect(glm::vec3 ro, glm::vec3 rd, float tmax, float& t, glm::vec3& normal) const
+{
+	if (nodes.empty())
+		return false;
+
+	glm::vec3 inv_rd = 1.0f / rd;
+	int stack[Bvh::Max_Depth + 1];
+	int sp = 0;
+	int hit = -1;
+	stack[sp++] = 0;
+
+	while (sp > 0)
+	{
+		const raytBvhNode& node = nodes[stack[--sp]];
+		if (!Bvh::intersect_aabb(ro, inv_rd, node.bmin, node.bmax, tmax))
+			continue;
+
+		if (node.count > 0)
+		{
+			for (int i = node.left_first; i < node.left_first + node.count; i++)
+			{
+				float ti;
+				if (intersect_triangle(triangles[i], ro, rd, tmax, ti))
+				{
+					tmax = ti;
+					hit = i;
+				}
+			}
+		}
+		else
+		{
+			stack[sp++] = node.left_first + 1;
+			stack[sp++] = node.left_first;
+		}
+	}
+
+	if (hit == -1)
+		return false;
+
+	const raytTriangle& tri = triangles[hit];
+	glm::vec3 v0 = glm::vec3(vertices[tri.v0]);
+	normal = glm::normalize(glm::cross(glm::vec3(vertices[tri.v1]) - v0, glm::vec3(vertices[tri.v2]) - v0));
+	t = tmax;
+	return true;
+}
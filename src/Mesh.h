@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "Bvh.h"
+
+using namespace std;
+
+// 16 bytes, uploaded as one RGBA32I texel
+struct raytTriangle
+{
+	int v0, v1, v2;
+	int _p1;
+};
+
+class Mesh
+{
+public:
+	vector<glm::vec4> vertices; // xyz + unused, one RGBA32F texel each
+	vector<raytTriangle> triangles;
+	vector<raytBvhNode> nodes;
+
+	static bool load_obj(const char* path, Mesh& mesh);
+	// the same from the size bytes of an obj file at text, name is for the messages
+	static bool load_obj_from_memory(const char* name, const char* text, size_t size, Mesh& mesh);
+
+	void build_bvh();
+	// ray in mesh space, returns the closest hit closer than tmax
+	bool intersect(glm::vec3 ro, glm::vec3 rd, float tmax, float& t, glm::vec3& normal) const;
+
+	size_t memory_bytes() const;
+	// the triangles' vertices and the nodes' children and triangles are in range, children
+	// come after their parent and leaves are no deeper than the traversal stacks hold,
+	// for geometry that was loaded rather than built
+	bool valid() const;
+	glm::vec3 bounds_min() const { return nodes.empty() ? glm::vec3(0) : nodes[0].bmin; }
+	glm::vec3 bounds_max() const { return nodes.empty() ? glm::vec3(0) : nodes[0].bmax; }
+
+private:
+	bool intersect_triangle(const raytTriangle& tri, glm::vec3 ro, glm::vec3 rd, float tmax, float& t) const;
+};
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+using namespace std;
+
+// Fixed size ring of values between any number of producer and consumer threads,
+// without locks. Every cell carries a sequence number that tells a producer whether it
+// is free and a consumer whether it is filled, so the two ends only contend on their
+// own index. Capacity is a power of two, push() fails instead of waiting when it is full.
+template<typename T, size_t Capacity>
+class Mpmc_Queue
+{
+	static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+	Mpmc_Queue()
+	{
+		for (size_t i = 0; i < Capacity; i++)
+			cells[i].sequence.store(i, memory_order_relaxed);
+	}
+
+	bool push(const T& value)
+	{
+		size_t position = tail.load(memory_order_relaxed);
+		Cell* cell;
+		for (;;)
+		{
+			cell = &cells[position & (Capacity - 1)];
+			intptr_t difference = static_cast<intptr_t>(cell->sequence.load(memory_order_acquire)) - static_cast<intptr_t>(position);
+			if (difference == 0 && tail.compare_exchange_weak(position, position + 1, memory_order_relaxed))
+				break;
+			if (difference < 0)
+				return false;
+			if (difference > 0)
+				position = tail.load(memory_order_relaxed);
+		}
+		cell->value = value;
+		cell->sequence.store(position + 1, memory_order_release);
+		return true;
+	}
+
+	bool pop(T& value)
+	{
+		size_t position = head.load(memory_order_relaxed);
+		Cell* cell;
+		for (;;)
+		{
+			cell = &cells[position & (Capacity - 1)];
+			intptr_t difference = static_cast<intptr_t>(cell->sequence.load(memory_order_acquire)) - static_cast<intptr_t>(position + 1);
+			if (difference == 0 && head.compare_exchange_weak(position, position + 1, memory_order_relaxed))
+				break;
+			if (difference < 0)
+				return false;
+			if (difference > 0)
+				position = head.load(memory_order_relaxed);
+		}
+		value = cell->value;
+		cell->sequence.store(position + Capacity, memory_order_release);
+		return true;
+	}
+
+private:
+	struct Cell
+	{
+		atomic<size_t> sequence;
+		T value;
+	};
+
+	Cell cells[Capacity];
+	alignas(64) atomic<size_t> head{ 0 };
+	alignas(64) atomic<size_t> tail{ 0 };
+};
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "MpmcQueue.h"
+
+using namespace std;
+
+// Recycles objects of one type between any threads, so that what is created and
+// destroyed at a steady rate stops going to the heap once the pool has warmed up. The
+// free list holds up to Capacity objects, acquire() only allocates when it is empty and
+// release() only deletes when it is full. Released objects keep their state, the caller
+// resets what it needs to.
+template<typename T, size_t Capacity>
+class Object_Pool
+{
+public:
+	Object_Pool() = default;
+	~Object_Pool()
+	{
+		T* object;
+		while (free.pop(object))
+			delete object;
+	}
+
+	Object_Pool(const Object_Pool&) = delete;
+	Object_Pool& operator=(const Object_Pool&) = delete;
+
+	T* acquire()
+	{
+		T* object;
+		return free.pop(object) ? object : new T();
+	}
+
+	void release(T* object)
+	{
+		if (!free.push(object))
+			delete object;
+	}
+
+private:
+	Mpmc_Queue<T*, Capacity> free;
+};
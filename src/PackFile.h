@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+// .rpak, many asset files in one, written by tools/pack:
+// rpakHeader, rpakEntry[entries] sorted by name, then the file contents, each 16 byte
+// aligned. Names are relative asset paths with forward slashes, "shaders/fshader.fs".
+// The pack is mapped once and files are served as spans into the mapping.
+
+#define RPAK_MAGIC 0x4b415052 // "RPAK"
+#define RPAK_VERSION 1
+
+struct rpakHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t entries;
+	uint32_t _p1;
+};
+
+struct rpakEntry
+{
+	uint64_t offset;
+	uint64_t size;
+	char name[112]; // zero terminated
+};
+
+// header and index fit and every entry lies within the file
+static inline const rpakEntry* rpak_entries(const unsigned char* data, size_t size)
+{
+	const rpakHeader* header = reinterpret_cast<const rpakHeader*>(data);
+	if (size < sizeof(rpakHeader) || header->magic != RPAK_MAGIC || header->version != RPAK_VERSION ||
+		(size - sizeof(rpakHeader)) / sizeof(rpakEntry) < header->entries)
+		return nullptr;
+
+	const rpakEntry* entries = reinterpret_cast<const rpakEntry*>(data + sizeof(rpakHeader));
+	for (uint32_t i = 0; i < header->entries; i++)
+		if (entries[i].offset > size || entries[i].size > size - entries[i].offset ||
+			memchr(entries[i].name, 0, sizeof(entries[i].name)) == nullptr)
+			return nullptr;
+	return entries;
+}
@@ -0,0 +1,151 @@
+#include "SceneBuilder.h"
+
+using namespace std;
+
+Scene_Builder::Scene_Builder(sceneContainer& scene)
+	: scene(scene)
+{
+	scene.sync_slots();
+}
+
+void Scene_Builder::reserve(size_t spheres, size_t boxes, size_t surfaces, size_t meshInstances, size_t materials)
+{
+	scene.spheres.reserve(scene.spheres.size() + spheres);
+	scene.boxes.reserve(scene.boxes.size() + boxes);
+	scene.surfaces.reserve(scene.surfaces.size() + surfaces);
+	scene.mesh_instances.reserve(scene.mesh_instances.size() + meshInstances);
+	scene.materials.reserve(scene.materials.size() + materials);
+}
+
+materialHandle Scene_Builder::material(glm::vec3 color, int specular, float reflect, float refract, glm::vec3 absorb, float diffuse,
+	float kd, float ks)
+{
+	raytMaterial material = {};
+	material.color = color;
+	material.absorb = absorb;
+	material.specular = specular;
+	material.reflect = reflect;
+	material.refract = refract;
+	material.diffuse = diffuse;
+	material.kd = kd;
+	material.ks = ks;
+	return this->material(material);
+}
+
+materialHandle Scene_Builder::material(const raytMaterial& material)
+{
+	size_t count = scene.materials.size();
+	int index = scene.add_material(material);
+	if (scene.materials.size() != count)
+		scene.dirty |= DIRTY_MATERIALS;
+	return materialHandle(index);
+}
+
+sphereHandle Scene_Builder::sphere(glm::vec3 center, float radius, materialHandle material, bool hollow)
+{
+	raytSphere& sphere = emplace(scene.spheres, DIRTY_SPHERES, &scene.sphere_slots);
+	sphere.obj = glm::vec4(center, radius);
+	sphere.hollow = hollow;
+	sphere.material = material.index;
+	return added<raytSphere>(scene.sphere_slots);
+}
+
+boxHandle Scene_Builder::box(glm::vec3 pos, glm::vec3 form, materialHandle material)
+{
+	raytBox& box = emplace(scene.boxes, DIRTY_BOXES, &scene.box_slots);
+	box.pos = pos;
+	box.form = form;
+	box.material = material.index;
+	return added<raytBox>(scene.box_slots);
+}
+
+surfaceHandle Scene_Builder::surface(const raytSurface& surface)
+{
+	emplace(scene.surfaces, DIRTY_SURFACES, &scene.surface_slots) = surface;
+	return added<raytSurface>(scene.surface_slots);
+}
+
+meshHandle Scene_Builder::mesh(Mesh&& mesh)
+{
+	// the geometry goes up once with the mesh buffers, there is no dirty flag for it
+	scene.mesh_data.push_back(move(mesh));
+	return meshHandle(static_cast<int>(scene.mesh_data.size()) - 1);
+}
+
+meshInstanceHandle Scene_Builder::mesh_instance(meshHandle mesh, glm::vec3 pos, materialHandle material, glm::quat rotation)
+{
+	raytMeshInstance& instance = emplace(scene.mesh_instances, DIRTY_MESH_INSTANCES, &scene.mesh_instance_slots);
+	instance.geometry = mesh.index;
+	instance.pos = pos;
+	instance.material = material.index;
+	instance.quat_rotation = rotation;
+	return added<raytMeshInstance>(scene.mesh_instance_slots);
+}
+
+void Scene_Builder::light_point(glm::vec4 position, glm::vec3 color, float intensity, float linear_k, float quadratic_k)
+{
+	raytLightPoint& light = emplace(scene.lights_point, DIRTY_LIGHTS);
+	light.pos = position;
+	light.color = color;
+	light.intensity = intensity;
+	light.linear_k = linear_k;
+	light.quadratic_k = quadratic_k;
+}
+
+void Scene_Builder::light_direct(glm::vec3 direction, glm::vec3 color, float intensity)
+{
+	raytLightDirect& light = emplace(scene.lights_direct, DIRTY_LIGHTS);
+	light.direction = direction;
+	light.color = color;
+	light.intensity = intensity;
+}
+
+void Scene_Builder::spheres(const raytSphere* first, size_t count, sphereHandle* handles)
+{
+	spheres(count, [first](size_t i, raytSphere& sphere) { sphere = first[i]; }, handles);
+}
+
+void Scene_Builder::boxes(const raytBox* first, size_t count, boxHandle* handles)
+{
+	boxes(count, [first](size_t i, raytBox& box) { box = first[i]; }, handles);
+}
+
+void Scene_Builder::mesh_instances(const raytMeshInstance* first, size_t count, meshInstanceHandle* handles)
+{
+	mesh_instances(count, [first](size_t i, raytMeshInstance& instance) { instance = first[i]; }, handles);
+}
+
+raytSphere& Scene_Builder::edit(sphereHandle sphere)
+{
+	return edit(scene.spheres, scene.sphere_slots, DIRTY_SPHERES, sphere);
+}
+
+raytSurface& Scene_Builder::edit(surfaceHandle surface)
+{
+	return edit(scene.surfaces, scene.surface_slots, DIRTY_SURFACES, surface);
+}
+
+raytBox& Scene_Builder::edit(boxHandle box)
+{
+	return edit(scene.boxes, scene.box_slots, DIRTY_BOXES, box);
+}
+
+raytMeshInstance& Scene_Builder::edit(meshInstanceHandle instance)
+{
+	return edit(scene.mesh_instances, scene.mesh_instance_slots, DIRTY_MESH_INSTANCES, instance);
+}
+
+bool Scene_Builder::remove(sphereHandle sphere)
+{
+	return remove(scene.spheres, scene.sphere_slots, DIRTY_SPHERES, sphere);
+}
+
+bool Scene_Builder::remove(boxHandle box)
+{
+	return remove(scene.boxes, scene.box_slots, DIRTY_BOXES, box);
+}
+
+bool Scene_Builder::remove(meshInstanceHandle instance)
+{
+	return remove(scene.mesh_instances, scene.mesh_instance_slots, DIRTY_MESH_INSTANCES, instance);
+}
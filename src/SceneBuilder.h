@@ -0,0 +1,150 @@
+#pragma once
+
+#include <cassert>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include "scene.h"
+
+using namespace std;
+
+// Fills a sceneContainer: every object is constructed in place at the end of its array
+// and handed back as a handle, reserve() up front keeps the arrays from growing while
+// they are filled. For large scenes the bulk forms add a whole run of objects with one
+// resize, either copied from an array or made in place by a function, so that building
+// costs about as much as writing the objects once.
+//
+// Spheres, boxes and mesh instances can also be removed, the last object of the array
+// takes the place of the removed one and the handles follow it, see Slot_Map. Adding,
+// removing and edit() only mark the elements they touch, which is all that is uploaded
+// afterwards; the shader is not rebuilt as long as the arrays stay within the room it was
+// built with, see sceneContainer::sphere_capacity.
+class Scene_Builder
+{
+public:
+	explicit Scene_Builder(sceneContainer& scene);
+
+	// room for this many more of each
+	void reserve(size_t spheres, size_t boxes = 0, size_t surfaces = 0, size_t meshInstances = 0, size_t materials = 0);
+
+	// identical materials share one entry
+	materialHandle material(glm::vec3 color, int specular, float reflect, float refract = 0.0, glm::vec3 absorb = {},
+		float diffuse = 0.7, float kd = 0.8, float ks = 0.2);
+	materialHandle material(const raytMaterial& material);
+
+	sphereHandle sphere(glm::vec3 center, float radius, materialHandle material, bool hollow = false);
+	boxHandle box(glm::vec3 pos, glm::vec3 form, materialHandle material);
+	surfaceHandle surface(const raytSurface& surface);
+	meshHandle mesh(Mesh&& mesh);
+	meshInstanceHandle mesh_instance(meshHandle mesh, glm::vec3 pos, materialHandle material,
+		glm::quat rotation = glm::quat(1, 0, 0, 0));
+	void light_point(glm::vec4 position, glm::vec3 color, float intensity, float linear_k = 0.22f, float quadratic_k = 0.2f);
+	void light_direct(glm::vec3 direction, glm::vec3 color, float intensity);
+
+	// count objects copied from first, handles, if given, receives one per object
+	void spheres(const raytSphere* first, size_t count, sphereHandle* handles = nullptr);
+	void boxes(const raytBox* first, size_t count, boxHandle* handles = nullptr);
+	void mesh_instances(const raytMeshInstance* first, size_t count, meshInstanceHandle* handles = nullptr);
+
+	// count objects made by make(i, object) on default constructed ones, in place
+	template<typename Make>
+	void spheres(size_t count, Make make, sphereHandle* handles = nullptr)
+	{
+		append(scene.spheres, scene.sphere_slots, DIRTY_SPHERES, count, make, handles);
+	}
+	template<typename Make>
+	void boxes(size_t count, Make make, boxHandle* handles = nullptr)
+	{
+		append(scene.boxes, scene.box_slots, DIRTY_BOXES, count, make, handles);
+	}
+	template<typename Make>
+	void mesh_instances(size_t count, Make make, meshInstanceHandle* handles = nullptr)
+	{
+		append(scene.mesh_instances, scene.mesh_instance_slots, DIRTY_MESH_INSTANCES, count, make, handles);
+	}
+
+	// false for handles of removed objects
+	bool contains(sphereHandle sphere) const { return scene.sphere_slots.find(sphere.index, sphere.generation) >= 0; }
+	bool contains(surfaceHandle surface) const { return scene.surface_slots.find(surface.index, surface.generation) >= 0; }
+	bool contains(boxHandle box) const { return scene.box_slots.find(box.index, box.generation) >= 0; }
+	bool contains(meshInstanceHandle instance) const
+	{
+		return scene.mesh_instance_slots.find(instance.index, instance.generation) >= 0;
+	}
+
+	// for changes after adding, the handle must be contained
+	raytSphere& edit(sphereHandle sphere);
+	raytSurface& edit(surfaceHandle surface);
+	raytBox& edit(boxHandle box);
+	raytMeshInstance& edit(meshInstanceHandle instance);
+
+	// false if the object was removed already
+	bool remove(sphereHandle sphere);
+	bool remove(boxHandle box);
+	bool remove(meshInstanceHandle instance);
+
+private:
+	sceneContainer& scene;
+
+	template<typename T, typename Make>
+	void append(vector<T>& objects, Slot_Map& slots, unsigned dirty, size_t count, Make& make, sceneHandle<T>* handles)
+	{
+		slots.sync(objects.size());
+		size_t first = objects.size();
+		objects.resize(first + count);
+		for (size_t i = 0; i < count; i++)
+		{
+			make(i, objects[first + i]);
+			int slot = slots.add();
+			if (handles)
+				handles[i] = sceneHandle<T>(slot, slots.generation_of(slot));
+		}
+		scene.patch(dirty, first, first + count);
+	}
+
+	// objects appended to the array behind the builder's back get their slots first
+	template<typename T>
+	T& emplace(vector<T>& objects, unsigned dirty, Slot_Map* slots = nullptr)
+	{
+		if (slots)
+			slots->sync(objects.size());
+		objects.emplace_back();
+		scene.patch(dirty, objects.size() - 1, objects.size());
+		return objects.back();
+	}
+
+	template<typename T>
+	sceneHandle<T> added(Slot_Map& slots) const
+	{
+		int slot = slots.add();
+		return sceneHandle<T>(slot, slots.generation_of(slot));
+	}
+
+	template<typename T>
+	T& edit(vector<T>& objects, Slot_Map& slots, unsigned dirty, sceneHandle<T> handle)
+	{
+		slots.sync(objects.size());
+		int index = slots.find(handle.index, handle.generation);
+		assert(index >= 0 && "edit() of a removed object, check contains() first");
+		scene.patch(dirty, index, index + 1);
+		return objects[index];
+	}
+
+	template<typename T>
+	bool remove(vector<T>& objects, Slot_Map& slots, unsigned dirty, sceneHandle<T> handle)
+	{
+		slots.sync(objects.size());
+		size_t index, last;
+		if (!slots.remove(handle.index, handle.generation, index, last))
+			return false;
+		if (index != last)
+		{
+			objects[index] = objects[last];
+			scene.patch(dirty, index, index + 1);
+		}
+		objects.pop_back();
+		// the length changed either way
+		scene.patch(dirty, 0, 0);
+		return true;
+	}
+};
@@ -0,0 +1,331 @@
+#include "SceneFile.h"
+#include "MappedFile.h"
+#include <cstdio>
+#include <chrono>
+#include <iostream>
+#include <algorithm>
+
+using namespace std;
+
+static double elapsed_ms(chrono::steady_clock::time_point since)
+{
+	return chrono::duration<double, milli>(chrono::steady_clock::now() - since).count();
+}
+
+static const uint32_t section_strides[RSCN_SECTION_COUNT] = {
+	sizeof(rscnSettings), sizeof(raytSphere), sizeof(raytSurface), sizeof(raytBox), sizeof(raytMeshInstance),
+	sizeof(raytMaterial), sizeof(raytLightPoint), sizeof(raytLightDirect), sizeof(rscnMesh), sizeof(glm::vec4),
+	sizeof(raytTriangle), sizeof(raytBvhNode), sizeof(rscnTexture)
+};
+
+template<typename T>
+static void assign(vector<T>& v, const unsigned char* data, const rscnSection* section)
+{
+	if (!section)
+		return;
+	const T* first = reinterpret_cast<const T*>(data + section->offset);
+	v.assign(first, first + section->count);
+}
+
+// every object's material is one of the scene's, false with a message otherwise
+template<typename T>
+static bool check_materials(const vector<T>& objects, size_t materials, const char* what, const char* path)
+{
+	for (size_t i = 0; i < objects.size(); i++)
+		if (objects[i].material < 0 || static_cast<size_t>(objects[i].material) >= materials)
+		{
+			cout << "Malformed " << what << " " << i << " in scene file: " << path << endl;
+			return false;
+		}
+	return true;
+}
+
+bool rscn_sections(const unsigned char* data, size_t size, const char* path, const rscnSection* sections[RSCN_SECTION_COUNT])
+{
+	const rscnHeader* header = reinterpret_cast<const rscnHeader*>(data);
+	if (size < sizeof(rscnHeader) || header->magic != RSCN_MAGIC || header->version != RSCN_VERSION ||
+		(size - sizeof(rscnHeader)) / sizeof(rscnSection) < header->sections)
+	{
+		cout << "Malformed scene file: " << path << endl;
+		return false;
+	}
+
+	for (int i = 0; i < RSCN_SECTION_COUNT; i++)
+		sections[i] = nullptr;
+	const rscnSection* table = reinterpret_cast<const rscnSection*>(data + sizeof(rscnHeader));
+	for (uint32_t i = 0; i < header->sections; i++)
+	{
+		const rscnSection& section = table[i];
+		// unknown sections are skipped, newer writers may add some
+		if (section.type >= RSCN_SECTION_COUNT)
+			continue;
+		if (section.stride != section_strides[section.type])
+		{
+			cout << "Scene file " << path << " was written with a different layout of section " << section.type << endl;
+			return false;
+		}
+		if (section.offset > size || section.count > (size - section.offset) / section.stride)
+		{
+			cout << "Malformed scene file: " << path << endl;
+			return false;
+		}
+		sections[section.type] = &section;
+	}
+	if (!sections[RSCN_SETTINGS] || sections[RSCN_SETTINGS]->count != 1)
+	{
+		cout << "Scene file without settings: " << path << endl;
+		return false;
+	}
+	return true;
+}
+
+bool rscn_load_base(const unsigned char* data, const rscnSection* const sections[RSCN_SECTION_COUNT], const char* path, sceneContainer& scene)
+{
+	sceneContainer loaded = {};
+	const rscnSettings& settings = *reinterpret_cast<const rscnSettings*>(data + sections[RSCN_SETTINGS]->offset);
+	loaded.scene = settings.scene;
+	loaded.ambient_color = glm::vec3(settings.ambient_color);
+	loaded.shadow_ambient = glm::vec3(settings.shadow_ambient);
+
+	assign(loaded.surfaces, data, sections[RSCN_SURFACES]);
+	assign(loaded.materials, data, sections[RSCN_MATERIALS]);
+	assign(loaded.lights_point, data, sections[RSCN_LIGHTS_POINT]);
+	assign(loaded.lights_direct, data, sections[RSCN_LIGHTS_DIRECT]);
+
+	if (!check_materials(loaded.surfaces, loaded.materials.size(), "surface", path))
+		return false;
+	for (size_t i = 0; i < loaded.materials.size(); i++)
+		loaded.material_lookup.insert({ sceneContainer::material_hash(loaded.materials[i]), static_cast<int>(i) });
+
+	if (sections[RSCN_MESHES])
+	{
+		const rscnMesh* meshes = reinterpret_cast<const rscnMesh*>(data + sections[RSCN_MESHES]->offset);
+		const glm::vec4* vertices = reinterpret_cast<const glm::vec4*>(data + (sections[RSCN_MESH_VERTICES] ? sections[RSCN_MESH_VERTICES]->offset : 0));
+		const raytTriangle* triangles = reinterpret_cast<const raytTriangle*>(data + (sections[RSCN_MESH_TRIANGLES] ? sections[RSCN_MESH_TRIANGLES]->offset : 0));
+		const raytBvhNode* nodes = reinterpret_cast<const raytBvhNode*>(data + (sections[RSCN_MESH_NODES] ? sections[RSCN_MESH_NODES]->offset : 0));
+		uint64_t vertexCount = sections[RSCN_MESH_VERTICES] ? sections[RSCN_MESH_VERTICES]->count : 0;
+		uint64_t triangleCount = sections[RSCN_MESH_TRIANGLES] ? sections[RSCN_MESH_TRIANGLES]->count : 0;
+		uint64_t nodeCount = sections[RSCN_MESH_NODES] ? sections[RSCN_MESH_NODES]->count : 0;
+
+		for (uint64_t i = 0; i < sections[RSCN_MESHES]->count; i++)
+		{
+			const rscnMesh& m = meshes[i];
+			if (static_cast<uint64_t>(m.vertexFirst) + m.vertexCount > vertexCount ||
+				static_cast<uint64_t>(m.triangleFirst) + m.triangleCount > triangleCount ||
+				static_cast<uint64_t>(m.nodeFirst) + m.nodeCount > nodeCount)
+			{
+				cout << "Malformed mesh " << i << " in scene file: " << path << endl;
+				return false;
+			}
+			Mesh mesh;
+			mesh.vertices.assign(vertices + m.vertexFirst, vertices + m.vertexFirst + m.vertexCount);
+			mesh.triangles.assign(triangles + m.triangleFirst, triangles + m.triangleFirst + m.triangleCount);
+			mesh.nodes.assign(nodes + m.nodeFirst, nodes + m.nodeFirst + m.nodeCount);
+			if (!mesh.valid())
+			{
+				cout << "Malformed mesh " << i << " in scene file: " << path << endl;
+				return false;
+			}
+			loaded.mesh_data.push_back(move(mesh));
+		}
+	}
+
+	if (sections[RSCN_TEXTURES])
+	{
+		const rscnTexture* textures = reinterpret_cast<const rscnTexture*>(data + sections[RSCN_TEXTURES]->offset);
+		for (uint64_t i = 0; i < sections[RSCN_TEXTURES]->count; i++)
+		{
+			const rscnTexture& texture = textures[i];
+			size_t length = 0;
+			while (length < sizeof(texture.name) && texture.name[length])
+				length++;
+			loaded.textures.push_back({ string(texture.name, length), texture.streamed != 0 });
+		}
+	}
+
+	scene = move(loaded);
+	return true;
+}
+
+bool load_scene(const char* path, sceneContainer& scene)
+{
+	auto start = chrono::steady_clock::now();
+
+	Mapped_File file;
+	if (!file.open(path))
+	{
+		cout << "Scene failed to load at path: " << path << endl;
+		return false;
+	}
+	const unsigned char* data = file.data();
+	const rscnSection* sections[RSCN_SECTION_COUNT];
+	sceneContainer loaded;
+	if (!rscn_sections(data, file.size(), path, sections) || !rscn_load_base(data, sections, path, loaded))
+		return false;
+
+	assign(loaded.spheres, data, sections[RSCN_SPHERES]);
+	assign(loaded.boxes, data, sections[RSCN_BOXES]);
+	assign(loaded.mesh_instances, data, sections[RSCN_MESH_INSTANCES]);
+	size_t materials = loaded.materials.size();
+	if (!check_materials(loaded.spheres, materials, "sphere", path) || !check_materials(loaded.boxes, materials, "box", path) ||
+		!check_materials(loaded.mesh_instances, materials, "mesh instance", path))
+		return false;
+	for (const raytMeshInstance& instance : loaded.mesh_instances)
+		if (instance.geometry < 0 || instance.geometry >= static_cast<int>(loaded.mesh_data.size()))
+		{
+			cout << "Mesh instance of a missing mesh in scene file: " << path << endl;
+			return false;
+		}
+
+	scene = move(loaded);
+	printf("Scene '%s': %zu spheres, %zu surfaces, %zu boxes, %zu mesh instances of %zu meshes, %zu materials, %zu bytes mapped, loaded in %.1f ms\n",
+		path, scene.spheres.size(), scene.surfaces.size(), scene.boxes.size(), scene.mesh_instances.size(), scene.mesh_data.size(),
+		scene.materials.size(), file.size(), elapsed_ms(start));
+	return true;
+}
+
+float rscn_sphere_size(const raytSphere& sphere)
+{
+	return sphere.obj.w;
+}
+
+float rscn_box_size(const raytBox& box)
+{
+	return glm::length(box.form);
+}
+
+float rscn_mesh_size(const Mesh& mesh)
+{
+	return glm::length(mesh.bounds_max() - mesh.bounds_min()) * 0.5f;
+}
+
+namespace
+{
+	struct Section_Data
+	{
+		rscnSection section;
+		const void* data;
+	};
+}
+
+template<typename T>
+static void add_section(vector<Section_Data>& sections, uint32_t type, const T* data, size_t count)
+{
+	if (count == 0)
+		return;
+	rscnSection section = {};
+	section.type = type;
+	section.stride = sizeof(T);
+	section.count = count;
+	sections.push_back({ section, data });
+}
+
+// largest first, stable so equal sizes keep their order
+template<typename T, typename Size>
+static vector<T> sorted_by_size(const vector<T>& v, Size size)
+{
+	vector<T> sorted = v;
+	stable_sort(sorted.begin(), sorted.end(), [&](const T& a, const T& b) { return size(a) > size(b); });
+	return sorted;
+}
+
+bool save_scene(const char* path, const sceneContainer& scene)
+{
+	vector<float> meshSizes;
+	for (const Mesh& mesh : scene.mesh_data)
+		meshSizes.push_back(rscn_mesh_size(mesh));
+	vector<raytSphere> spheres = sorted_by_size(scene.spheres, rscn_sphere_size);
+	vector<raytBox> boxes = sorted_by_size(scene.boxes, rscn_box_size);
+	vector<raytMeshInstance> instances = sorted_by_size(scene.mesh_instances, [&](const raytMeshInstance& instance)
+	{
+		return instance.geometry >= 0 && instance.geometry < static_cast<int>(meshSizes.size()) ? meshSizes[instance.geometry] : 0.0f;
+	});
+
+	rscnSettings settings = {};
+	settings.scene = scene.scene;
+	settings.ambient_color = glm::vec4(scene.ambient_color, 0);
+	settings.shadow_ambient = glm::vec4(scene.shadow_ambient, 0);
+
+	vector<rscnMesh> meshes;
+	vector<glm::vec4> vertices;
+	vector<raytTriangle> triangles;
+	vector<raytBvhNode> nodes;
+	for (const Mesh& mesh : scene.mesh_data)
+	{
+		rscnMesh m = {};
+		m.vertexFirst = static_cast<uint32_t>(vertices.size());
+		m.vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+		m.triangleFirst = static_cast<uint32_t>(triangles.size());
+		m.triangleCount = static_cast<uint32_t>(mesh.triangles.size());
+		m.nodeFirst = static_cast<uint32_t>(nodes.size());
+		m.nodeCount = static_cast<uint32_t>(mesh.nodes.size());
+		meshes.push_back(m);
+		vertices.insert(vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+		triangles.insert(triangles.end(), mesh.triangles.begin(), mesh.triangles.end());
+		nodes.insert(nodes.end(), mesh.nodes.begin(), mesh.nodes.end());
+	}
+
+	vector<rscnTexture> textures;
+	for (const sceneTexture& texture : scene.textures)
+	{
+		rscnTexture t = {};
+		t.streamed = texture.streamed ? 1 : 0;
+		if (texture.name.size() >= sizeof(t.name))
+		{
+			cout << "Texture name too long for a scene file: " << texture.name << endl;
+			return false;
+		}
+		texture.name.copy(t.name, texture.name.size());
+		textures.push_back(t);
+	}
+
+	vector<Section_Data> sections;
+	add_section(sections, RSCN_SETTINGS, &settings, 1);
+	add_section(sections, RSCN_SPHERES, spheres.data(), spheres.size());
+	add_section(sections, RSCN_SURFACES, scene.surfaces.data(), scene.surfaces.size());
+	add_section(sections, RSCN_BOXES, boxes.data(), boxes.size());
+	add_section(sections, RSCN_MESH_INSTANCES, instances.data(), instances.size());
+	add_section(sections, RSCN_MATERIALS, scene.materials.data(), scene.materials.size());
+	add_section(sections, RSCN_LIGHTS_POINT, scene.lights_point.data(), scene.lights_point.size());
+	add_section(sections, RSCN_LIGHTS_DIRECT, scene.lights_direct.data(), scene.lights_direct.size());
+	add_section(sections, RSCN_MESHES, meshes.data(), meshes.size());
+	add_section(sections, RSCN_MESH_VERTICES, vertices.data(), vertices.size());
+	add_section(sections, RSCN_MESH_TRIANGLES, triangles.data(), triangles.size());
+	add_section(sections, RSCN_MESH_NODES, nodes.data(), nodes.size());
+	add_section(sections, RSCN_TEXTURES, textures.data(), textures.size());
+
+	uint64_t offset = sizeof(rscnHeader) + sections.size() * sizeof(rscnSection);
+	for (Section_Data& s : sections)
+	{
+		offset = (offset + 15) & ~static_cast<uint64_t>(15);
+		s.section.offset = offset;
+		offset += s.section.count * s.section.stride;
+	}
+
+	FILE* file = fopen(path, "wb");
+	if (!file)
+	{
+		cout << "Scene failed to save at path: " << path << endl;
+		return false;
+	}
+
+	rscnHeader header = {};
+	header.magic = RSCN_MAGIC;
+	header.version = RSCN_VERSION;
+	header.sections = static_cast<uint32_t>(sections.size());
+	fwrite(&header, sizeof(header), 1, file);
+	for (const Section_Data& s : sections)
+		fwrite(&s.section, sizeof(rscnSection), 1, file);
+
+	const unsigned char zeros[16] = {};
+	uint64_t written = sizeof(rscnHeader) + sections.size() * sizeof(rscnSection);
+	for (const Section_Data& s : sections)
+	{
+		fwrite(zeros, 1, static_cast<size_t>(s.section.offset - written), file);
+		fwrite(s.data, s.section.stride, static_cast<size_t>(s.section.count), file);
+		written = s.section.offset + s.section.count * s.section.stride;
+	}
+	bool ok = ferror(file) == 0;
+	fclose(file);
+	return ok;
+}
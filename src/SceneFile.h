@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include "scene.h"
+
+// .rscn, a scene stored the way it is uploaded:
+// rscnHeader, rscnSection[sections], then the section data, each 16 byte aligned.
+// Primitive, material and light sections are arrays of the scene.h structs, which
+// are already laid out for the std140 blocks in the fragment shader, so loading is
+// a mapping and one bulk copy per section. Meshes keep their built bvh. The stride
+// of every section is stored and checked, a struct that changed size invalidates
+// old files instead of misreading them. Native byte order, written by
+// tools/scene/scene_convert or save_scene().
+
+#define RSCN_MAGIC 0x4e435352 // "RSCN"
+#define RSCN_VERSION 1
+
+enum rscnSectionType
+{
+	RSCN_SETTINGS = 0, // one rscnSettings
+	RSCN_SPHERES,
+	RSCN_SURFACES,
+	RSCN_BOXES,
+	RSCN_MESH_INSTANCES,
+	RSCN_MATERIALS,
+	RSCN_LIGHTS_POINT,
+	RSCN_LIGHTS_DIRECT,
+	RSCN_MESHES, // rscnMesh ranges into the three sections below
+	RSCN_MESH_VERTICES,
+	RSCN_MESH_TRIANGLES,
+	RSCN_MESH_NODES,
+	RSCN_TEXTURES, // rscnTexture
+	RSCN_SECTION_COUNT
+};
+
+struct rscnHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t sections;
+	uint32_t _p1;
+};
+
+struct rscnSection
+{
+	uint32_t type;
+	uint32_t stride; // bytes per element
+	uint64_t count;
+	uint64_t offset;
+	uint64_t _p1;
+};
+
+struct rscnSettings
+{
+	raytScene scene;
+	glm::vec4 ambient_color;
+	glm::vec4 shadow_ambient;
+};
+
+struct rscnMesh
+{
+	uint32_t vertexFirst, vertexCount;
+	uint32_t triangleFirst, triangleCount;
+	uint32_t nodeFirst, nodeCount;
+	uint32_t _p1, _p2;
+};
+
+struct rscnTexture
+{
+	uint32_t streamed;
+	char name[124]; // zero terminated
+};
+
+// false with a message if the file is missing, malformed or from another version
+bool load_scene(const char* path, sceneContainer& scene);
+bool save_scene(const char* path, const sceneContainer& scene);
+
+// section table of a mapped file, entries of sections missing from the file are null
+bool rscn_sections(const unsigned char* data, size_t size, const char* path, const rscnSection* sections[RSCN_SECTION_COUNT]);
+// everything but the spheres, boxes and mesh instances, which may be streamed in later
+bool rscn_load_base(const unsigned char* data, const rscnSection* const sections[RSCN_SECTION_COUNT], const char* path, sceneContainer& scene);
+
+// the sort keys of the streamed arrays, bounding radius
+float rscn_sphere_size(const raytSphere& sphere);
+float rscn_box_size(const raytBox& box);
+float rscn_mesh_size(const Mesh& mesh);
@@ -0,0 +1,280 @@
+#include "SceneGeometry.h"
+#include <cfloat>
+#include <algorithm>
+
+using namespace std;
+
+const float Scene_Geometry::Max_Dist = 1000000.0f;
+
+// all of an array of count elements
+static sceneRangeList whole(size_t count)
+{
+	sceneRange range;
+	range.end = static_cast<uint32_t>(count);
+	sceneRangeList list;
+	list.add(range);
+	return list;
+}
+
+void Scene_Geometry::build(const sceneContainer& scene, unsigned dirty)
+{
+	if (dirty & DIRTY_SPHERES)
+		pack_spheres(scene, whole(scene.spheres.size()));
+
+	if (dirty & DIRTY_BOXES)
+		pack_boxes(scene, whole(scene.boxes.size()));
+
+	if (dirty & DIRTY_SURFACES)
+		pack_surfaces(scene, whole(scene.surfaces.size()));
+
+	if (dirty & DIRTY_MESH_INSTANCES)
+		instance_tree.build(scene.mesh_instances, scene.mesh_data);
+}
+
+void Scene_Geometry::patch(const sceneContainer& scene, unsigned patched)
+{
+	if (patched & DIRTY_SPHERES)
+		pack_spheres(scene, scene.patches[dirty_bit(DIRTY_SPHERES)]);
+
+	if (patched & DIRTY_BOXES)
+		pack_boxes(scene, scene.patches[dirty_bit(DIRTY_BOXES)]);
+
+	if (patched & DIRTY_SURFACES)
+		pack_surfaces(scene, scene.patches[dirty_bit(DIRTY_SURFACES)]);
+}
+
+// the packs follow the array's length, then the elements in ranges are packed anew
+void Scene_Geometry::pack_spheres(const sceneContainer& scene, const sceneRangeList& ranges)
+{
+	spheres.resize(scene.spheres.size());
+	sphere_cache.resize(scene.spheres.size());
+	sphere_rotations.resize(scene.spheres.size() * Sphere_Rotation_Stride);
+	for (const sceneRange& range : ranges)
+	{
+		size_t end = min<size_t>(range.end, scene.spheres.size());
+		for (size_t i = range.first; i < end; i++)
+		{
+			const raytSphere& sphere = scene.spheres[i];
+			spheres[i] = glm::vec4(glm::vec3(sphere.obj), sphere.hollow ? -sphere.obj.w : sphere.obj.w);
+			pack_transform(sphere_cache[i].update(sphere.quat_rotation), glm::vec3(0), &sphere_rotations[i * Sphere_Rotation_Stride]);
+		}
+	}
+}
+
+void Scene_Geometry::pack_boxes(const sceneContainer& scene, const sceneRangeList& ranges)
+{
+	box_cache.resize(scene.boxes.size());
+	boxes.resize(scene.boxes.size() * Box_Stride);
+	for (const sceneRange& range : ranges)
+	{
+		size_t end = min<size_t>(range.end, scene.boxes.size());
+		for (size_t i = range.first; i < end; i++)
+		{
+			const raytBox& box = scene.boxes[i];
+			glm::vec4* g = &boxes[i * Box_Stride];
+			pack_transform(box_cache[i].update(box.quat_rotation), box.pos, g);
+			g[3] = glm::vec4(box.form, 0);
+		}
+	}
+}
+
+void Scene_Geometry::pack_surfaces(const sceneContainer& scene, const sceneRangeList& ranges)
+{
+	surface_cache.resize(scene.surfaces.size());
+	surfaces.resize(scene.surfaces.size() * Surface_Stride);
+	for (const sceneRange& range : ranges)
+	{
+		size_t end = min<size_t>(range.end, scene.surfaces.size());
+		for (size_t i = range.first; i < end; i++)
+		{
+			const raytSurface& s = scene.surfaces[i];
+			glm::vec4* g = &surfaces[i * Surface_Stride];
+			pack_transform(surface_cache[i].update(s.quat_rotation), s.pos, g);
+			g[3] = glm::vec4(s.a, s.b, s.c, s.d);
+			g[4] = glm::vec4(s.xMin, s.yMin, s.zMin, s.e);
+			g[5] = glm::vec4(s.xMax, s.yMax, s.zMax, s.f);
+		}
+	}
+}
+
+static bool intersect_sphere_obj(glm::vec3 ro, glm::vec3 rd, glm::vec4 object, bool hollow, float tmin, float& t)
+{
+	glm::vec3 oc = ro - glm::vec3(object);
+	float b = glm::dot(oc, rd);
+	float c = glm::dot(oc, oc) - object.w * object.w;
+	float discriminant = b * b - c;
+	if (discriminant < 0.0f)
+		return false;
+
+	t = -b - sqrt(discriminant);
+	if (hollow && t < 0.0f)
+		t = -b + sqrt(discriminant);
+	return t > 0 && t < tmin;
+}
+
+bool Scene_Geometry::intersect_sphere(int num, glm::vec3 ro, glm::vec3 rd, bool hollow, float tmin, float& t) const
+{
+	glm::vec4 s = spheres[num];
+	return intersect_sphere_obj(ro, rd, glm::vec4(glm::vec3(s), abs(s.w)), hollow && s.w < 0, tmin, t);
+}
+
+bool Scene_Geometry::intersect_box(int num, glm::vec3 ro, glm::vec3 rd, float tmin, float& t, glm::vec3& normal) const
+{
+	const glm::vec4* g = &boxes[num * Box_Stride];
+
+	// ray in box space
+	glm::vec3 d = to_object_dir(g, rd);
+	glm::vec3 o = to_object(g, ro);
+
+	glm::vec3 m = 1.0f / d;
+	glm::vec3 n = m * o;
+	glm::vec3 k = glm::abs(m) * glm::vec3(g[3]);
+	glm::vec3 t1 = -n - k;
+	glm::vec3 t2 = -n + k;
+
+	float tnear = glm::max(glm::max(t1.x, t1.y), t1.z);
+	float tfar = glm::min(glm::min(t2.x, t2.y), t2.z);
+	if (tnear > tfar || tfar < 0.0f || tnear >= tmin)
+		return false;
+
+	glm::vec3 nor = -glm::sign(d) * glm::step(glm::vec3(t1.y, t1.z, t1.x), t1) * glm::step(glm::vec3(t1.z, t1.x, t1.y), t1);
+	t = tnear;
+	// back to world space
+	normal = to_world_dir(g, nor);
+	return true;
+}
+
+static bool inside(glm::vec3 pt, glm::vec3 v_min, glm::vec3 v_max)
+{
+	return pt.x > v_min.x && pt.y > v_min.y && pt.z > v_min.z && pt.x < v_max.x && pt.y < v_max.y && pt.z < v_max.z;
+}
+
+bool Scene_Geometry::intersect_surface(int num, glm::vec3 ro, glm::vec3 rd, float tmin, float& t) const
+{
+	const glm::vec4* g = &surfaces[num * Surface_Stride];
+	float a = g[3].x, b = g[3].y, c = g[3].z, sd = g[3].w, e = g[4].w, f = g[5].w;
+
+	glm::vec3 d = to_object_dir(g, rd);
+	glm::vec3 o = to_object(g, ro);
+
+	float p1 = 2 * a * d.x * o.x + 2 * b * d.y * o.y + 2 * c * d.z * o.z + sd * d.z + d.y * e;
+	float p2 = a * d.x * d.x + b * d.y * d.y + c * d.z * d.z;
+	float p3 = a * o.x * o.x + b * o.y * o.y + c * o.z * o.z + sd * o.z + e * o.y + f;
+	float p4 = sqrt(p1 * p1 - 4 * p2 * p3);
+
+	// division by zero
+	if (abs(p2) < 1e-6f)
+	{
+		t = -p3 / p1;
+		return t > 0 && t < tmin;
+	}
+
+	float tMin = FLT_MAX;
+	float tMax = FLT_MAX;
+	const float epsilon = 1e-4f;
+
+	float r1 = (-p1 - p4) / (2 * p2);
+	float r2 = (-p1 + p4) / (2 * p2);
+	if (r1 < tMin && r1 > epsilon)
+	{
+		tMin = r1;
+		tMax = r2;
+	}
+	if (r2 < tMin && r2 > epsilon)
+	{
+		tMin = r2;
+		tMax = r1;
+	}
+
+	// clip against the bounds
+	glm::vec3 v_min(g[4]), v_max(g[5]);
+	if (!inside(rd * tMin + ro, v_min, v_max))
+	{
+		if (tMax < epsilon || !inside(rd * tMax + ro, v_min, v_max))
+			return false;
+		swap(tMin, tMax);
+	}
+
+	t = tMin;
+	return t < tmin;
+}
+
+glm::vec3 Scene_Geometry::surface_normal(int num, glm::vec3 ro, glm::vec3 rd, float t) const
+{
+	const glm::vec4* g = &surfaces[num * Surface_Stride];
+	glm::vec3 tm = to_object_dir(g, rd) * t + to_object(g, ro);
+	glm::vec3 normal(2 * g[3].x * tm.x, 2 * g[3].y * tm.y + g[4].w, 2 * g[3].z * tm.z + g[3].w);
+	return glm::normalize(to_world_dir(g, normal));
+}
+
+float Scene_Geometry::intersect(const sceneContainer& scene, glm::vec3 ro, glm::vec3 rd, int& num, int& type, glm::vec3& normal) const
+{
+	float tmin = Max_Dist;
+	float t;
+	glm::vec3 n;
+
+	for (int i = 0; i < static_cast<int>(scene.lights_point.size()); i++)
+		if (intersect_sphere_obj(ro, rd, scene.lights_point[i].pos, false, tmin, t))
+		{
+			num = i; tmin = t; type = HIT_POINT_LIGHT;
+		}
+
+	for (int i = 0; i < static_cast<int>(surfaces.size()) / Surface_Stride; i++)
+		if (intersect_surface(i, ro, rd, tmin, t))
+		{
+			num = i; tmin = t; type = HIT_SURFACE;
+		}
+
+	for (int i = 0; i < static_cast<int>(spheres.size()); i++)
+		if (intersect_sphere(i, ro, rd, true, tmin, t))
+		{
+			num = i; tmin = t; type = HIT_SPHERE;
+		}
+
+	for (int i = 0; i < static_cast<int>(boxes.size()) / Box_Stride; i++)
+		if (intersect_box(i, ro, rd, tmin, t, n))
+		{
+			num = i; tmin = t; type = HIT_BOX; normal = n;
+		}
+
+	int instance;
+	if (instance_tree.intersect(scene.mesh_data, ro, rd, tmin, t, n, instance))
+	{
+		num = instance; tmin = t; type = HIT_MESH; normal = n;
+	}
+
+	if (tmin < Max_Dist)
+	{
+		glm::vec3 pt = ro + rd * tmin;
+		if (type == HIT_SPHERE)
+			normal = glm::normalize(pt - glm::vec3(spheres[num]));
+		else if (type == HIT_SURFACE)
+			normal = surface_normal(num, ro, rd, tmin);
+		else if (type == HIT_POINT_LIGHT)
+			normal = glm::normalize(pt - glm::vec3(scene.lights_point[num].pos));
+	}
+
+	return tmin;
+}
+
+// any hit closer than dist, mirrors in_Shadow in the fragment shader
+bool Scene_Geometry::occluded(const sceneContainer& scene, glm::vec3 ro, glm::vec3 rd, float dist) const
+{
+	float t;
+	glm::vec3 n;
+
+	for (int i = 0; i < static_cast<int>(spheres.size()); i++)
+		if (intersect_sphere(i, ro, rd, false, dist, t))
+			return true;
+
+	for (int i = 0; i < static_cast<int>(boxes.size()) / Box_Stride; i++)
+		if (intersect_box(i, ro, rd, dist, t, n))
+			return true;
+
+	for (int i = 0; i < static_cast<int>(surfaces.size()) / Surface_Stride; i++)
+		if (intersect_surface(i, ro, rd, dist, t))
+			return true;
+
+	int instance;
+	return instance_tree.intersect(scene.mesh_data, ro, rd, dist, t, n, instance);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "scene.h"
+#include "InstanceTree.h"
+#include "Transform.h"
+
+using namespace std;
+
+// hit types, same values as in the fragment shader
+enum hitType { HIT_SPHERE = 0, HIT_SURFACE = 1, HIT_BOX = 2, HIT_POINT_LIGHT = 3, HIT_MESH = 4 };
+
+// Packed copies of the primitives holding only what the intersection loops read.
+// Materials, textures and std140 padding stay in the sceneContainer arrays,
+// which are only touched once the closest hit is known.
+class Scene_Geometry
+{
+public:
+	vector<glm::vec4> spheres;          // center + radius, a negative radius marks a hollow sphere
+	vector<glm::vec4> sphere_rotations; // world to sphere rotation rows, only read for texturing
+	vector<glm::vec4> boxes;            // world to box rows with the translation in w, form
+	vector<glm::vec4> surfaces;         // world to surface rows with the translation in w, (a, b, c, d), v_min + e, v_max + f
+	Instance_Tree instance_tree;
+
+	static const int Sphere_Rotation_Stride = 3;
+	static const int Box_Stride = 4;
+	static const int Surface_Stride = 6;
+
+	// rebuilds the packs whose DIRTY_ flags are set, rotations are only
+	// recomputed for primitives whose quaternion changed
+	void build(const sceneContainer& scene, unsigned dirty);
+	// packs only scene.patches of the arrays whose DIRTY_ flags are in patched
+	void patch(const sceneContainer& scene, unsigned patched);
+
+	// closest hit, mirrors calc_Inter in the fragment shader
+	float intersect(const sceneContainer& scene, glm::vec3 ro, glm::vec3 rd, int& num, int& type, glm::vec3& normal) const;
+	bool occluded(const sceneContainer& scene, glm::vec3 ro, glm::vec3 rd, float dist) const;
+
+	bool intersect_sphere(int num, glm::vec3 ro, glm::vec3 rd, bool hollow, float tmin, float& t) const;
+	bool intersect_box(int num, glm::vec3 ro, glm::vec3 rd, float tmin, float& t, glm::vec3& normal) const;
+	bool intersect_surface(int num, glm::vec3 ro, glm::vec3 rd, float tmin, float& t) const;
+	glm::vec3 surface_normal(int num, glm::vec3 ro, glm::vec3 rd, float t) const;
+
+	static const float Max_Dist;
+
+private:
+	vector<Compiled_Rotation> sphere_cache, box_cache, surface_cache;
+
+	void pack_spheres(const sceneContainer& scene, const sceneRangeList& ranges);
+	void pack_boxes(const sceneContainer& scene, const sceneRangeList& ranges);
+	void pack_surfaces(const sceneContainer& scene, const sceneRangeList& ranges);
+};
@@ -1,6 +1,8 @@
 #include "SceneManager.h"
 #include <GLFW/glfw3.h>
 #include <glm/common.hpp>
+#include <algorithm>
+#include <cstdint>
 #include <stb_image.h>
 
 using namespace std;
@@ -11,129 +13,27 @@ Scene_Manager::Scene_Manager(int screen_width, int screen_height, sceneContainer
 	this->screen_height = screen_height;
 	this->util = util;
 	this->scene = scene;
-	this->position = scene->scene.camera_pos;
 }
 
 void Scene_Manager::init()
 {
-	glfwSetWindowUserPointer(util->window, this);
-
-	auto keyFunc = [](GLFWwindow* w, int a, int b, int c, int d)
-	{
-		static_cast<Scene_Manager*>(glfwGetWindowUserPointer(w))->glfw_key_callback(w, a, b, c, d);
-	};
-	auto mouseFunc = [](GLFWwindow* w, double x, double y)
-	{
-		static_cast<Scene_Manager*>(glfwGetWindowUserPointer(w))->glfw_mouse_callback(w, x, y);
-	};
-
-	glfwSetInputMode(util->window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-	glfwSetCursorPosCallback(util->window, mouseFunc);
-	glfwSetKeyCallback(util->window, keyFunc);
 	glfwSetFramebufferSizeCallback(util->window, glfw_framebuffer_size_callback);
 
 	init_buffers();
 }
 
-void Scene_Manager::update(float deltaTime)
+void Scene_Manager::update(sceneContainer* scene, unsigned dirty)
 {
-	scene_update(deltaTime);
+	this->scene = scene;
+	scene->dirty = dirty;
 	update_buffers();
 }
 
-void Scene_Manager::scene_update(float deltaTime)
-{
-	front.x = sin(glm::radians(yaw)) * cos(glm::radians(pitch));
-	front.y = sin(glm::radians(pitch));
-	front.z = cos(glm::radians(yaw)) * cos(glm::radians(pitch));
-	front = glm::normalize(front);
-	right = glm::normalize(glm::cross(-front, world_up));
-	scene->scene.quat_camera_rotation = glm::quat(glm::vec3(glm::radians(-pitch), glm::radians(yaw), 0));
-
-	auto speed = deltaTime * 3;
-	if (shift_pressed)
-		speed *= 3;
-	if (alt_pressed)
-		speed /= 3;
-
-	glm::vec3 aq = front * speed * 1e3f;
-
-	if (w_pressed)
-		position += front * speed;
-	if (a_pressed)
-		position -= right * speed;
-	if (s_pressed)
-		position -= front * speed;
-	if (d_pressed)
-		position += right * speed;
-	if (space_pressed)
-		position += world_up * speed;
-	if (ctrl_pressed)
-		position -= world_up * speed;
-
-	scene->scene.camera_pos = position;
-}
-
-void Scene_Manager::glfw_key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
-{
-	if (action == GLFW_PRESS || action == GLFW_RELEASE) {
-		if (key == GLFW_KEY_ESCAPE)
-			glfwSetWindowShouldClose(window, GL_TRUE);
-
-		bool pressed = action == GLFW_PRESS;
-
-		if (key == GLFW_KEY_W)
-			w_pressed = pressed;
-		else if (key == GLFW_KEY_A)
-			a_pressed = pressed;
-		else if (key == GLFW_KEY_S)
-			s_pressed = pressed;
-		else if (key == GLFW_KEY_D)
-			d_pressed = pressed;
-		else if (key == GLFW_KEY_SPACE)
-			space_pressed = pressed;
-		else if (key == GLFW_KEY_LEFT_CONTROL)
-			ctrl_pressed = pressed;
-		else if (key == GLFW_KEY_LEFT_SHIFT)
-			shift_pressed = pressed;
-		else if (key == GLFW_KEY_LEFT_ALT)
-			alt_pressed = pressed;
-	}
-}
-
 void Scene_Manager::glfw_framebuffer_size_callback(GLFWwindow* wind, int width, int height)
 {
 	glViewport(0, 0, width, height);
 }
 
-bool firstMouse = true;
-
-void Scene_Manager::glfw_mouse_callback(GLFWwindow* window, double xpos, double ypos) {
-    if (firstMouse)
-	{
-		lastX = xpos;
-		lastY = ypos;
-		firstMouse = false;
-	}
-
-	float xoffset = xpos - lastX;
-	float yoffset = lastY - ypos;
-	lastX = xpos;
-	lastY = ypos;
-
-	float sensitivity = 0.002f;
-	xoffset *= sensitivity;
-	yoffset *= sensitivity;
-
-	yaw += xoffset;
-	pitch += yoffset;
-
-	if (pitch > 89.0f)
-		pitch = 89.0f;
-	if (pitch < -89.0f)
-		pitch = -89.0f;
-}
-
 raytMaterial Scene_Manager::createMaterial(glm::vec3 color, int specular, float reflect, float refract, glm::vec3 absorb, float diffuse, float kd, float ks)
 {
 	raytMaterial material = {};
@@ -163,7 +63,7 @@ raytScene Scene_Manager::createScene(int width, int height)
 	return scene;
 }
 
-raytSphere Scene_Manager::createSphere(glm::vec3 center, float radius, raytMaterial material, bool hollow)
+raytSphere Scene_Manager::createSphere(glm::vec3 center, float radius, int material, bool hollow)
 {
 	raytSphere sphere = {};
 	sphere.obj = glm::vec4(center, radius);
@@ -173,15 +73,25 @@ raytSphere Scene_Manager::createSphere(glm::vec3 center, float radius, raytMater
 	return sphere;
 }
 
-raytBox Scene_Manager::createBox(glm::vec3 pos, glm::vec3 form, raytMaterial material)
+raytBox Scene_Manager::createBox(glm::vec3 pos, glm::vec3 form, int material)
 {
 	raytBox box = {};
 	box.form = form;
 	box.pos = pos;
-	box.mat = material;
+	box.material = material;
 	return box;
 }
 
+raytMeshInstance Scene_Manager::createMeshInstance(int geometry, glm::vec3 pos, int material, glm::quat rotation)
+{
+	raytMeshInstance instance = {};
+	instance.geometry = geometry;
+	instance.pos = pos;
+	instance.material = material;
+	instance.quat_rotation = rotation;
+	return instance;
+}
+
 raytLightPoint Scene_Manager::createLightPoint(glm::vec4 position, glm::vec3 color, float intensity, float linear_k,
 	float quadratic_k)
 {
@@ -207,38 +117,224 @@ raytLightDirect Scene_Manager::createLightDirect(glm::vec3 direction, glm::vec3
 	return light;
 }
 
+// capacity is in elements of T, the buffer is sized for whichever is larger
 template<typename T>
-void Scene_Manager::init_buffer(GLuint* ubo, const char* name, int bindingPoint, vector<T>& v)
+void Scene_Manager::init_buffer(GLuint* ubo, const char* name, int bindingPoint, vector<T>& v, size_t capacity)
 {
-	util->init_buffer(ubo, name, bindingPoint, sizeof(T) * v.size(), v.data());
+	if (capacity <= v.size())
+	{
+		util->init_buffer(ubo, name, bindingPoint, sizeof(T) * v.size(), v.data());
+		return;
+	}
+	util->init_buffer(ubo, name, bindingPoint, sizeof(T) * capacity, nullptr);
+	update_buffer(*ubo, v);
 }
 
 void Scene_Manager::init_buffers()
 {
+	// the instance tree is built once the mesh offsets are known
+	geometry.build(*scene, DIRTY_ALL & ~DIRTY_MESH_INSTANCES);
+
+	size_t spheres = scene->sphere_capacity, boxes = scene->box_capacity;
+	sphereRoom = max(scene->spheres.size(), spheres);
+	surfaceRoom = scene->surfaces.size();
+	boxRoom = max(scene->boxes.size(), boxes);
+	materialRoom = scene->materials.size();
+	lightPointRoom = scene->lights_point.size();
+	lightDirectRoom = scene->lights_direct.size();
 	util->init_buffer(&sceneUbo, "scene_buf", 0, sizeof(raytScene), nullptr);
-	init_buffer(&sphereUbo, "spheres_buf", 1, scene->spheres);
+	init_buffer(&sphereUbo, "spheres_buf", 1, scene->spheres, spheres);
+	init_buffer(&sphereRotationUbo, "sphere_rotation_buf", 2, geometry.sphere_rotations, spheres * Scene_Geometry::Sphere_Rotation_Stride);
 	init_buffer(&surfaceUbo, "surfaces_buf", 3, scene->surfaces);
-	init_buffer(&boxUbo, "boxes_buf", 4, scene->boxes);
+	init_buffer(&boxUbo, "boxes_buf", 4, scene->boxes, boxes);
+	init_buffer(&materialUbo, "materials_buf", 5, scene->materials);
+	init_mesh_buffers();
 	init_buffer(&lightPointUbo, "lights_point_buf", 7, scene->lights_point);
 	init_buffer(&lightDirectUbo, "lights_direct_buf", 8, scene->lights_direct);
+	init_buffer(&sphereGeoUbo, "sphere_geo_buf", 9, geometry.spheres, spheres);
+	init_buffer(&surfaceGeoUbo, "surface_geo_buf", 10, geometry.surfaces);
+	init_buffer(&boxGeoUbo, "box_geo_buf", 11, geometry.boxes, boxes * Scene_Geometry::Box_Stride);
+	scene->dirty = 0;
+	scene->clear_patches();
+
+	print_footprint();
+}
+
+void Scene_Manager::print_footprint() const
+{
+	printf("Scene buffers: %zu spheres x %zu B, %zu surfaces x %zu B, %zu boxes x %zu B, %zu mesh instances x %zu B, %zu materials x %zu B\n",
+		scene->spheres.size(), sizeof(raytSphere), scene->surfaces.size(), sizeof(raytSurface),
+		scene->boxes.size(), sizeof(raytBox), scene->mesh_instances.size(), sizeof(raytMeshInstance),
+		scene->materials.size(), sizeof(raytMaterial));
+	printf("Intersection buffers: %zu B/sphere, %zu B/box, %zu B/surface, %zu B/mesh instance\n",
+		sizeof(glm::vec4), Scene_Geometry::Box_Stride * sizeof(glm::vec4), Scene_Geometry::Surface_Stride * sizeof(glm::vec4),
+		Instance_Tree::Instance_Stride * sizeof(glm::vec4));
+}
+
+// all mesh geometry is concatenated into three buffer textures, instances
+// keep the offsets of their geometry and are referenced by the top level tree
+void Scene_Manager::init_mesh_buffers()
+{
+	vector<glm::vec4> vertices;
+	vector<raytTriangle> triangles;
+	vector<raytBvhNode> nodes;
+
+	mesh_offsets.clear();
+	for (const Mesh& mesh : scene->mesh_data)
+	{
+		mesh_offsets.push_back(glm::ivec3(nodes.size(), triangles.size(), vertices.size()));
+		vertices.insert(vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+		triangles.insert(triangles.end(), mesh.triangles.begin(), mesh.triangles.end());
+		nodes.insert(nodes.end(), mesh.nodes.begin(), mesh.nodes.end());
+	}
+
+	apply_mesh_offsets();
+	geometry.instance_tree.build(scene->mesh_instances, scene->mesh_data);
+	const Instance_Tree& instance_tree = geometry.instance_tree;
+
+	util->init_texture_buffer(&meshVertexTbo, &meshVertexTex, GL_RGBA32F, 3, "mesh_vertices", vertices.size() * sizeof(glm::vec4), vertices.data());
+	util->init_texture_buffer(&meshTriangleTbo, &meshTriangleTex, GL_RGBA32I, 4, "mesh_triangles", triangles.size() * sizeof(raytTriangle), triangles.data());
+	util->init_texture_buffer(&meshNodeTbo, &meshNodeTex, GL_RGBA32F, 5, "mesh_nodes", nodes.size() * sizeof(raytBvhNode), nodes.data());
+	util->init_texture_buffer(&instanceTbo, &instanceTex, GL_RGBA32F, 6, "mesh_instances",
+		instance_tree.packed.size() * sizeof(glm::vec4), instance_tree.packed.data());
+	util->init_texture_buffer(&instanceNodeTbo, &instanceNodeTex, GL_RGBA32F, 7, "instance_nodes",
+		instance_tree.nodes.size() * sizeof(raytBvhNode), instance_tree.nodes.data());
+
+	size_t geometryBytes = (vertices.size() + triangles.size()) * 16 + nodes.size() * sizeof(raytBvhNode);
+	printf("Mesh instances: %zu instances of %zu meshes, geometry %zu bytes, instances + top level bvh %zu bytes (%.1f bytes/instance)\n",
+		scene->mesh_instances.size(), scene->mesh_data.size(), geometryBytes, instance_tree.memory_bytes(),
+		scene->mesh_instances.empty() ? 0.0 : static_cast<double>(instance_tree.memory_bytes()) / scene->mesh_instances.size());
+}
+
+// instances added after the mesh buffers were uploaded need their offsets too,
+// the meshes themselves do not change
+void Scene_Manager::apply_mesh_offsets()
+{
+	for (raytMeshInstance& instance : scene->mesh_instances)
+	{
+		instance.node_offset = mesh_offsets[instance.geometry].x;
+		instance.tri_offset = mesh_offsets[instance.geometry].y;
+		instance.vertex_offset = mesh_offsets[instance.geometry].z;
+	}
+}
+
+// the top level tree was rebuilt, upload it with the leaf ordered instances
+void Scene_Manager::update_mesh_instances()
+{
+	const Instance_Tree& instance_tree = geometry.instance_tree;
+	if (instance_tree.instances.empty())
+		return;
+
+	util->update_texture_buffer(instanceTbo, instance_tree.packed.size() * sizeof(glm::vec4), instance_tree.packed.data());
+	util->update_texture_buffer(instanceNodeTbo, instance_tree.nodes.size() * sizeof(raytBvhNode), instance_tree.nodes.data());
+}
+
+// at most room elements of v
+template<typename T>
+void Scene_Manager::update_buffer(GLuint ubo, vector<T>& v, size_t room) const
+{
+	size_t count = min(v.size(), room);
+	if (count > 0)
+	{
+		util->update_buffer(ubo, sizeof(T) * count, v.data());
+	}
 }
 
+// the objects in ranges, stride elements of v each, up to room elements, one upload per range
 template<typename T>
-void Scene_Manager::update_buffer(GLuint ubo, vector<T>& v) const
+void Scene_Manager::patch_buffer(GLuint ubo, vector<T>& v, const sceneRangeList& ranges, size_t stride, size_t room) const
+{
+	for (const sceneRange& range : ranges)
+	{
+		size_t first = range.first * stride;
+		size_t end = min(min(range.end * stride, v.size()), room);
+		if (first < end)
+			util->update_buffer(ubo, sizeof(T) * (end - first), &v[first], sizeof(T) * first);
+	}
+}
+
+// the shader loops over no more objects than its arrays hold, the rest are not drawn
+int Scene_Manager::drawn(size_t count, size_t room, unsigned flag, const char* what)
 {
-	if (!v.empty())
+	if (count > room && !(warnedRoom & flag))
 	{
-		util->update_buffer(ubo, sizeof(T) * v.size(), v.data());
+		printf("Scene_Manager: %zu %s, the shader has room for %zu, the rest are not drawn\n", count, what, room);
+		warnedRoom |= flag;
 	}
+	return static_cast<int>(min(count, room));
 }
 
-void Scene_Manager::update_buffers() const
+// the camera changes every frame, everything else only when marked dirty; arrays with
+// only patches marked upload just the objects in them
+void Scene_Manager::update_buffers()
 {
+	// the top level tree is rebuilt whole, materials and lights are small
+	unsigned dirty = scene->dirty | (scene->patched & (DIRTY_MESH_INSTANCES | DIRTY_MATERIALS | DIRTY_LIGHTS));
+	unsigned patched = scene->patched & ~dirty;
+	if (dirty & DIRTY_MESH_INSTANCES)
+		apply_mesh_offsets();
+	geometry.build(*scene, dirty);
+	geometry.patch(*scene, patched);
+
+	scene->scene.sphere_count = drawn(scene->spheres.size(), sphereRoom, DIRTY_SPHERES, "spheres");
+	scene->scene.box_count = drawn(scene->boxes.size(), boxRoom, DIRTY_BOXES, "boxes");
+	drawn(scene->surfaces.size(), surfaceRoom, DIRTY_SURFACES, "surfaces");
+	scene->scene.mesh_instance_count = static_cast<int>(scene->mesh_instances.size());
 	util->update_buffer(sceneUbo, sizeof(raytScene), &scene->scene);
-	update_buffer(sphereUbo, scene->spheres);
-	update_buffer(surfaceUbo, scene->surfaces);
-	update_buffer(boxUbo, scene->boxes);
-	update_buffer(lightPointUbo, scene->lights_point);
+	if (dirty & DIRTY_SPHERES)
+	{
+		update_buffer(sphereUbo, scene->spheres, sphereRoom);
+		update_buffer(sphereGeoUbo, geometry.spheres, sphereRoom);
+		update_buffer(sphereRotationUbo, geometry.sphere_rotations, sphereRoom * Scene_Geometry::Sphere_Rotation_Stride);
+	}
+	else if (patched & DIRTY_SPHERES)
+	{
+		const sceneRangeList& ranges = scene->patches[dirty_bit(DIRTY_SPHERES)];
+		patch_buffer(sphereUbo, scene->spheres, ranges, 1, sphereRoom);
+		patch_buffer(sphereGeoUbo, geometry.spheres, ranges, 1, sphereRoom);
+		patch_buffer(sphereRotationUbo, geometry.sphere_rotations, ranges, Scene_Geometry::Sphere_Rotation_Stride,
+			sphereRoom * Scene_Geometry::Sphere_Rotation_Stride);
+	}
+	if (dirty & DIRTY_SURFACES)
+	{
+		update_buffer(surfaceUbo, scene->surfaces, surfaceRoom);
+		update_buffer(surfaceGeoUbo, geometry.surfaces, surfaceRoom * Scene_Geometry::Surface_Stride);
+	}
+	else if (patched & DIRTY_SURFACES)
+	{
+		const sceneRangeList& ranges = scene->patches[dirty_bit(DIRTY_SURFACES)];
+		patch_buffer(surfaceUbo, scene->surfaces, ranges, 1, surfaceRoom);
+		patch_buffer(surfaceGeoUbo, geometry.surfaces, ranges, Scene_Geometry::Surface_Stride,
+			surfaceRoom * Scene_Geometry::Surface_Stride);
+	}
+	if (dirty & DIRTY_BOXES)
+	{
+		update_buffer(boxUbo, scene->boxes, boxRoom);
+		update_buffer(boxGeoUbo, geometry.boxes, boxRoom * Scene_Geometry::Box_Stride);
+	}
+	else if (patched & DIRTY_BOXES)
+	{
+		const sceneRangeList& ranges = scene->patches[dirty_bit(DIRTY_BOXES)];
+		patch_buffer(boxUbo, scene->boxes, ranges, 1, boxRoom);
+		patch_buffer(boxGeoUbo, geometry.boxes, ranges, Scene_Geometry::Box_Stride, boxRoom * Scene_Geometry::Box_Stride);
+	}
+	if (dirty & DIRTY_MATERIALS)
+	{
+		drawn(scene->materials.size(), materialRoom, DIRTY_MATERIALS, "materials");
+		update_buffer(materialUbo, scene->materials, materialRoom);
+	}
+	if (dirty & DIRTY_MESH_INSTANCES)
+		update_mesh_instances();
+	if (dirty & DIRTY_LIGHTS)
+	{
+		drawn(scene->lights_point.size(), lightPointRoom, DIRTY_LIGHTS, "point lights");
+		drawn(scene->lights_direct.size(), lightDirectRoom, DIRTY_LIGHTS << 8, "direct lights");
+		update_buffer(lightPointUbo, scene->lights_point, lightPointRoom);
+		update_buffer(lightDirectUbo, scene->lights_direct, lightDirectRoom);
+	}
+
+	scene->dirty = 0;
+	scene->clear_patches();
 }
 
 glm::vec3 Scene_Manager::get_color(float r, float g, float b)
@@ -2,6 +2,7 @@
 
 #include "GLutility.h"
 #include "scene.h"
+#include "SceneGeometry.h"
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
@@ -14,11 +15,14 @@ public:
 	Scene_Manager(int screen_width, int screen_height, sceneContainer* scene, GL_Utility* wrapper);
 
 	void init();
-	void update(float frameRate);
+	// render thread, uploads the parts of scene marked in dirty, scene replaces the one
+	// given before, see Simulation::acquire
+	void update(sceneContainer* scene, unsigned dirty);
 
 	static raytMaterial createMaterial(glm::vec3 color, int specular, float reflect, float refract = 0.0, glm::vec3 absorb = {}, float diffuse = 0.7, float kd = 0.8, float ks = 0.2);
-	static raytSphere createSphere(glm::vec3 center, float radius, raytMaterial material, bool hollow = false);
-	static raytBox createBox(glm::vec3 pos, glm::vec3 form, raytMaterial material);
+	static raytSphere createSphere(glm::vec3 center, float radius, int material, bool hollow = false);
+	static raytBox createBox(glm::vec3 pos, glm::vec3 form, int material);
+	static raytMeshInstance createMeshInstance(int geometry, glm::vec3 pos, int material, glm::quat rotation = glm::quat(1, 0, 0, 0));
 	static raytLightPoint createLightPoint(glm::vec4 position, glm::vec3 color, float intensity, float linear_k = 0.22f, float quadratic_k = 0.2f);
 	static raytLightDirect createLightDirect(glm::vec3 direction, glm::vec3 color, float intensity);
 	static raytScene createScene(int width, int height);
@@ -29,45 +33,51 @@ private:
 	int screen_width;
 	int screen_height;
 	GL_Utility* util;
-	
-	bool w_pressed = false;
-	bool a_pressed = false;
-	bool s_pressed = false;
-	bool d_pressed = false;
-	bool ctrl_pressed = false;
-	bool shift_pressed = false;
-	bool space_pressed = false;
-	bool alt_pressed = false;
-
-	float lastX = 0;
-	float lastY = 0;
-
-	// Camera Attributes
-	glm::vec3 position;
-	glm::vec3 front;
-	glm::vec3 right;
-	glm::vec3 world_up = glm::vec3(0, 1, 0);
-	// Euler Angles
-	float yaw = 0;
-	float pitch = 0;
 
 	GLuint sceneUbo = 0;
 	GLuint sphereUbo = 0;
 	GLuint surfaceUbo = 0;
 	GLuint boxUbo = 0;
+	GLuint materialUbo = 0;
+	GLuint meshVertexTbo = 0, meshVertexTex = 0;
+	GLuint meshTriangleTbo = 0, meshTriangleTex = 0;
+	GLuint meshNodeTbo = 0, meshNodeTex = 0;
+	GLuint instanceTbo = 0, instanceTex = 0;
+	GLuint instanceNodeTbo = 0, instanceNodeTex = 0;
+	GLuint sphereGeoUbo = 0;
+	GLuint sphereRotationUbo = 0;
+	GLuint surfaceGeoUbo = 0;
+	GLuint boxGeoUbo = 0;
+
+	Scene_Geometry geometry;
+	vector<glm::ivec3> mesh_offsets; // node, triangle and vertex offset of each mesh in the buffers
 	GLuint lightPointUbo = 0;
 	GLuint lightDirectUbo = 0;
+	// elements the buffers and the shader's arrays have room for
+	size_t sphereRoom = 0;
+	size_t surfaceRoom = 0;
+	size_t boxRoom = 0;
+	size_t materialRoom = 0;
+	size_t lightPointRoom = 0;
+	size_t lightDirectRoom = 0;
+	// DIRTY_ bits of the arrays that outgrew their room, the direct lights' one shifted
+	// past the DIRTY_ bits
+	unsigned warnedRoom = 0;
 
-	void scene_update(float deltaTime);
-	void glfw_key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
 	static void glfw_framebuffer_size_callback(GLFWwindow* wind, int width, int height);
-	void glfw_mouse_callback(GLFWwindow* window, double xpos, double ypos);
 	void init_buffers();
-	void update_buffers() const;
+	void init_mesh_buffers();
+	void print_footprint() const;
+	void apply_mesh_offsets();
+	void update_mesh_instances();
+	void update_buffers();
+	int drawn(size_t count, size_t room, unsigned flag, const char* what);
 	glm::vec3 get_color(float r, float g, float b);
 
 	template<typename T>
-	void init_buffer(GLuint* ubo, const char* name, int bindingPoint, vector<T>& v);
+	void init_buffer(GLuint* ubo, const char* name, int bindingPoint, vector<T>& v, size_t capacity = 0);
+	template<typename T>
+	void update_buffer(GLuint ubo, vector<T>& v, size_t room = SIZE_MAX) const;
 	template<typename T>
-	void update_buffer(GLuint ubo, vector<T>& v) const;
+	void patch_buffer(GLuint ubo, vector<T>& v, const sceneRangeList& ranges, size_t stride, size_t room) const;
 };
@@ -0,0 +1,259 @@
+#include "SceneStreamer.h"
+#include <cstdio>
+#include <cfloat>
+#include <iostream>
+#include <algorithm>
+
+using namespace std;
+
+static double elapsed_ms(chrono::steady_clock::time_point since)
+{
+	return chrono::duration<double, milli>(chrono::steady_clock::now() - since).count();
+}
+
+// index of the first appended element
+template<typename T>
+static size_t append(vector<T>& v, const vector<unsigned char>& bytes, size_t count)
+{
+	size_t first = v.size();
+	const T* data = reinterpret_cast<const T*>(bytes.data());
+	v.insert(v.end(), data, data + count);
+	return first;
+}
+
+static int remap_texture(const vector<int>& remap, int textureNum)
+{
+	return textureNum > 0 && textureNum < static_cast<int>(remap.size()) ? remap[textureNum] : 0;
+}
+
+Scene_Streamer::Scene_Streamer(size_t bytesPerFrame, size_t maxChunks)
+	: bytesPerFrame(bytesPerFrame), maxChunks(max<size_t>(maxChunks, 1))
+{
+}
+
+Scene_Streamer::~Scene_Streamer()
+{
+	stop();
+}
+
+void Scene_Streamer::stop()
+{
+	{
+		lock_guard<mutex> guard(lock);
+		stopping = true;
+	}
+	wake.notify_all();
+	if (reader.joinable())
+		reader.join();
+}
+
+bool Scene_Streamer::open(const char* path, sceneContainer& scene)
+{
+	stop();
+	auto started = chrono::steady_clock::now();
+
+	// not populated, pages are read in by the reader thread as it gets to them
+	if (!file.open(path, false))
+	{
+		cout << "Scene failed to load at path: " << path << endl;
+		return false;
+	}
+	sceneContainer loaded;
+	if (!rscn_sections(file.data(), file.size(), path, sections) || !rscn_load_base(file.data(), sections, path, loaded))
+	{
+		file.close();
+		return false;
+	}
+
+	loaded.sphere_capacity = sections[RSCN_SPHERES] ? static_cast<size_t>(sections[RSCN_SPHERES]->count) : 0;
+	loaded.box_capacity = sections[RSCN_BOXES] ? static_cast<size_t>(sections[RSCN_BOXES]->count) : 0;
+	loaded.mesh_instance_capacity = sections[RSCN_MESH_INSTANCES] ? static_cast<size_t>(sections[RSCN_MESH_INSTANCES]->count) : 0;
+	loaded.reserve_capacity();
+	materialCount = loaded.materials.size();
+	meshSizes.clear();
+	for (const Mesh& mesh : loaded.mesh_data)
+		meshSizes.push_back(rscn_mesh_size(mesh));
+
+	this->path = path;
+	chunks.clear();
+	stopping = false;
+	finished = false;
+	reported = false;
+	skipped = 0;
+	steps = 0;
+	start = started;
+
+	printf("Scene '%s': %zu surfaces, %zu meshes, %zu materials loaded in %.1f ms, streaming %zu spheres, %zu boxes, %zu mesh instances\n",
+		path, loaded.surfaces.size(), loaded.mesh_data.size(), loaded.materials.size(), elapsed_ms(started),
+		loaded.sphere_capacity, loaded.box_capacity, loaded.mesh_instance_capacity);
+	scene = move(loaded);
+
+	reader = thread(&Scene_Streamer::read, this);
+	return true;
+}
+
+void Scene_Streamer::remap_textures(const vector<int>& remap)
+{
+	textureRemap = remap;
+}
+
+bool Scene_Streamer::push(Chunk chunk)
+{
+	unique_lock<mutex> guard(lock);
+	wake.wait(guard, [this] { return stopping || chunks.size() < maxChunks; });
+	if (stopping)
+		return false;
+	chunks.push_back(move(chunk));
+	return true;
+}
+
+// The three arrays are each sorted largest first by save_scene. They are merged so that
+// whichever array has the largest next object goes next, in runs of up to Chunk_Objects
+// that stay at least as large as the other arrays' next objects.
+void Scene_Streamer::read()
+{
+	const rscnSectionType types[3] = { RSCN_SPHERES, RSCN_BOXES, RSCN_MESH_INSTANCES };
+	const unsigned char* data = file.data();
+	size_t next[3] = {}, counts[3];
+	size_t missing = 0;
+	for (int a = 0; a < 3; a++)
+		counts[a] = sections[types[a]] ? static_cast<size_t>(sections[types[a]]->count) : 0;
+
+	auto element = [&](int a, size_t i)
+	{
+		return data + sections[types[a]]->offset + i * sections[types[a]]->stride;
+	};
+	auto valid_geometry = [&](const unsigned char* instance)
+	{
+		int geometry = reinterpret_cast<const raytMeshInstance*>(instance)->geometry;
+		return geometry >= 0 && geometry < static_cast<int>(meshSizes.size());
+	};
+	auto valid_material = [&](int material) { return material >= 0 && static_cast<size_t>(material) < materialCount; };
+	// the file was checked when opened except for the streamed arrays, objects that refer
+	// to what it does not have are left out
+	auto valid = [&](int a, const unsigned char* e)
+	{
+		if (types[a] == RSCN_SPHERES)
+			return valid_material(reinterpret_cast<const raytSphere*>(e)->material);
+		if (types[a] == RSCN_BOXES)
+			return valid_material(reinterpret_cast<const raytBox*>(e)->material);
+		return valid_geometry(e) && valid_material(reinterpret_cast<const raytMeshInstance*>(e)->material);
+	};
+	auto size_of = [&](int a, size_t i)
+	{
+		const unsigned char* e = element(a, i);
+		if (types[a] == RSCN_SPHERES)
+			return rscn_sphere_size(*reinterpret_cast<const raytSphere*>(e));
+		if (types[a] == RSCN_BOXES)
+			return rscn_box_size(*reinterpret_cast<const raytBox*>(e));
+		return valid_geometry(e) ? meshSizes[reinterpret_cast<const raytMeshInstance*>(e)->geometry] : 0.0f;
+	};
+
+	for (;;)
+	{
+		int array = -1;
+		float largest = 0, bound = -FLT_MAX;
+		for (int a = 0; a < 3; a++)
+		{
+			if (next[a] >= counts[a])
+				continue;
+			float size = size_of(a, next[a]);
+			if (array == -1 || size > largest)
+			{
+				if (array != -1)
+					bound = max(bound, largest);
+				array = a;
+				largest = size;
+			}
+			else
+				bound = max(bound, size);
+		}
+		if (array == -1)
+			break;
+
+		size_t first = next[array], last = first + 1;
+		while (last < counts[array] && last - first < Chunk_Objects && size_of(array, last) >= bound)
+			last++;
+		next[array] = last;
+
+		size_t stride = sections[types[array]]->stride;
+		Chunk chunk = { types[array], 0, {} };
+		chunk.bytes.reserve((last - first) * stride);
+		for (size_t i = first; i < last; i++)
+		{
+			const unsigned char* e = element(array, i);
+			if (!valid(array, e))
+			{
+				missing++;
+				continue;
+			}
+			chunk.bytes.insert(chunk.bytes.end(), e, e + stride);
+			chunk.count++;
+		}
+
+		if (chunk.count > 0 && !push(move(chunk)))
+			return;
+	}
+
+	lock_guard<mutex> guard(lock);
+	finished = true;
+	skipped = missing;
+}
+
+bool Scene_Streamer::done()
+{
+	lock_guard<mutex> guard(lock);
+	return finished && chunks.empty();
+}
+
+void Scene_Streamer::update(sceneContainer& scene)
+{
+	if (reported || !reader.joinable())
+		return;
+	steps++;
+
+	size_t bytes = 0;
+	while (bytes < bytesPerFrame)
+	{
+		Chunk chunk;
+		{
+			lock_guard<mutex> guard(lock);
+			if (chunks.empty())
+				break;
+			chunk = move(chunks.front());
+			chunks.pop_front();
+		}
+		wake.notify_one();
+		bytes += chunk.bytes.size();
+
+		if (chunk.type == RSCN_SPHERES)
+		{
+			size_t first = append(scene.spheres, chunk.bytes, chunk.count);
+			for (size_t i = first; i < scene.spheres.size(); i++)
+				scene.spheres[i].textureNum = remap_texture(textureRemap, scene.spheres[i].textureNum);
+			scene.patch(DIRTY_SPHERES, first, scene.spheres.size());
+		}
+		else if (chunk.type == RSCN_BOXES)
+		{
+			size_t first = append(scene.boxes, chunk.bytes, chunk.count);
+			for (size_t i = first; i < scene.boxes.size(); i++)
+				scene.boxes[i].textureNum = remap_texture(textureRemap, scene.boxes[i].textureNum);
+			scene.patch(DIRTY_BOXES, first, scene.boxes.size());
+		}
+		else
+		{
+			size_t first = append(scene.mesh_instances, chunk.bytes, chunk.count);
+			scene.patch(DIRTY_MESH_INSTANCES, first, scene.mesh_instances.size());
+		}
+	}
+
+	if (!done())
+		return;
+	reader.join();
+	file.close();
+	reported = true;
+	if (skipped > 0)
+		cout << skipped << " malformed objects, of missing meshes or materials, skipped in scene file: " << path << endl;
+	printf("Scene '%s': streamed %zu spheres, %zu boxes, %zu mesh instances in %.1f ms over %d steps\n",
+		path.c_str(), scene.spheres.size(), scene.boxes.size(), scene.mesh_instances.size(), elapsed_ms(start), steps);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+#include "scene.h"
+#include "SceneFile.h"
+#include "MappedFile.h"
+
+using namespace std;
+
+// Loads a .rscn scene progressively. open() reads everything small up front (settings,
+// materials, lights, surfaces, meshes) and reserves room for the rest, so the shader can
+// be built and rendering can start right away. A reader thread then copies the spheres,
+// boxes and mesh instances out of the mapped file in chunks, largest objects first
+// across all three arrays, and update() appends a bounded amount of them per step.
+class Scene_Streamer
+{
+public:
+	// bytesPerFrame bounds how much update() appends per step, maxChunks how far the reader runs ahead
+	explicit Scene_Streamer(size_t bytesPerFrame = 256 * 1024, size_t maxChunks = 64);
+	~Scene_Streamer();
+
+	Scene_Streamer(const Scene_Streamer&) = delete;
+	Scene_Streamer& operator=(const Scene_Streamer&) = delete;
+
+	// false with a message if the file is missing or malformed, scene is only touched on success
+	bool open(const char* path, sceneContainer& scene);
+	// textureNums of streamed objects index the file's texture list, point them at loaded textures
+	void remap_textures(const vector<int>& remap);
+	// the thread that updates the scene, once per step before the scene is published
+	void update(sceneContainer& scene);
+	bool done();
+
+	static const size_t Chunk_Objects = 1024;
+
+private:
+	struct Chunk
+	{
+		rscnSectionType type;
+		size_t count;
+		vector<unsigned char> bytes;
+	};
+
+	Mapped_File file;
+	string path;
+	const rscnSection* sections[RSCN_SECTION_COUNT] = {};
+	vector<float> meshSizes;
+	size_t materialCount = 0;
+	vector<int> textureRemap;
+	size_t bytesPerFrame;
+	size_t maxChunks;
+
+	thread reader;
+	mutex lock;
+	condition_variable wake;
+	deque<Chunk> chunks;
+	bool stopping = false;
+	bool finished = true; // the reader is through the file, or none was opened
+	bool reported = false;
+	size_t skipped = 0; // streamed objects of missing meshes or materials
+
+	chrono::steady_clock::time_point start;
+	int steps = 0;
+
+	void read();
+	// blocks while the queue is full, false once stopping
+	bool push(Chunk chunk);
+	void stop();
+};
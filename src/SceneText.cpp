@@ -0,0 +1,376 @@
+#include "SceneText.h"
+#include "Surface.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cfloat>
+#include <chrono>
+#include <iostream>
+#include <unordered_map>
+
+using namespace std;
+
+static double elapsed_ms(chrono::steady_clock::time_point since)
+{
+	return chrono::duration<double, milli>(chrono::steady_clock::now() - since).count();
+}
+
+namespace
+{
+	// one line split into words, named values are looked up by key and marked as used
+	// so that misspelled or unknown keys can be reported
+	class Statement
+	{
+	public:
+		vector<string> tokens;
+		string error;
+
+		void split(const char* line)
+		{
+			tokens.clear();
+			used.clear();
+			error.clear();
+			const char* p = line;
+			while (*p)
+			{
+				while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+					p++;
+				if (!*p || *p == '#')
+					break;
+				string token;
+				if (*p == '"')
+				{
+					for (p++; *p && *p != '"'; p++)
+						token += *p;
+					if (*p == '"')
+						p++;
+				}
+				else
+					for (; *p && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n'; p++)
+						token += *p;
+				tokens.push_back(token);
+			}
+			used.assign(tokens.size(), false);
+			if (!used.empty())
+				used[0] = true;
+		}
+
+		// the word at position i, for positional names
+		const string& word(size_t i)
+		{
+			static const string empty;
+			if (i >= tokens.size())
+			{
+				fail("missing name");
+				return empty;
+			}
+			used[i] = true;
+			return tokens[i];
+		}
+
+		bool flag(const char* key)
+		{
+			size_t at;
+			return find(key, 0, at);
+		}
+
+		bool text(const char* key, string& value)
+		{
+			size_t at;
+			if (!find(key, 1, at))
+				return false;
+			value = tokens[at];
+			return true;
+		}
+
+		bool number(const char* key, float& value)
+		{
+			return numbers(key, &value, 1);
+		}
+
+		bool vec3(const char* key, glm::vec3& value)
+		{
+			return numbers(key, &value.x, 3);
+		}
+
+		bool numbers(const char* key, float* values, int count)
+		{
+			size_t at;
+			if (!find(key, count, at))
+				return false;
+			for (int i = 0; i < count; i++)
+			{
+				char* end;
+				values[i] = strtof(tokens[at + i].c_str(), &end);
+				if (*end || tokens[at + i].empty())
+					fail("'" + tokens[at + i] + "' is not a number");
+			}
+			return true;
+		}
+
+		// leftovers are keys the statement does not know
+		bool check()
+		{
+			for (size_t i = 0; i < tokens.size() && error.empty(); i++)
+				if (!used[i])
+					fail("unexpected '" + tokens[i] + "'");
+			return error.empty();
+		}
+
+		void fail(const string& message)
+		{
+			if (error.empty())
+				error = message;
+		}
+
+	private:
+		vector<bool> used;
+
+		bool find(const char* key, int count, size_t& at)
+		{
+			for (size_t i = 1; i < tokens.size(); i++)
+				if (!used[i] && tokens[i] == key)
+				{
+					if (i + count >= tokens.size())
+					{
+						fail(string("'") + key + "' needs " + to_string(count) + " values");
+						return false;
+					}
+					for (int j = 0; j <= count; j++)
+						used[i + j] = true;
+					at = i + 1;
+					return true;
+				}
+			return false;
+		}
+	};
+
+	struct Parser
+	{
+		sceneContainer& scene;
+		string directory;
+		unordered_map<string, int> materials, textures, meshes;
+
+		Parser(sceneContainer& scene, const string& directory)
+			: scene(scene), directory(directory)
+		{
+		}
+
+		glm::quat rotation(Statement& s)
+		{
+			glm::vec3 degrees(0);
+			s.vec3("rotation", degrees);
+			return glm::quat(glm::radians(degrees));
+		}
+
+		template<typename Map>
+		int lookup(Statement& s, const char* key, const Map& names, bool required)
+		{
+			string name;
+			if (!s.text(key, name))
+			{
+				if (required)
+					s.fail(string("'") + key + "' is missing");
+				return required ? -1 : 0;
+			}
+			auto it = names.find(name);
+			if (it == names.end())
+			{
+				s.fail(string("unknown ") + key + " '" + name + "'");
+				return -1;
+			}
+			return it->second;
+		}
+
+		void require(Statement& s, bool found, const char* key)
+		{
+			if (!found)
+				s.fail(string("'") + key + "' is missing");
+		}
+
+		void statement(Statement& s)
+		{
+			const string& kind = s.tokens[0];
+			if (kind == "settings")
+			{
+				glm::vec3 camera = scene.scene.camera_pos, background = scene.scene.bg_color;
+				float depth = static_cast<float>(scene.scene.reflect_depth);
+				s.vec3("camera", camera);
+				s.vec3("background", background);
+				s.vec3("ambient", scene.ambient_color);
+				s.vec3("shadow_ambient", scene.shadow_ambient);
+				s.number("reflect_depth", depth);
+				scene.scene.camera_pos = camera;
+				scene.scene.bg_color = background;
+				scene.scene.reflect_depth = static_cast<int>(depth);
+			}
+			else if (kind == "texture")
+			{
+				string name = s.word(1), file = s.word(2);
+				scene.textures.push_back({ file, s.flag("streamed") });
+				textures[name] = static_cast<int>(scene.textures.size());
+			}
+			else if (kind == "material")
+			{
+				// defaults of Scene_Manager::createMaterial
+				raytMaterial m = {};
+				float specular = 0;
+				m.diffuse = 0.7f;
+				m.kd = 0.8f;
+				m.ks = 0.2f;
+				string name = s.word(1);
+				s.vec3("color", m.color);
+				s.number("specular", specular);
+				s.number("reflect", m.reflect);
+				s.number("refract", m.refract);
+				s.vec3("absorb", m.absorb);
+				s.number("diffuse", m.diffuse);
+				s.number("kd", m.kd);
+				s.number("ks", m.ks);
+				m.specular = static_cast<int>(specular);
+				materials[name] = scene.add_material(m);
+			}
+			else if (kind == "light_point")
+			{
+				raytLightPoint light = {};
+				glm::vec3 pos(0);
+				float radius = 0.1f;
+				light.linear_k = 0.22f;
+				light.quadratic_k = 0.2f;
+				require(s, s.vec3("pos", pos), "pos");
+				s.number("radius", radius);
+				require(s, s.vec3("color", light.color), "color");
+				require(s, s.number("intensity", light.intensity), "intensity");
+				s.number("linear", light.linear_k);
+				s.number("quadratic", light.quadratic_k);
+				light.pos = glm::vec4(pos, radius);
+				scene.lights_point.push_back(light);
+			}
+			else if (kind == "light_direct")
+			{
+				raytLightDirect light = {};
+				require(s, s.vec3("direction", light.direction), "direction");
+				require(s, s.vec3("color", light.color), "color");
+				require(s, s.number("intensity", light.intensity), "intensity");
+				scene.lights_direct.push_back(light);
+			}
+			else if (kind == "sphere")
+			{
+				raytSphere sphere = {};
+				glm::vec3 pos(0);
+				float radius = 1;
+				require(s, s.vec3("pos", pos), "pos");
+				s.number("radius", radius);
+				sphere.obj = glm::vec4(pos, radius);
+				sphere.hollow = s.flag("hollow");
+				sphere.material = lookup(s, "material", materials, true);
+				sphere.textureNum = lookup(s, "texture", textures, false);
+				sphere.quat_rotation = rotation(s);
+				scene.spheres.push_back(sphere);
+			}
+			else if (kind == "box")
+			{
+				raytBox box = {};
+				require(s, s.vec3("pos", box.pos), "pos");
+				require(s, s.vec3("size", box.form), "size");
+				box.material = lookup(s, "material", materials, true);
+				box.textureNum = lookup(s, "texture", textures, false);
+				box.quat_rotation = rotation(s);
+				scene.boxes.push_back(box);
+			}
+			else if (kind == "cylinder" || kind == "cone")
+			{
+				bool cone = kind == "cone";
+				float radius[3] = { 1, 1, 1 }, y[2] = { -FLT_MAX, FLT_MAX };
+				require(s, s.numbers("radius", radius, cone ? 3 : 2), "radius");
+				int material = lookup(s, "material", materials, true);
+				raytSurface surface = cone ? Surfaces::Elliptic_Cone(radius[0], radius[1], radius[2], material)
+					: Surfaces::Elliptic_Cylinder(radius[0], radius[1], material);
+				require(s, s.vec3("pos", surface.pos), "pos");
+				s.numbers("y", y, 2);
+				surface.yMin = y[0];
+				surface.yMax = y[1];
+				surface.quat_rotation = rotation(s);
+				scene.surfaces.push_back(surface);
+			}
+			else if (kind == "mesh")
+			{
+				string name = s.word(1), file = s.word(2);
+				if (!s.error.empty())
+					return;
+				Mesh mesh;
+				string path = file.size() > 0 && file[0] == '/' ? file : directory + file;
+				if (!Mesh::load_obj(path.c_str(), mesh))
+				{
+					s.fail("mesh '" + path + "' failed to load");
+					return;
+				}
+				scene.mesh_data.push_back(move(mesh));
+				meshes[name] = static_cast<int>(scene.mesh_data.size()) - 1;
+			}
+			else if (kind == "instance")
+			{
+				raytMeshInstance instance = {};
+				auto it = meshes.find(s.word(1));
+				if (it == meshes.end())
+				{
+					s.fail("unknown mesh '" + s.tokens[1] + "'");
+					return;
+				}
+				instance.geometry = it->second;
+				require(s, s.vec3("pos", instance.pos), "pos");
+				instance.material = lookup(s, "material", materials, true);
+				instance.quat_rotation = rotation(s);
+				scene.mesh_instances.push_back(instance);
+			}
+			else
+				s.fail("unknown statement '" + kind + "'");
+		}
+	};
+}
+
+bool parse_scene_text(const char* path, sceneContainer& scene)
+{
+	auto start = chrono::steady_clock::now();
+
+	FILE* file = fopen(path, "r");
+	if (!file)
+	{
+		cout << "Scene failed to load at path: " << path << endl;
+		return false;
+	}
+
+	sceneContainer parsed = {};
+	parsed.scene.reflect_depth = 5;
+	Parser parser(parsed, "");
+	string p = path;
+	size_t slash = p.find_last_of("/\\");
+	if (slash != string::npos)
+		parser.directory = p.substr(0, slash + 1);
+
+	char line[4096];
+	size_t lineNum = 0;
+	Statement s;
+	bool ok = true;
+	while (ok && fgets(line, sizeof(line), file))
+	{
+		lineNum++;
+		s.split(line);
+		if (s.tokens.empty())
+			continue;
+		parser.statement(s);
+		if (!s.check())
+		{
+			cout << path << ":" << lineNum << ": " << s.error << endl;
+			ok = false;
+		}
+	}
+	fclose(file);
+	if (!ok)
+		return false;
+
+	scene = move(parsed);
+	printf("Scene '%s': %zu spheres, %zu surfaces, %zu boxes, %zu mesh instances of %zu meshes, %zu materials, parsed in %.1f ms\n",
+		path, scene.spheres.size(), scene.surfaces.size(), scene.boxes.size(), scene.mesh_instances.size(), scene.mesh_data.size(),
+		scene.materials.size(), elapsed_ms(start));
+	return true;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "scene.h"
+
+// Human readable scene description, converted to .rscn by tools/scene/scene_convert.
+// One statement per line, a keyword followed by named values, # starts a comment,
+// names with spaces are quoted. Positions and sizes are in world units, rotations are
+// euler angles in degrees, mesh paths are relative to the scene file.
+//
+//   settings camera 0 0 -5 ambient 0.25 0.25 0.25 shadow_ambient 0.1 0.1 0.1 reflect_depth 5
+//   texture earth "Earth Texture.jpg" streamed
+//   material red color 1 0 0 specular 100 reflect 0.2
+//   light_point pos 3 5 0 radius 0.1 color 1 1 1 intensity 25.5
+//   light_direct direction 3 -1 1 color 1 1 1 intensity 1.5
+//   sphere pos 6.7 0 3.8 radius 1 material red hollow
+//   box pos 4.2 1 6 size 1 1 1 material plain texture container
+//   cylinder pos -2 0 6 radius 0.5 0.5 y -1 1 rotation 90 0 0 material green
+//   cone pos -6 4 6 radius 0.333 0.333 1 y -1 4 rotation 90 0 0 material crimson
+//   mesh icosahedron ../models/icosahedron.obj
+//   instance icosahedron pos 2.4 -0.05 8 material blue
+//
+// Materials take color, specular, reflect, refract, absorb, diffuse, kd and ks with
+// the defaults of Scene_Manager::createMaterial. Identical materials are shared.
+
+// false with a message naming the line if the file is missing or a statement is wrong
+bool parse_scene_text(const char* path, sceneContainer& scene);
@@ -0,0 +1,133 @@
+#include "ShaderCache.h"
+#include "utils.h"
+#include <cstdio>
+#include <vector>
+#include <iostream>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+using namespace std;
+
+static const uint32_t Cache_Magic = 0x4d475052; // "RPGM"
+
+struct cacheHeader
+{
+	uint32_t magic;
+	uint32_t format; // of glGetProgramBinary
+	uint64_t key;
+	uint64_t length;
+};
+
+bool Shader_Cache::open(const string& dir)
+{
+	GLint formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	if (!glGetProgramBinary || !glProgramBinary || formats == 0)
+	{
+		glGetError(); // the query is an error before GL 4.1 without the extension
+		cout << "Shader cache is off, the driver has no program binary formats" << endl;
+		return false;
+	}
+
+#ifdef _WIN32
+	_mkdir(dir.c_str());
+#else
+	mkdir(dir.c_str(), 0755);
+#endif
+	struct stat info;
+	if (stat(dir.c_str(), &info) != 0 || !(info.st_mode & S_IFDIR))
+	{
+		cout << "Shader cache is off, failed to create " << dir << endl;
+		return false;
+	}
+
+	string strings;
+	for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION })
+	{
+		const GLubyte* value = glGetString(name);
+		strings.append(value ? reinterpret_cast<const char*>(value) : "").append("\n");
+	}
+	driver = hash_bytes(strings.data(), strings.size());
+	this->dir = dir;
+	return true;
+}
+
+uint64_t Shader_Cache::key(uint64_t sources) const
+{
+	return hash_bytes(&sources, sizeof(sources), driver);
+}
+
+string Shader_Cache::path(uint64_t key) const
+{
+	char name[32];
+	snprintf(name, sizeof(name), "/%016llx.bin", static_cast<unsigned long long>(key));
+	return dir + name;
+}
+
+GLuint Shader_Cache::load(uint64_t sources) const
+{
+	if (dir.empty())
+		return 0;
+	uint64_t hash = key(sources);
+	FILE* file = fopen(path(hash).c_str(), "rb");
+	if (!file)
+		return 0;
+
+	cacheHeader header;
+	vector<char> binary;
+	bool ok = fread(&header, sizeof(header), 1, file) == 1 && header.magic == Cache_Magic && header.key == hash &&
+		header.length > 0 && header.length < (1u << 30);
+	if (ok)
+	{
+		binary.resize(static_cast<size_t>(header.length));
+		ok = fread(binary.data(), 1, binary.size(), file) == binary.size();
+	}
+	fclose(file);
+	if (!ok)
+		return 0;
+
+	GLuint program = glCreateProgram();
+	glProgramBinary(program, header.format, binary.data(), static_cast<GLsizei>(binary.size()));
+	GLint linked = 0;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	if (!linked)
+	{
+		// a driver may refuse its own binaries after an update, not an error
+		glDeleteProgram(program);
+		glGetError();
+		return 0;
+	}
+	return program;
+}
+
+void Shader_Cache::store(uint64_t sources, GLuint program) const
+{
+	if (dir.empty())
+		return;
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+
+	cacheHeader header = { Cache_Magic, 0, key(sources), 0 };
+	vector<char> binary(length);
+	GLsizei written = 0;
+	glGetProgramBinary(program, length, &written, &header.format, binary.data());
+	if (written <= 0)
+		return;
+	header.length = static_cast<uint64_t>(written);
+
+	// written under another name first, a run that is killed halfway leaves no entry
+	string target = path(header.key);
+	string temporary = target + ".tmp";
+	FILE* file = fopen(temporary.c_str(), "wb");
+	if (!file)
+		return;
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(binary.data(), 1, written, file) == static_cast<size_t>(written);
+	ok = fclose(file) == 0 && ok;
+	remove(target.c_str());
+	if (!ok || rename(temporary.c_str(), target.c_str()) != 0)
+		remove(temporary.c_str());
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <string>
+#include <cstdint>
+
+using namespace std;
+
+// Linked programs kept on disk as driver binaries, so a shader variant that was built
+// before is loaded instead of compiled again. An entry is named by the hash of the
+// preprocessed sources, see GL_Utility::shader_sources, and the driver strings, an
+// edited shader, a different variant or a driver update misses and is rebuilt. Off if
+// the driver has no program binary formats.
+class Shader_Cache
+{
+public:
+	// after the context is current, dir is created if missing
+	bool open(const string& dir);
+
+	// 0 on a miss, or if the driver rejects the binary
+	GLuint load(uint64_t sources) const;
+	void store(uint64_t sources, GLuint program) const;
+
+private:
+	string dir; // empty while off
+	uint64_t driver = 0;
+
+	uint64_t key(uint64_t sources) const;
+	string path(uint64_t key) const;
+};
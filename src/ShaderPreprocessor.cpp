@@ -0,0 +1,119 @@
+#include "ShaderPreprocessor.h"
+#include "FileSystem.h"
+#include "utils.h"
+#include <algorithm>
+
+using namespace std;
+
+static bool placeholder_char(char c)
+{
+	return (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+// the name between the quotes of an #include line, empty if the line is something else
+static string include_name(const string& line)
+{
+	size_t at = line.find_first_not_of(" \t");
+	if (at == string::npos || line.compare(at, 8, "#include") != 0)
+		return string();
+	size_t open = line.find('"', at + 8);
+	size_t close = open == string::npos ? open : line.find('"', open + 1);
+	if (close == string::npos || close == open + 1)
+		return string();
+	return line.substr(open + 1, close - open - 1);
+}
+
+void Shader_Preprocessor::define(const string& name, const string& value)
+{
+	definitions[name] = value;
+}
+
+void Shader_Preprocessor::define(const string& name, int value)
+{
+	definitions[name] = std::to_string(value);
+}
+
+bool Shader_Preprocessor::process(const string& name, string& output, string& errors)
+{
+	output.clear();
+	errors.clear();
+	sources.clear();
+	bool ok = expand(name, 0, output, errors) && errors.empty();
+	outputHash = ok ? hash_bytes(output.data(), output.size()) : 0;
+	return ok;
+}
+
+bool Shader_Preprocessor::expand(const string& name, int depth, string& output, string& errors)
+{
+	if (depth > Max_Include_Depth)
+	{
+		errors += name + ": includes nested deeper than " + std::to_string(Max_Include_Depth) + ", recursive?\n";
+		return false;
+	}
+	string text;
+	if (!File_System::assets().read_string(name, text))
+	{
+		errors += name + ": not found\n";
+		return false;
+	}
+	int source = static_cast<int>(sources.size());
+	sources.push_back(name);
+	string dir = name.substr(0, name.find_last_of('/') + 1);
+
+	int line = 1;
+	for (size_t begin = 0; begin < text.size(); line++)
+	{
+		size_t end = text.find('\n', begin);
+		end = end == string::npos ? text.size() : end + 1;
+		string current = text.substr(begin, end - begin);
+		begin = end;
+
+		string include = include_name(current);
+		if (include.empty())
+		{
+			substitute(current, source, line, output, errors);
+			continue;
+		}
+		// #line takes effect on the line after it
+		output += "#line 1 " + std::to_string(sources.size()) + "\n";
+		if (!expand(dir + include, depth + 1, output, errors))
+		{
+			errors += "  included from " + name + ":" + std::to_string(line) + "\n";
+			return false;
+		}
+		if (!output.empty() && output.back() != '\n')
+			output += '\n';
+		output += "#line " + std::to_string(line + 1) + " " + std::to_string(source) + "\n";
+	}
+	return true;
+}
+
+void Shader_Preprocessor::substitute(const string& text, int source, int line, string& output, string& errors) const
+{
+	size_t copied = 0;
+	bool multiline = false;
+	for (size_t open = text.find('{'); open != string::npos; open = text.find('{', open + 1))
+	{
+		size_t close = open + 1;
+		while (close < text.size() && placeholder_char(text[close]))
+			close++;
+		if (close == open + 1 || close >= text.size() || text[close] != '}')
+			continue;
+
+		string name = text.substr(open + 1, close - open - 1);
+		auto definition = definitions.find(name);
+		if (definition == definitions.end())
+		{
+			errors += sources[source] + ":" + std::to_string(line) + ": no definition for {" + name + "}\n";
+			continue;
+		}
+		output.append(text, copied, open - copied).append(definition->second);
+		multiline |= definition->second.find('\n') != string::npos;
+		copied = close + 1;
+		open = close;
+	}
+	output.append(text, copied, string::npos);
+	// keeps the line numbers of compile errors after a definition of several lines
+	if (multiline && !output.empty() && output.back() == '\n')
+		output += "#line " + std::to_string(line + 1) + " " + std::to_string(source) + "\n";
+}
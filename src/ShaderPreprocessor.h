@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdint>
+
+using namespace std;
+
+// Turns a shader asset into the source handed to the compiler. A line
+//   #include "name"
+// is replaced by that asset, named relative to the including file, and every {NAME}
+// placeholder, wherever and however often it appears, by its definition. A missing or
+// recursive include and a placeholder without a definition fail the source instead of
+// reaching the GLSL compiler as an error somewhere else. Included text is framed by
+// #line directives, a compile error at "2:40" is line 40 of files()[2].
+class Shader_Preprocessor
+{
+public:
+	void define(const string& name, const string& value);
+	void define(const string& name, int value);
+
+	// false with the reasons in errors
+	bool process(const string& name, string& output, string& errors);
+
+	// of the last output, FNV-1a, equal sources give equal hashes across runs
+	uint64_t hash() const { return outputHash; }
+	// the assets the last output was made of, by #line source number
+	const vector<string>& files() const { return sources; }
+
+	static const int Max_Include_Depth = 16;
+
+private:
+	map<string, string> definitions;
+	vector<string> sources;
+	uint64_t outputHash = 0;
+
+	bool expand(const string& name, int depth, string& output, string& errors);
+	void substitute(const string& text, int source, int line, string& output, string& errors) const;
+};
@@ -0,0 +1,171 @@
+#include "ShaderReloader.h"
+#include "GLutility.h"
+#include "FileSystem.h"
+#include <cstdio>
+#include <iostream>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+static double elapsed_ms(chrono::steady_clock::time_point since)
+{
+	return chrono::duration<double, milli>(chrono::steady_clock::now() - since).count();
+}
+
+Shader_Reloader::Shader_Reloader(GL_Utility& util)
+	: util(util), defines()
+{
+}
+
+Shader_Reloader::~Shader_Reloader()
+{
+	stop();
+}
+
+bool Shader_Reloader::start()
+{
+#ifdef __linux__
+	string path = File_System::assets().loose_path("shaders/fshader.fs");
+	if (path.empty())
+	{
+		cout << "Shader hot reload is off, the shaders are served from the pack" << endl;
+		return false;
+	}
+	string dir = path.substr(0, path.find_last_of('/'));
+
+	// editors either write the file in place or write a new one and rename it over
+	watchFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (watchFd < 0 || inotify_add_watch(watchFd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+	{
+		cout << "Shader hot reload is off, failed to watch " << dir << endl;
+		stop();
+		return false;
+	}
+
+	// never shown, only there for its context
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	context = glfwCreateWindow(1, 1, "", nullptr, util.window);
+	glfwDefaultWindowHints();
+	if (!context)
+	{
+		cout << "Shader hot reload is off, failed to create a shared context" << endl;
+		stop();
+		return false;
+	}
+
+	defines = util.shader_defines();
+	stopping = false;
+	watcher = thread(&Shader_Reloader::watch, this);
+	printf("Shader hot reload: watching %s\n", dir.c_str());
+	return true;
+#else
+	cout << "Shader hot reload needs inotify, it is off on this platform" << endl;
+	return false;
+#endif
+}
+
+void Shader_Reloader::stop()
+{
+	{
+		lock_guard<mutex> guard(lock);
+		stopping = true;
+	}
+	if (watcher.joinable())
+		watcher.join();
+
+	if (ready)
+		glDeleteProgram(ready);
+	ready = 0;
+	if (context)
+		glfwDestroyWindow(context);
+	context = nullptr;
+#ifdef __linux__
+	if (watchFd >= 0)
+		close(watchFd);
+#endif
+	watchFd = -1;
+}
+
+void Shader_Reloader::watch()
+{
+#ifdef __linux__
+	glfwMakeContextCurrent(context);
+
+	char events[4096];
+	for (;;)
+	{
+		{
+			lock_guard<mutex> guard(lock);
+			if (stopping)
+				break;
+		}
+		pollfd changed = { watchFd, POLLIN, 0 };
+		if (poll(&changed, 1, 100) <= 0)
+			continue;
+
+		// a save is often several events, wait until they stop coming
+		do
+		{
+			while (read(watchFd, events, sizeof(events)) > 0)
+				;
+			this_thread::sleep_for(chrono::milliseconds(Settle_Ms));
+		} while (poll(&changed, 1, 0) > 0);
+
+		build();
+	}
+
+	glfwMakeContextCurrent(nullptr);
+#endif
+}
+
+// watcher thread, on the hidden context
+void Shader_Reloader::build()
+{
+	auto start = chrono::steady_clock::now();
+
+	string vertex, fragment, log;
+	uint64_t hash;
+	GLuint program = 0;
+	if (GL_Utility::shader_sources(defines, vertex, fragment, hash, log))
+		program = Shader::build(vertex.c_str(), fragment.c_str(), log);
+	// the program has to be complete before the main context may use it
+	glFinish();
+
+	lock_guard<mutex> guard(lock);
+	errors = log;
+	if (program)
+	{
+		// a newer build replaces one that was not swapped in yet
+		if (ready)
+			glDeleteProgram(ready);
+		ready = program;
+		buildMs = elapsed_ms(start);
+	}
+}
+
+void Shader_Reloader::update()
+{
+	GLuint program;
+	string log;
+	double ms;
+	{
+		lock_guard<mutex> guard(lock);
+		program = ready;
+		ready = 0;
+		log.swap(errors);
+		ms = buildMs;
+	}
+
+	if (!log.empty())
+		cout << "Shader reload failed, the running program stays\n" << log << endl;
+	if (program)
+	{
+		util.swap_program(program);
+		printf("Shader reloaded, built in %.1f ms\n", ms);
+	}
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include "scene.h"
+
+using namespace std;
+
+class GL_Utility;
+
+// Recompiles the shaders when a file in their loose directory changes. A watcher thread
+// waits on inotify, lets a burst of writes settle, then builds the program from
+// GL_Utility::shader_sources on a hidden window's context shared with the main one.
+// update() swaps a successfully linked program in at the start of a frame, a failed
+// build only prints its log and the running program stays. Linux only, and only
+// when the shaders are loose files rather than served from the pack.
+class Shader_Reloader
+{
+public:
+	explicit Shader_Reloader(GL_Utility& util);
+	~Shader_Reloader();
+
+	Shader_Reloader(const Shader_Reloader&) = delete;
+	Shader_Reloader& operator=(const Shader_Reloader&) = delete;
+
+	// main thread, after create_shaders, false if there is nothing to watch
+	bool start();
+	// main thread, before GLFW is terminated
+	void stop();
+	// main thread, once per frame before anything is drawn
+	void update();
+
+	static const int Settle_Ms = 50;
+
+private:
+	GL_Utility& util;
+	raytDefines defines; // the placeholders of the running program, copied for the watcher
+	GLFWwindow* context = nullptr;
+	int watchFd = -1;
+	thread watcher;
+
+	mutex lock;
+	bool stopping = false;
+	GLuint ready = 0; // linked, not swapped in yet
+	string errors; // of the last failed build, not printed yet
+	double buildMs = 0;
+
+	void watch();
+	void build();
+};
@@ -0,0 +1,447 @@
+#include "Simulation.h"
+#include "FramePacer.h"
+#include "utils.h"
+#include <chrono>
+#include <cstdio>
+#include <algorithm>
+#include <glm/gtc/quaternion.hpp>
+
+using namespace std;
+
+void cameraState::look(double xpos, double ypos)
+{
+	if (firstMouse)
+	{
+		lastX = xpos;
+		lastY = ypos;
+		firstMouse = false;
+	}
+
+	float xoffset = xpos - lastX;
+	float yoffset = lastY - ypos;
+	lastX = xpos;
+	lastY = ypos;
+
+	float sensitivity = 0.002f;
+	xoffset *= sensitivity;
+	yoffset *= sensitivity;
+
+	yaw += xoffset;
+	pitch += yoffset;
+
+	if (pitch > 89.0f)
+		pitch = 89.0f;
+	if (pitch < -89.0f)
+		pitch = -89.0f;
+}
+
+glm::quat cameraState::rotation() const
+{
+	return glm::quat(glm::vec3(glm::radians(-pitch), glm::radians(yaw), 0));
+}
+
+Simulation::Simulation(sceneContainer& scene, double stepsPerSecond)
+	: scene(scene), stepSeconds(1 / stepsPerSecond)
+{
+	position = scene.scene.camera_pos;
+}
+
+Simulation::~Simulation()
+{
+	stop();
+}
+
+void Simulation::add_update(function<void(sceneContainer& scene, float deltaTime, float time)> update)
+{
+	updates.push_back(move(update));
+}
+
+void Simulation::init_input(GLFWwindow* window)
+{
+	glfwSetWindowUserPointer(window, this);
+
+	auto keyFunc = [](GLFWwindow* w, int key, int scancode, int action, int mods)
+	{
+		if (key == GLFW_KEY_ESCAPE && (action == GLFW_PRESS || action == GLFW_RELEASE))
+			glfwSetWindowShouldClose(w, GL_TRUE);
+		static_cast<Simulation*>(glfwGetWindowUserPointer(w))->push_input({ inputEvent::KEY, key, action, 0, 0, Frame_Pacer::now() });
+	};
+	auto mouseFunc = [](GLFWwindow* w, double x, double y)
+	{
+		static_cast<Simulation*>(glfwGetWindowUserPointer(w))->push_input({ inputEvent::CURSOR, 0, 0, x, y, Frame_Pacer::now() });
+	};
+
+	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+	glfwSetCursorPosCallback(window, mouseFunc);
+	glfwSetKeyCallback(window, keyFunc);
+}
+
+bool Simulation::record(const char* path)
+{
+	if (!log.open_write(path))
+		return false;
+	replaying = false;
+	printf("Recording input to %s\n", path);
+	return true;
+}
+
+bool Simulation::replay(const char* path)
+{
+	if (!log.open_read(path))
+		return false;
+	replaying = true;
+	printf("Replaying input from %s, live input is ignored\n", path);
+	return true;
+}
+
+void Simulation::start()
+{
+	publish();
+	stopping = false;
+	worker = thread(&Simulation::run, this);
+}
+
+void Simulation::stop()
+{
+	stopping = true;
+	if (worker.joinable())
+		worker.join();
+	if (droppedInput > 0)
+		printf("Simulation: %u input events dropped, the queue was full\n", droppedInput.load());
+	droppedInput = 0;
+	if (log.is_open())
+		printf("Input log: %s %llu steps, camera path %016llx\n", replaying ? "replayed" : "recorded",
+			static_cast<unsigned long long>(log.steps()), static_cast<unsigned long long>(cameraPath));
+	log.close();
+}
+
+void Simulation::run()
+{
+	if (replaying)
+	{
+		run_replay();
+		return;
+	}
+
+	double last = glfwGetTime();
+	double next = last;
+	while (!stopping)
+	{
+		double now = glfwGetTime();
+		if (now < next)
+		{
+			this_thread::sleep_for(chrono::duration<double>(min(next - now, 1e-3)));
+			continue;
+		}
+		// a late step is not caught up on, deltaTime covers the time since the last one
+		next = now + stepSeconds;
+		float deltaTime = static_cast<float>(now - last);
+		last = now;
+
+		stepEvents.clear();
+		inputEvent event;
+		while (input.pop(event))
+		{
+			apply_input(event);
+			applied++;
+			if (log.writing())
+				stepEvents.push_back(event);
+		}
+		log.write_step(now, deltaTime, stepEvents);
+		advance(deltaTime, now);
+	}
+}
+
+// the recorded steps, the next one only once the render thread acquired the last
+void Simulation::run_replay()
+{
+	double time;
+	float deltaTime;
+	while (!stopping)
+	{
+		if (consumedStep.load(memory_order_acquire) < step)
+		{
+			this_thread::sleep_for(chrono::microseconds(200));
+			continue;
+		}
+		if (!log.read_step(time, deltaTime, stepEvents))
+			break;
+		for (const inputEvent& event : stepEvents)
+			apply_input(event);
+		advance(deltaTime, time);
+	}
+	replayEnded = true;
+}
+
+void Simulation::advance(float deltaTime, double time)
+{
+	update_camera(deltaTime);
+	cameraPath = hash_bytes(&scene.scene.camera_pos, sizeof(scene.scene.camera_pos), cameraPath);
+	cameraPath = hash_bytes(&scene.scene.quat_camera_rotation, sizeof(scene.scene.quat_camera_rotation), cameraPath);
+	for (auto& update : updates)
+		update(scene, deltaTime, static_cast<float>(time));
+	publish();
+}
+
+// the ranges of bit patched by the steps in (after, upTo], false if the log does not reach back
+static bool gather_patches(const scenePatches* log, uint64_t after, uint64_t upTo, int bit, sceneRangeList& ranges)
+{
+	ranges.clear();
+	if (upTo - after > static_cast<uint64_t>(sceneSnapshot::Patch_History))
+		return false;
+	for (uint64_t s = after + 1; s <= upTo; s++)
+	{
+		const scenePatches& entry = log[s % sceneSnapshot::Patch_History];
+		if (entry.step != s)
+			return false;
+		if (entry.patched & (1u << bit))
+			ranges.add(entry.ranges[bit]);
+	}
+	return true;
+}
+
+// to takes from's length and the elements in ranges
+template<typename T>
+static void copy_ranges(vector<T>& to, const vector<T>& from, const sceneRangeList& ranges)
+{
+	to.resize(from.size());
+	for (const sceneRange& range : ranges)
+	{
+		size_t end = min(static_cast<size_t>(range.end), from.size());
+		if (range.first < end)
+			copy(from.begin() + range.first, from.begin() + end, to.begin() + range.first);
+	}
+}
+
+// copies what the back slot is missing, the parts changed since the slot was last written
+void Simulation::publish()
+{
+	step++;
+	scenePatches& logged = patchLog[step % sceneSnapshot::Patch_History];
+	logged.step = step;
+	logged.patched = scene.patched;
+	for (int bit = 0; bit < 8; bit++)
+	{
+		if (scene.dirty & (1u << bit))
+			changed[bit] = step;
+		if (scene.patched & (1u << bit))
+			patchedStep[bit] = step;
+		logged.ranges[bit] = scene.patches[bit];
+	}
+	scene.dirty = 0;
+	scene.clear_patches();
+
+	sceneSnapshot& snapshot = snapshots.back();
+	sceneContainer& copy = snapshot.scene;
+	unsigned stale = 0;
+	for (int bit = 0; bit < 8; bit++)
+		if (changed[bit] > snapshot.step)
+			stale |= 1u << bit;
+	if (snapshot.step == 0)
+	{
+		// loaded once, never changed by an update
+		copy.mesh_data = scene.mesh_data;
+		copy.textures = scene.textures;
+		copy.sphere_capacity = scene.sphere_capacity;
+		copy.box_capacity = scene.box_capacity;
+		copy.mesh_instance_capacity = scene.mesh_instance_capacity;
+		copy.reserve_capacity();
+		stale = DIRTY_ALL;
+	}
+	// the arrays that can be copied in part, the others are copied whole when patched
+	const unsigned ranged = DIRTY_SPHERES | DIRTY_SURFACES | DIRTY_BOXES | DIRTY_MESH_INSTANCES;
+	unsigned patched = 0;
+	sceneRangeList ranges[8];
+	for (int bit = 0; bit < 8; bit++)
+	{
+		unsigned flag = 1u << bit;
+		if ((stale & flag) || patchedStep[bit] <= snapshot.step)
+			continue;
+		if ((ranged & flag) && gather_patches(patchLog, snapshot.step, step, bit, ranges[bit]))
+			patched |= flag;
+		else
+			stale |= flag;
+	}
+
+	copy.scene = scene.scene;
+	copy.ambient_color = scene.ambient_color;
+	copy.shadow_ambient = scene.shadow_ambient;
+	if (stale & DIRTY_SPHERES)
+		copy.spheres = scene.spheres;
+	else if (patched & DIRTY_SPHERES)
+		copy_ranges(copy.spheres, scene.spheres, ranges[dirty_bit(DIRTY_SPHERES)]);
+	if (stale & DIRTY_SURFACES)
+		copy.surfaces = scene.surfaces;
+	else if (patched & DIRTY_SURFACES)
+		copy_ranges(copy.surfaces, scene.surfaces, ranges[dirty_bit(DIRTY_SURFACES)]);
+	if (stale & DIRTY_BOXES)
+		copy.boxes = scene.boxes;
+	else if (patched & DIRTY_BOXES)
+		copy_ranges(copy.boxes, scene.boxes, ranges[dirty_bit(DIRTY_BOXES)]);
+	if (stale & DIRTY_MESH_INSTANCES)
+		copy.mesh_instances = scene.mesh_instances;
+	else if (patched & DIRTY_MESH_INSTANCES)
+		copy_ranges(copy.mesh_instances, scene.mesh_instances, ranges[dirty_bit(DIRTY_MESH_INSTANCES)]);
+	if (stale & DIRTY_MATERIALS)
+	{
+		copy.materials = scene.materials;
+		copy.material_lookup = scene.material_lookup;
+	}
+	if (stale & DIRTY_LIGHTS)
+	{
+		copy.lights_point = scene.lights_point;
+		copy.lights_direct = scene.lights_direct;
+	}
+	copy.dirty = 0;
+
+	snapshot.step = step;
+	copy_n(changed, 8, snapshot.changed);
+	copy_n(patchedStep, 8, snapshot.patched_step);
+	copy_n(patchLog, sceneSnapshot::Patch_History, snapshot.patch_log);
+	snapshot.camera = camera;
+	snapshot.inputs_applied = applied;
+	snapshots.publish();
+}
+
+sceneSnapshot& Simulation::acquire(unsigned& dirty)
+{
+	// a replay draws every step, it waits for the next one rather than drawing one twice
+	bool fresh;
+	while (!(fresh = snapshots.acquire()) && replaying && !replayEnded)
+		this_thread::sleep_for(chrono::microseconds(200));
+	// the log only ends once its last step was acquired, by an earlier call or this one
+	replayDrained = replaying && !fresh && replayEnded;
+	sceneSnapshot& snapshot = snapshots.front();
+
+	// snapshots published in between were skipped, what they changed is changed here too,
+	// what they patched is patched here
+	dirty = 0;
+	snapshot.scene.clear_patches();
+	for (int bit = 0; bit < 8; bit++)
+	{
+		if (snapshot.changed[bit] > acquiredStep)
+			dirty |= 1u << bit;
+		else if (snapshot.patched_step[bit] <= acquiredStep)
+			continue;
+		else if (gather_patches(snapshot.patch_log, acquiredStep, snapshot.step, bit, snapshot.scene.patches[bit]))
+			snapshot.scene.patched |= 1u << bit;
+		else
+			dirty |= 1u << bit;
+	}
+	acquiredStep = snapshot.step;
+	consumedStep.store(acquiredStep, memory_order_release);
+	snapshot.inputs_latched = 0;
+	return snapshot;
+}
+
+void Simulation::latch_input(sceneSnapshot& snapshot)
+{
+	// older events may be overwritten, they were long taken in by the simulation
+	uint64_t first = max(snapshot.inputs_applied, pushed > Input_Capacity ? pushed - Input_Capacity : 0);
+	cameraState latched = snapshot.camera;
+	for (uint64_t i = first; i < pushed; i++)
+	{
+		const inputEvent& event = history[i % Input_Capacity];
+		if (event.type == inputEvent::CURSOR)
+			latched.look(event.x, event.y);
+	}
+	snapshot.scene.scene.quat_camera_rotation = latched.rotation();
+	snapshot.inputs_latched = pushed;
+}
+
+double Simulation::take_shown_input(const sceneSnapshot& snapshot)
+{
+	double oldest = -1;
+	uint64_t first = max(shownUpTo, pushed > Input_Capacity ? pushed - Input_Capacity : 0);
+	for (uint64_t i = first; i < pushed; i++)
+	{
+		const inputEvent& event = history[i % Input_Capacity];
+		bool visible = i < snapshot.inputs_applied || (i < snapshot.inputs_latched && event.type == inputEvent::CURSOR);
+		if (shown[i % Input_Capacity] || !visible)
+			continue;
+		shown[i % Input_Capacity] = true;
+		if (oldest < 0 || event.time < oldest)
+			oldest = event.time;
+	}
+	shownUpTo = first;
+	while (shownUpTo < pushed && shown[shownUpTo % Input_Capacity])
+		shownUpTo++;
+	return oldest;
+}
+
+// main thread
+void Simulation::push_input(const inputEvent& event)
+{
+	if (replaying)
+		return;
+	if (!input.push(event))
+	{
+		droppedInput++;
+		return;
+	}
+	history[pushed % Input_Capacity] = event;
+	shown[pushed % Input_Capacity] = false;
+	pushed++;
+}
+
+void Simulation::apply_input(const inputEvent& event)
+{
+	if (event.type == inputEvent::CURSOR)
+	{
+		camera.look(event.x, event.y);
+		return;
+	}
+
+	if (event.action != GLFW_PRESS && event.action != GLFW_RELEASE)
+		return;
+	bool pressed = event.action == GLFW_PRESS;
+
+	if (event.key == GLFW_KEY_W)
+		w_pressed = pressed;
+	else if (event.key == GLFW_KEY_A)
+		a_pressed = pressed;
+	else if (event.key == GLFW_KEY_S)
+		s_pressed = pressed;
+	else if (event.key == GLFW_KEY_D)
+		d_pressed = pressed;
+	else if (event.key == GLFW_KEY_SPACE)
+		space_pressed = pressed;
+	else if (event.key == GLFW_KEY_LEFT_CONTROL)
+		ctrl_pressed = pressed;
+	else if (event.key == GLFW_KEY_LEFT_SHIFT)
+		shift_pressed = pressed;
+	else if (event.key == GLFW_KEY_LEFT_ALT)
+		alt_pressed = pressed;
+}
+
+void Simulation::update_camera(float deltaTime)
+{
+	float yaw = camera.yaw, pitch = camera.pitch;
+	front.x = sin(glm::radians(yaw)) * cos(glm::radians(pitch));
+	front.y = sin(glm::radians(pitch));
+	front.z = cos(glm::radians(yaw)) * cos(glm::radians(pitch));
+	front = glm::normalize(front);
+	right = glm::normalize(glm::cross(-front, world_up));
+	scene.scene.quat_camera_rotation = camera.rotation();
+
+	auto speed = deltaTime * 3;
+	if (shift_pressed)
+		speed *= 3;
+	if (alt_pressed)
+		speed /= 3;
+
+	if (w_pressed)
+		position += front * speed;
+	if (a_pressed)
+		position -= right * speed;
+	if (s_pressed)
+		position -= front * speed;
+	if (d_pressed)
+		position += right * speed;
+	if (space_pressed)
+		position += world_up * speed;
+	if (ctrl_pressed)
+		position -= world_up * speed;
+
+	scene.scene.camera_pos = position;
+}
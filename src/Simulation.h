@@ -0,0 +1,161 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include "scene.h"
+#include "TripleBuffer.h"
+#include "SpscQueue.h"
+#include "InputLog.h"
+
+using namespace std;
+
+// mouse look, the yaw and pitch the cursor movement adds up to
+struct cameraState
+{
+	bool firstMouse = true;
+	float lastX = 0;
+	float lastY = 0;
+	float yaw = 0;
+	float pitch = 0;
+
+	void look(double xpos, double ypos);
+	glm::quat rotation() const;
+};
+
+// the parts of the arrays one simulation step patched, see sceneContainer::patch
+struct scenePatches
+{
+	uint64_t step = 0;
+	unsigned patched = 0;
+	sceneRangeList ranges[8];
+};
+
+// a copy of the scene as it was after one simulation step
+struct sceneSnapshot
+{
+	static const int Patch_History = 16;
+
+	sceneContainer scene; // dirty is not used, see changed
+	uint64_t step = 0; // 0 until the slot is first written
+	uint64_t changed[8] = {}; // per DIRTY_ bit, the step that last changed that part
+	uint64_t patched_step[8] = {}; // per DIRTY_ bit, the step that last patched that part
+	scenePatches patch_log[Patch_History]; // the last steps, step s at s % Patch_History
+	cameraState camera;
+	uint64_t inputs_applied = 0; // input events the step had taken in
+	uint64_t inputs_latched = 0; // render thread, cursor events latch_input added on top
+};
+
+// Runs the scene updates and the camera controls on a thread of their own, so their cost
+// overlaps the GPU drawing the previous frame. Every step publishes a sceneSnapshot
+// through a Triple_Buffer and the render thread picks up the newest one at the start of
+// its frame. A snapshot slot is reused, only the parts that changed since it was last
+// written are copied into it, of arrays that were only patched just the patched ranges.
+// The render thread likewise uploads only the ranges patched by the steps since the
+// snapshot it drew before, as long as those are within the last Patch_History steps. Input is recorded by the GLFW callbacks on the main thread
+// and applied by the simulation thread at its next step, cursor movement can also be
+// latched into the snapshot on the render thread right before it is drawn.
+//
+// The input every step took in can be recorded to an .rinp log with the step's time and
+// deltaTime. Replaying a log runs the recorded steps instead of the clock's, in
+// lockstep with the render thread, one step per frame, and ignores live input, so the
+// same scene replayed from the same log draws the same camera path on every run. Both
+// print a hash of the camera path at stop() to compare runs by.
+class Simulation
+{
+public:
+	// the scene is the simulation thread's between start() and stop()
+	explicit Simulation(sceneContainer& scene, double stepsPerSecond = 240);
+	~Simulation();
+
+	Simulation(const Simulation&) = delete;
+	Simulation& operator=(const Simulation&) = delete;
+
+	// run every step on the simulation thread in the order added, before start()
+	void add_update(function<void(sceneContainer& scene, float deltaTime, float time)> update);
+	// main thread, points the window's key and cursor callbacks at this
+	void init_input(GLFWwindow* window);
+	// before start(), false if the log could not be opened, then nothing is recorded
+	bool record(const char* path);
+	// before start(), false if the log could not be opened, then the clock drives the steps
+	bool replay(const char* path);
+	// publishes the loaded scene as the first snapshot and starts the thread
+	void start();
+	void stop();
+	// render thread, the replayed log ran out and the last acquire() found no step after
+	// the ones already returned, so every replayed step was drawn
+	bool finished() const { return replayDrained; }
+
+	// render thread, the newest snapshot, dirty gets the DIRTY_ bits that changed since the
+	// one returned before, all of them the first time
+	sceneSnapshot& acquire(unsigned& dirty);
+	// render thread, turns the snapshot's camera by the cursor movement the simulation
+	// has not taken in yet, call after glfwPollEvents
+	void latch_input(sceneSnapshot& snapshot);
+	// render thread, after the snapshot was presented, the time stamp of the oldest input
+	// event that first became visible in it, negative if there was none
+	double take_shown_input(const sceneSnapshot& snapshot);
+
+	static const size_t Input_Capacity = 1024;
+
+private:
+	sceneContainer& scene;
+	double stepSeconds;
+	vector<function<void(sceneContainer&, float, float)>> updates;
+
+	thread worker;
+	atomic<bool> stopping{ false };
+	Triple_Buffer<sceneSnapshot> snapshots;
+	Spsc_Queue<inputEvent, Input_Capacity> input;
+	atomic<unsigned> droppedInput{ 0 };
+	Input_Log log;
+	bool replaying = false;
+	atomic<bool> replayEnded{ false };
+	atomic<uint64_t> consumedStep{ 0 }; // the step the render thread acquired last
+
+	// simulation thread
+	uint64_t step = 0;
+	uint64_t changed[8] = {};
+	uint64_t patchedStep[8] = {};
+	scenePatches patchLog[sceneSnapshot::Patch_History];
+	uint64_t applied = 0;
+	vector<inputEvent> stepEvents;
+	uint64_t cameraPath = 0; // hash of the camera after every step
+
+	// render thread, which is also the main thread the callbacks run on
+	uint64_t acquiredStep = 0;
+	bool replayDrained = false;
+	inputEvent history[Input_Capacity]; // event i at i % Input_Capacity
+	bool shown[Input_Capacity] = {};
+	uint64_t pushed = 0;
+	uint64_t shownUpTo = 0; // every event before was shown
+
+	// camera controls, simulation thread
+	bool w_pressed = false;
+	bool a_pressed = false;
+	bool s_pressed = false;
+	bool d_pressed = false;
+	bool ctrl_pressed = false;
+	bool shift_pressed = false;
+	bool space_pressed = false;
+	bool alt_pressed = false;
+
+	cameraState camera;
+	glm::vec3 position;
+	glm::vec3 front;
+	glm::vec3 right;
+	glm::vec3 world_up = glm::vec3(0, 1, 0);
+
+	void run();
+	void run_replay();
+	void advance(float deltaTime, double time);
+	void publish();
+	void apply_input(const inputEvent& event);
+	void update_camera(float deltaTime);
+	void push_input(const inputEvent& event);
+};
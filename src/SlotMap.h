@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+// Stable handles for the objects of one packed array. An object is removed by moving the
+// last one into its place, so the array stays dense for the uploads and the shader loops
+// and only that one element changes; the map follows every object's index through these
+// moves. A handle is a slot plus the generation the slot had when the object was added.
+// Slots of removed objects go on a free list and are handed out again with the
+// generation bumped, so handles to the removed object stop resolving. Adding, removing
+// and looking up are O(1).
+class Slot_Map
+{
+public:
+	static const uint32_t None = ~0u;
+
+	// index of the handle's object in the array, -1 once it was removed
+	int find(int slot, uint32_t generation) const
+	{
+		if (slot < 0 || slot >= static_cast<int>(slotIndex.size()) || slotGeneration[slot] != generation)
+			return -1;
+		return static_cast<int>(slotIndex[slot]);
+	}
+
+	int slot_of(size_t index) const { return static_cast<int>(indexSlot[index]); }
+	uint32_t generation_of(int slot) const { return slotGeneration[slot]; }
+	size_t size() const { return indexSlot.size(); }
+
+	// a slot for the object just appended to the array
+	int add()
+	{
+		uint32_t slot = freeHead;
+		if (slot != None)
+			freeHead = slotIndex[slot];
+		else
+		{
+			slot = static_cast<uint32_t>(slotIndex.size());
+			slotIndex.push_back(0);
+			slotGeneration.push_back(0);
+		}
+		slotIndex[slot] = static_cast<uint32_t>(indexSlot.size());
+		indexSlot.push_back(slot);
+		return static_cast<int>(slot);
+	}
+
+	// frees the handle's slot; index is where its object was, the caller moves the object
+	// at last there and drops the last element. False for a handle that does not resolve
+	bool remove(int slot, uint32_t generation, size_t& index, size_t& last)
+	{
+		int found = find(slot, generation);
+		if (found < 0)
+			return false;
+		index = static_cast<size_t>(found);
+		last = indexSlot.size() - 1;
+		uint32_t moved = indexSlot[last];
+		slotIndex[moved] = static_cast<uint32_t>(index);
+		indexSlot[index] = moved;
+		indexSlot.pop_back();
+
+		slotGeneration[slot]++;
+		slotIndex[slot] = freeHead;
+		freeHead = static_cast<uint32_t>(slot);
+		return true;
+	}
+
+	// slots for objects appended to the array without add(), an array that got shorter
+	// behind the map's back was replaced and starts over with new handles
+	void sync(size_t count)
+	{
+		if (count < indexSlot.size())
+			*this = Slot_Map();
+		while (indexSlot.size() < count)
+			add();
+	}
+
+private:
+	vector<uint32_t> slotIndex; // per slot: its object's index, or the next free slot
+	vector<uint32_t> slotGeneration;
+	vector<uint32_t> indexSlot; // per object: its slot
+	uint32_t freeHead = None;
+};
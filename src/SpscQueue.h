@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+using namespace std;
+
+// Fixed size ring of values from one producer thread to one consumer thread, without
+// locks. Capacity is a power of two, push() fails instead of waiting when it is full.
+template<typename T, size_t Capacity>
+class Spsc_Queue
+{
+	static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+	// producer
+	bool push(const T& value)
+	{
+		size_t tail = tailIndex.load(memory_order_relaxed);
+		if (tail - headIndex.load(memory_order_acquire) == Capacity)
+			return false;
+		items[tail & (Capacity - 1)] = value;
+		tailIndex.store(tail + 1, memory_order_release);
+		return true;
+	}
+
+	// consumer
+	bool pop(T& value)
+	{
+		size_t head = headIndex.load(memory_order_relaxed);
+		if (head == tailIndex.load(memory_order_acquire))
+			return false;
+		value = items[head & (Capacity - 1)];
+		headIndex.store(head + 1, memory_order_release);
+		return true;
+	}
+
+private:
+	T items[Capacity];
+	// apart, the two threads write one each
+	alignas(64) atomic<size_t> headIndex{ 0 };
+	alignas(64) atomic<size_t> tailIndex{ 0 };
+};
@@ -3,23 +3,23 @@
 
 class Surfaces {
 public:
-    static raytSurface Elliptic_Cylinder(float a, float b, raytMaterial material)
+    static raytSurface Elliptic_Cylinder(float a, float b, int material)
 	{
 		raytSurface surface = {};
 		surface.a = powf(a, -2);
 		surface.b = powf(b, -2);
 		surface.f = -1;
-		surface.mat = material;
+		surface.material = material;
 		return surface;
 	} 
 
-	static raytSurface Elliptic_Cone(float a, float b, float c, raytMaterial material)
+	static raytSurface Elliptic_Cone(float a, float b, float c, int material)
 	{
 		raytSurface surface = {};
 		surface.a = powf(a, -2);
 		surface.b = powf(b, -2);
 		surface.c = -powf(c, -2);
-		surface.mat = material;
+		surface.material = material;
 		return surface;
 	}
 };
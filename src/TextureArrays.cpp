@@ -0,0 +1,133 @@
+#include "TextureArrays.h"
+#include "TextureFile.h"
+#include <algorithm>
+
+using namespace std;
+
+size_t Texture_Arrays::level_bytes(const Array& a, int level)
+{
+	return rtex_level_size(a.compressed ? RTEX_BC1 : RTEX_RGBA8, max(1, a.width >> level), max(1, a.height >> level));
+}
+
+raytTextureSlot Texture_Arrays::allocate(int width, int height, int levels, GLenum internalFormat, bool compressed)
+{
+	GLint maxLayers = 256;
+	glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+
+	for (size_t i = 0; i < arrays.size(); i++)
+	{
+		Array& a = arrays[i];
+		if (a.width != width || a.height != height || a.levels != levels || a.internalFormat != internalFormat)
+			continue;
+		if (a.layers == a.capacity)
+		{
+			if (a.capacity >= maxLayers)
+				continue;
+			grow(static_cast<int>(i));
+		}
+		return { static_cast<int>(i), arrays[i].layers++ };
+	}
+
+	if (arrays.size() == Max_Arrays)
+		return { -1, -1 };
+
+	Array a = { 0, width, height, levels, internalFormat, compressed, 0, 1 };
+	create(a);
+	arrays.push_back(a);
+	bind(static_cast<int>(arrays.size()) - 1);
+	return { static_cast<int>(arrays.size()) - 1, arrays.back().layers++ };
+}
+
+// storage for every level of capacity layers, contents undefined
+void Texture_Arrays::create(Array& a)
+{
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glGenTextures(1, &a.tex);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, a.tex);
+	for (int level = 0; level < a.levels; level++)
+	{
+		int w = max(1, a.width >> level), h = max(1, a.height >> level);
+		if (a.compressed)
+			glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, a.internalFormat, w, h, a.capacity, 0,
+				static_cast<GLsizei>(level_bytes(a, level) * a.capacity), nullptr);
+		else
+			glTexImage3D(GL_TEXTURE_2D_ARRAY, level, a.internalFormat, w, h, a.capacity, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	}
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, a.levels - 1);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+// twice the layers, the old ones are copied over on the GPU through a pixel buffer
+void Texture_Arrays::grow(int index)
+{
+	Array old = arrays[index];
+	Array& a = arrays[index];
+	GLint maxLayers = 256;
+	glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+	a.capacity = min(a.capacity * 2, static_cast<int>(maxLayers));
+	create(a);
+
+	GLuint copy;
+	glGenBuffers(1, &copy);
+	for (int level = 0; level < a.levels; level++)
+	{
+		int w = max(1, a.width >> level), h = max(1, a.height >> level);
+		size_t bytes = level_bytes(a, level) * old.capacity;
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, copy);
+		glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_COPY);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, old.tex);
+		if (a.compressed)
+			glGetCompressedTexImage(GL_TEXTURE_2D_ARRAY, level, nullptr);
+		else
+			glGetTexImage(GL_TEXTURE_2D_ARRAY, level, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, copy);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, a.tex);
+		if (a.compressed)
+			glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, 0, w, h, old.capacity, a.internalFormat, static_cast<GLsizei>(bytes), nullptr);
+		else
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, 0, w, h, old.capacity, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	glDeleteBuffers(1, &copy);
+	glDeleteTextures(1, &old.tex);
+	bind(index);
+}
+
+void Texture_Arrays::bind(int index) const
+{
+	glActiveTexture(GL_TEXTURE0 + First_Unit + index);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, arrays[index].tex);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+// rows of one level of one layer, data is an offset into the bound unpack buffer
+// compressed rows have to start on a block boundary
+void Texture_Arrays::upload_rows(raytTextureSlot slot, int level, int row, int rows, size_t size, const void* data)
+{
+	const Array& a = arrays[slot.array];
+	int w = max(1, a.width >> level);
+	glActiveTexture(GL_TEXTURE0 + First_Unit + slot.array);
+	if (a.compressed)
+		glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, row, slot.layer, w, rows, 1, a.internalFormat, static_cast<GLsizei>(size), data);
+	else
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, row, slot.layer, w, rows, 1, GL_RGBA, GL_UNSIGNED_BYTE, data);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+size_t Texture_Arrays::memory_bytes() const
+{
+	size_t bytes = 0;
+	for (const Array& a : arrays)
+		for (int level = 0; level < a.levels; level++)
+			bytes += level_bytes(a, level) * a.capacity;
+	return bytes;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <vector>
+
+using namespace std;
+
+struct raytTextureSlot
+{
+	int array; // -1 if no layer could be found
+	int layer;
+};
+
+// Residency for every texture in the scene: textures of the same size and format
+// share one GL_TEXTURE_2D_ARRAY, each texture is a layer. Arrays stay bound to
+// fixed units and only get rebound when they are created or grow, so the frame
+// loop has no bind calls.
+class Texture_Arrays
+{
+public:
+	// texture_array_N samplers in the fragment shader, units 8-14, unit 15 is the virtual texture's
+	static const int Max_Arrays = 7;
+	static const int First_Unit = 8;
+
+	// reserves a layer, creating or growing the array for this size and format
+	raytTextureSlot allocate(int width, int height, int levels, GLenum internalFormat, bool compressed);
+	void upload_rows(raytTextureSlot slot, int level, int row, int rows, size_t size, const void* data);
+
+	size_t memory_bytes() const;
+
+private:
+	struct Array
+	{
+		GLuint tex;
+		int width, height, levels;
+		GLenum internalFormat;
+		bool compressed;
+		int layers;
+		int capacity;
+	};
+
+	vector<Array> arrays;
+
+	static size_t level_bytes(const Array& a, int level);
+	void create(Array& a);
+	void grow(int index);
+	void bind(int index) const;
+};
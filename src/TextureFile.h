@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+// .rtex, a cooked texture with its full mip chain ready for upload:
+// rtexHeader, rtexLevel[levels], then the level data, largest level first,
+// each level 16 byte aligned. Written by the cook tool, read by Texture_Loader.
+
+#define RTEX_MAGIC 0x58455452 // "RTEX"
+#define RTEX_VERSION 1
+
+enum rtexFormat { RTEX_RGBA8 = 0, RTEX_BC1 = 1 };
+
+struct rtexHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t format;
+	uint32_t width;
+	uint32_t height;
+	uint32_t levels;
+	uint32_t _p1, _p2;
+};
+
+struct rtexLevel
+{
+	uint64_t offset; // from the start of the file
+	uint64_t size;
+	uint32_t width;
+	uint32_t height;
+	uint32_t _p1, _p2;
+};
+
+inline size_t rtex_level_size(uint32_t format, uint32_t width, uint32_t height)
+{
+	if (format == RTEX_BC1)
+		return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * 8;
+	return static_cast<size_t>(width) * height * 4;
+}
+
+// level table of a mapped .rtex file, nullptr if the file is malformed
+inline const rtexLevel* rtex_levels(const unsigned char* data, size_t size)
+{
+	if (size < sizeof(rtexHeader))
+		return nullptr;
+	const rtexHeader* header = reinterpret_cast<const rtexHeader*>(data);
+	if (header->magic != RTEX_MAGIC || header->version != RTEX_VERSION || header->format > RTEX_BC1 ||
+		header->levels == 0 || header->levels > 32 || size < sizeof(rtexHeader) + header->levels * sizeof(rtexLevel))
+		return nullptr;
+
+	const rtexLevel* levels = reinterpret_cast<const rtexLevel*>(data + sizeof(rtexHeader));
+	for (uint32_t i = 0; i < header->levels; i++)
+		if (levels[i].offset > size || levels[i].size > size - levels[i].offset ||
+			levels[i].size != rtex_level_size(header->format, levels[i].width, levels[i].height))
+			return nullptr;
+	return levels;
+}
+
+// next mip level of an rgba8 image with a 2x2 box filter, odd sizes repeat their last row / column
+inline void rtex_downsample(const unsigned char* src, int width, int height, unsigned char* dst)
+{
+	int dw = std::max(1, width / 2), dh = std::max(1, height / 2);
+	for (int y = 0; y < dh; y++)
+		for (int x = 0; x < dw; x++)
+		{
+			int x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+			int y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+			for (int c = 0; c < 4; c++)
+			{
+				int sum = src[(y0 * width + x0) * 4 + c] + src[(y0 * width + x1) * 4 + c] +
+					src[(y1 * width + x0) * 4 + c] + src[(y1 * width + x1) * 4 + c];
+				dst[(y * dw + x) * 4 + c] = static_cast<unsigned char>((sum + 2) / 4);
+			}
+		}
+}
+
+// .rvt, a virtual texture cut into tiles for streaming:
+// rvtHeader, rvtLevel[levels], then per level tilesX * tilesY tiles in row order.
+// Each tile is (tile + 2 * border)^2 rgba8 texels, the border repeats the
+// neighbouring texels (wrapping at the image edges) so bilinear filtering
+// inside the cache never reads another tile.
+
+#define RVT_MAGIC 0x31545652 // "RVT1"
+#define RVT_VERSION 1
+
+struct rvtHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t width;
+	uint32_t height;
+	uint32_t levels;
+	uint32_t tile;
+	uint32_t border;
+	uint32_t _p1;
+};
+
+struct rvtLevel
+{
+	uint64_t offset; // of the first tile
+	uint32_t width;
+	uint32_t height;
+	uint32_t tilesX;
+	uint32_t tilesY;
+	uint32_t _p1, _p2;
+};
+
+inline size_t rvt_tile_bytes(const rvtHeader& header)
+{
+	size_t page = header.tile + 2 * header.border;
+	return page * page * 4;
+}
+
+inline bool rvt_header_valid(const rvtHeader& header)
+{
+	return header.magic == RVT_MAGIC && header.version == RVT_VERSION && header.tile > 0 && header.border < header.tile &&
+		header.levels > 0 && header.levels <= 32;
+}
+
+// every level's tiles lie inside a file of fileSize bytes
+inline bool rvt_levels_valid(const rvtHeader& header, const rvtLevel* levels, uint64_t fileSize)
+{
+	for (uint32_t i = 0; i < header.levels; i++)
+	{
+		uint64_t bytes = static_cast<uint64_t>(levels[i].tilesX) * levels[i].tilesY * rvt_tile_bytes(header);
+		if (levels[i].offset > fileSize || bytes > fileSize - levels[i].offset ||
+			levels[i].tilesX != (levels[i].width + header.tile - 1) / header.tile ||
+			levels[i].tilesY != (levels[i].height + header.tile - 1) / header.tile)
+			return false;
+	}
+	return true;
+}
@@ -0,0 +1,264 @@
+#include "TextureLoader.h"
+#include "GLutility.h"
+#include <cstring>
+#include <cstdio>
+#include <iostream>
+#include <algorithm>
+#include <stb_image.h>
+
+using namespace std;
+
+// not part of core GL, but exposed by every desktop driver
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+
+static double elapsed_ms(chrono::steady_clock::time_point since)
+{
+	return chrono::duration<double, milli>(chrono::steady_clock::now() - since).count();
+}
+
+static bool has_extension(const char* name)
+{
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (GLint i = 0; i < count; i++)
+		if (strcmp(reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i)), name) == 0)
+			return true;
+	return false;
+}
+
+// rgba8 level 0 followed by the rest of the mip chain, laid out like a cooked file
+static bool decode(const string& name, vector<unsigned char>& pixels, vector<rtexLevel>& levels)
+{
+	Asset_Span file;
+	if (!File_System::assets().open(name, file))
+		return false;
+	int width, height, components;
+	unsigned char* data = stbi_load_from_memory(file.data(), static_cast<int>(file.size()), &width, &height, &components, 4);
+	if (!data)
+		return false;
+
+	size_t total = 0;
+	for (int w = width, h = height; ; w = max(1, w / 2), h = max(1, h / 2))
+	{
+		rtexLevel level = {};
+		level.offset = total;
+		level.size = rtex_level_size(RTEX_RGBA8, w, h);
+		level.width = w;
+		level.height = h;
+		levels.push_back(level);
+		total += level.size;
+		if (w == 1 && h == 1)
+			break;
+	}
+
+	pixels.resize(total);
+	memcpy(pixels.data(), data, levels[0].size);
+	stbi_image_free(data);
+	for (size_t i = 1; i < levels.size(); i++)
+		rtex_downsample(&pixels[levels[i - 1].offset], levels[i - 1].width, levels[i - 1].height, &pixels[levels[i].offset]);
+	return true;
+}
+
+Texture_Loader::Texture_Loader(Thread_Pool& pool, size_t bytesPerFrame)
+	: pool(pool), shared(make_shared<Shared>()), virtualTexture(pool), bytesPerFrame(bytesPerFrame)
+{
+	shared->loader = this;
+	glGenBuffers(1, &pbo);
+	bc1Supported = has_extension("GL_EXT_texture_compression_s3tc");
+
+	const unsigned char grey[4] = { 128, 128, 128, 255 };
+	placeholder = arrays.allocate(1, 1, 1, GL_RGBA8, false);
+	arrays.upload_rows(placeholder, 0, 0, 1, sizeof(grey), grey);
+
+	glGenBuffers(1, &slotTbo);
+	glBindBuffer(GL_TEXTURE_BUFFER, slotTbo);
+	glBufferData(GL_TEXTURE_BUFFER, sizeof(raytTextureSlot), &placeholder, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	glGenTextures(1, &slotTex);
+	glActiveTexture(GL_TEXTURE0 + Slot_Unit);
+	glBindTexture(GL_TEXTURE_BUFFER, slotTex);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32I, slotTbo);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+Texture_Loader::~Texture_Loader()
+{
+	shared->loader = nullptr;
+}
+
+void Texture_Loader::bind(GL_Utility& util) const
+{
+	util.set_int("texture_slots", Slot_Unit);
+	for (int i = 0; i < Texture_Arrays::Max_Arrays; i++)
+		util.set_int(("texture_array_" + to_string(i)).c_str(), Texture_Arrays::First_Unit + i);
+	virtualTexture.bind(util);
+}
+
+int Texture_Loader::load_virtual(const string& name)
+{
+	const string cooked = "cooked/" + name + ".rvt";
+	if (virtualTexture.is_open() || !virtualTexture.open(cooked))
+		return load(name);
+
+	int handle = static_cast<int>(entries.size());
+	entries.push_back({ cooked, 0, chrono::steady_clock::now() });
+	slots.push_back({ -1, 0 });
+	update_slots();
+	return handle + 1;
+}
+
+void Texture_Loader::render_feedback(GL_Utility& util, GLuint quadVAO)
+{
+	virtualTexture.render_feedback(util, quadVAO);
+}
+
+int Texture_Loader::load(const string& name)
+{
+	const string path = "textures/" + name;
+	const string cooked = "cooked/" + name + ".rtex";
+
+	int handle = static_cast<int>(entries.size());
+	entries.push_back({ path, 0, chrono::steady_clock::now() });
+	slots.push_back(placeholder);
+	update_slots();
+	pendingCount++;
+
+	shared_ptr<Shared> target = shared;
+	Thread_Pool* workers = &pool;
+	bool bc1 = bc1Supported;
+	pool.submit([target, workers, handle, path, cooked, bc1]
+	{
+		auto start = chrono::steady_clock::now();
+		Decoded image = { handle, RTEX_RGBA8, {}, {}, {}, 0 };
+
+		Asset_Span file;
+		if (File_System::assets().open(cooked, file))
+		{
+			const rtexLevel* levels = rtex_levels(file.data(), file.size());
+			const rtexHeader* header = reinterpret_cast<const rtexHeader*>(file.data());
+			if (!levels)
+				cout << "Malformed cooked texture: " << cooked << endl;
+			else if (header->format == RTEX_BC1 && !bc1)
+				cout << "BC1 is not supported, decoding " << path << " instead" << endl;
+			else
+			{
+				image.file = file;
+				image.format = header->format;
+				image.levels.assign(levels, levels + header->levels);
+			}
+		}
+
+		if (image.file.empty() && !decode(path, image.pixels, image.levels))
+			image.levels.clear();
+		image.decodeMs = elapsed_ms(start);
+
+		shared_ptr<Decoded> done = make_shared<Decoded>(move(image));
+		workers->run_on_main([target, done]
+		{
+			if (target->loader)
+				target->loader->uploads.push_back(move(*done));
+		});
+	});
+	return handle + 1;
+}
+
+void Texture_Loader::update()
+{
+	virtualTexture.update();
+	if (pendingCount == 0)
+		return;
+
+	for (size_t i = 0; i < entries.size(); i++)
+		if (slots[i].array == placeholder.array && slots[i].layer == placeholder.layer)
+			entries[i].frames++;
+
+	size_t budget = bytesPerFrame;
+	while (budget > 0 && !uploads.empty())
+	{
+		Decoded& image = uploads.front();
+		if (image.levels.empty())
+		{
+			cout << "Texture failed to load at path: " << entries[image.handle].path << endl;
+			uploads.pop_front();
+			pendingCount--;
+			continue;
+		}
+		upload_slice(image, budget);
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+// the next rows of the current level, compressed levels move in whole block rows
+void Texture_Loader::upload_slice(Decoded& image, size_t& budget)
+{
+	bool compressed = image.format == RTEX_BC1;
+	if (uploadLevel == 0 && uploadRow == 0)
+	{
+		uploadSlot = arrays.allocate(image.levels[0].width, image.levels[0].height, static_cast<int>(image.levels.size()),
+			compressed ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_RGBA8, compressed);
+		if (uploadSlot.array < 0)
+		{
+			cout << "No texture array left for " << entries[image.handle].path << endl;
+			uploads.pop_front();
+			pendingCount--;
+			return;
+		}
+	}
+
+	const rtexLevel& level = image.levels[uploadLevel];
+	int blockHeight = compressed ? 4 : 1;
+	int blockRows = (level.height + blockHeight - 1) / blockHeight;
+	size_t rowBytes = static_cast<size_t>(level.size) / blockRows;
+
+	// at least one row per frame, even if a single row is over budget
+	int first = uploadRow / blockHeight;
+	int count = static_cast<int>(min<size_t>(max<size_t>(budget / rowBytes, 1), blockRows - first));
+	size_t bytes = count * rowBytes;
+
+	// orphan the previous slice instead of waiting for its transfer
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+	void* dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	memcpy(dst, image.data() + level.offset + first * rowBytes, bytes);
+	glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+	int rows = min(count * blockHeight, static_cast<int>(level.height) - uploadRow);
+	arrays.upload_rows(uploadSlot, uploadLevel, uploadRow, rows, bytes, nullptr);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	budget -= min(budget, bytes);
+	uploadRow += rows;
+	if (uploadRow == static_cast<int>(level.height))
+	{
+		uploadRow = 0;
+		if (++uploadLevel == static_cast<int>(image.levels.size()))
+			finish(image);
+	}
+}
+
+// all levels are in, point the slot at the new layer instead of the placeholder
+void Texture_Loader::finish(Decoded& image)
+{
+	Entry& entry = entries[image.handle];
+	slots[image.handle] = uploadSlot;
+	update_slots();
+
+	printf("Texture '%s': %ux%u %s, %s in %.1f ms, array %d layer %d, uploaded over %d frames, ready %.1f ms after the request\n",
+		entry.path.c_str(), image.levels[0].width, image.levels[0].height, image.format == RTEX_BC1 ? "bc1" : "rgba8",
+		image.file.empty() ? "decoded" : "cooked file", image.decodeMs, uploadSlot.array, uploadSlot.layer, entry.frames,
+		elapsed_ms(entry.requested));
+
+	uploads.pop_front();
+	uploadLevel = 0;
+	pendingCount--;
+	if (pendingCount == 0)
+		printf("Texture arrays: %zu bytes\n", arrays.memory_bytes());
+}
+
+void Texture_Loader::update_slots()
+{
+	GL_Utility::update_texture_buffer(slotTbo, slots.size() * sizeof(raytTextureSlot), slots.data());
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <chrono>
+#include "ThreadPool.h"
+#include "FileSystem.h"
+#include "TextureFile.h"
+#include "TextureArrays.h"
+#include "VirtualTexture.h"
+
+using namespace std;
+
+class GL_Utility;
+
+// Decodes images on the worker pool and streams them into the texture arrays through a
+// pixel buffer object, at most bytesPerFrame per update(). Textures are addressed by
+// textureNum through the texture_slots table, which points at a 1x1 placeholder until
+// a texture is complete, so startup never waits on decoding.
+// Cooked .rtex files skip the decode: their levels are uploaded as is straight from the
+// asset file, decoded images get their mip chain built on the worker. Both are read
+// through File_System::assets(), textures/<name> and cooked/<name>.rtex.
+// One texture may be virtual, streamed by tiles from a cooked .rvt file, see Virtual_Texture.
+class Texture_Loader
+{
+public:
+	static const int Slot_Unit = 1;
+
+	explicit Texture_Loader(Thread_Pool& pool, size_t bytesPerFrame = 4 << 20);
+	~Texture_Loader();
+
+	// name is relative to textures/, the cooked file is preferred when it exists
+	// and its format is supported. Returns the textureNum for the scene primitives,
+	// decoding starts right away.
+	int load(const string& name);
+	// like load, but streamed on demand from the cooked .rvt file when there is one and no
+	// other texture has taken the virtual texture yet
+	int load_virtual(const string& name);
+	// points the shader's samplers at the arrays and the slot table, after create_shaders
+	void bind(GL_Utility& util) const;
+	// GL thread, once per frame after Thread_Pool::run_main_jobs, which hands the decoded
+	// images over: uploads the next slice of decoded rows
+	void update();
+	// GL thread, before the frame is drawn, see Virtual_Texture::render_feedback
+	void render_feedback(GL_Utility& util, GLuint quadVAO);
+
+	bool pending() const { return pendingCount > 0; }
+	// see Virtual_Texture::settled
+	bool virtual_settled() const { return virtualTexture.settled(); }
+
+private:
+	struct Decoded
+	{
+		int handle;
+		uint32_t format;
+		vector<rtexLevel> levels;
+		Asset_Span file; // cooked files
+		vector<unsigned char> pixels; // decoded images, all levels
+		double decodeMs;
+
+		const unsigned char* data() const { return file.empty() ? pixels.data() : file.data(); }
+	};
+
+	// shared with decode jobs still in flight, which may outlive the loader. They post
+	// their result with Thread_Pool::run_on_main, so it is only looked at on the main thread
+	struct Shared
+	{
+		Texture_Loader* loader; // null once the loader is gone
+	};
+
+	struct Entry
+	{
+		string path;
+		int frames;
+		chrono::steady_clock::time_point requested;
+	};
+
+	Thread_Pool& pool;
+	shared_ptr<Shared> shared;
+	vector<Entry> entries;
+	vector<raytTextureSlot> slots; // per textureNum - 1, uploaded to texture_slots
+	raytTextureSlot placeholder;
+	Texture_Arrays arrays;
+	Virtual_Texture virtualTexture;
+	deque<Decoded> uploads; // front one is being uploaded
+	raytTextureSlot uploadSlot;
+	int uploadLevel = 0;
+	int uploadRow = 0;
+	bool bc1Supported = false;
+	int pendingCount = 0;
+	size_t bytesPerFrame;
+	GLuint pbo = 0;
+	GLuint slotTbo = 0, slotTex = 0;
+
+	void upload_slice(Decoded& image, size_t& budget);
+	void finish(Decoded& image);
+	void update_slots();
+};
@@ -0,0 +1,284 @@
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cstdio>
+
+using namespace std;
+
+// the pool and the deque index of the worker running on this thread
+static thread_local Thread_Pool* currentPool = nullptr;
+static thread_local int currentWorker = -1;
+
+Job_Counter::~Job_Counter()
+{
+	// left behind only if the pool stopped before the counter got to zero
+	for (Job* job : continuations)
+		delete job;
+}
+
+Thread_Pool::Thread_Pool(int threads)
+	: mainThread(this_thread::get_id()), started(chrono::steady_clock::now())
+{
+	if (threads <= 0)
+		threads = max(1, static_cast<int>(thread::hardware_concurrency()) - 1);
+
+	for (int i = 0; i < threads; i++)
+		workers.emplace_back(new Worker());
+	for (int i = 0; i < threads; i++)
+		workers[i]->handle = thread(&Thread_Pool::run, this, i);
+}
+
+Thread_Pool::~Thread_Pool()
+{
+	{
+		lock_guard<mutex> guard(lock);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (unique_ptr<Worker>& worker : workers)
+		worker->handle.join();
+
+	// queued jobs are dropped on shutdown, but for parallel_for helpers: these only let go
+	// of their Batches, which would leak otherwise
+	Job* job;
+	for (unique_ptr<Worker>& worker : workers)
+		while ((job = worker->jobs.pop()))
+			drop(job);
+	while (injected.pop(job))
+		drop(job);
+	while (mainJobs.pop(job))
+		drop(job);
+}
+
+void Thread_Pool::drop(Job* job)
+{
+	if (job->runOnShutdown)
+		job->work();
+	delete job;
+}
+
+void Thread_Pool::submit(function<void()> job, Job_Counter* counter)
+{
+	if (counter)
+		counter->pending.fetch_add(1, memory_order_relaxed);
+	push(make_job(move(job), counter));
+}
+
+void Thread_Pool::submit_after(Job_Counter& dependency, function<void()> job, Job_Counter* counter)
+{
+	if (counter)
+		counter->pending.fetch_add(1, memory_order_relaxed);
+	Job* deferred = make_job(move(job), counter);
+
+	// the count only gets to zero under the guard, after the continuations are taken
+	dependency.lock();
+	bool ready = dependency.pending.load(memory_order_acquire) == 0;
+	if (!ready)
+		dependency.continuations.push_back(deferred);
+	dependency.unlock();
+	if (ready)
+		push(deferred);
+}
+
+Thread_Pool::Job* Thread_Pool::make_job(function<void()> work, Job_Counter* counter)
+{
+	Job* job = jobPool.acquire();
+	job->work = move(work);
+	job->counter = counter;
+	job->runOnShutdown = false;
+	return job;
+}
+
+void Thread_Pool::push(Job* job)
+{
+	bool pushed = currentPool == this && workers[currentWorker]->jobs.push(job);
+	if (!pushed && !injected.push(job))
+	{
+		// every queue is full, the submitting thread does the work itself
+		execute(job);
+		return;
+	}
+
+	queued.fetch_add(1, memory_order_seq_cst);
+	if (sleepers.load(memory_order_seq_cst) > 0)
+	{
+		lock_guard<mutex> guard(lock);
+		wake.notify_one();
+	}
+}
+
+// the worker's own newest job, then the shared queue, then the oldest of another worker
+Thread_Pool::Job* Thread_Pool::find(int index)
+{
+	Job* job = index >= 0 ? workers[index]->jobs.pop() : nullptr;
+	if (!job && !injected.pop(job))
+		job = nullptr;
+	int count = static_cast<int>(workers.size());
+	for (int i = 1; !job && i <= count; i++)
+	{
+		int victim = (max(index, 0) + i) % count;
+		if (victim == index)
+			continue;
+		job = workers[victim]->jobs.steal();
+		if (job && index >= 0)
+			workers[index]->stolen.fetch_add(1, memory_order_relaxed);
+	}
+	if (job)
+		queued.fetch_sub(1, memory_order_relaxed);
+	return job;
+}
+
+void Thread_Pool::execute(Job* job)
+{
+	job->work();
+	Job_Counter* counter = job->counter;
+	// what the job captured goes now, not when the job is reused
+	job->work = nullptr;
+	jobPool.release(job);
+	if (counter)
+		release(counter);
+}
+
+// Any job but the last only decrements. The last one takes the count to zero under the
+// guard and takes the continuations with it; done() is false until the guard is let go,
+// so the unlock is the last access and a waiter can destroy the counter right after it
+void Thread_Pool::release(Job_Counter* counter)
+{
+	int left = counter->pending.load(memory_order_relaxed);
+	while (left > 1)
+		if (counter->pending.compare_exchange_weak(left, left - 1, memory_order_acq_rel, memory_order_relaxed))
+			return;
+
+	vector<Job*> ready;
+	counter->lock();
+	if (counter->pending.fetch_sub(1, memory_order_acq_rel) == 1)
+		ready.swap(counter->continuations);
+	counter->unlock();
+	for (Job* job : ready)
+		push(job);
+}
+
+void Thread_Pool::wait(Job_Counter& counter)
+{
+	while (!counter.done())
+	{
+		Job* job = find(currentPool == this ? currentWorker : -1);
+		if (job)
+			execute(job);
+		else
+			this_thread::yield();
+	}
+}
+
+void Thread_Pool::Batches::claim()
+{
+	size_t batch;
+	while ((batch = next.fetch_add(1)) < total)
+	{
+		size_t begin = batch * batchSize;
+		run(body, begin, min(begin + batchSize, count));
+		done.fetch_add(1, memory_order_release);
+	}
+}
+
+void Thread_Pool::run_batches(size_t count, size_t batchSize, Batch_Function run, const void* body)
+{
+	size_t total = (count + batchSize - 1) / batchSize;
+	if (total <= 1)
+	{
+		if (count > 0)
+			run(body, 0, count);
+		return;
+	}
+
+	size_t helpers = min(total - 1, workers.size());
+	Batches* batches = batchesPool.acquire();
+	batches->run = run;
+	batches->body = body;
+	batches->count = count;
+	batches->batchSize = batchSize;
+	batches->total = total;
+	batches->next.store(0, memory_order_relaxed);
+	batches->done.store(0, memory_order_relaxed);
+	batches->users.store(static_cast<int>(helpers) + 1, memory_order_relaxed);
+
+	for (size_t i = 0; i < helpers; i++)
+	{
+		Job* helper = make_job([this, batches]
+		{
+			batches->claim();
+			leave(batches);
+		}, nullptr);
+		helper->runOnShutdown = true;
+		push(helper);
+	}
+	batches->claim();
+
+	// only for batches other threads are in the middle of
+	while (batches->done.load(memory_order_acquire) < total)
+		this_thread::yield();
+	leave(batches);
+}
+
+void Thread_Pool::leave(Batches* batches)
+{
+	if (batches->users.fetch_sub(1, memory_order_acq_rel) == 1)
+		batchesPool.release(batches);
+}
+
+void Thread_Pool::run_on_main(function<void()> job)
+{
+	if (this_thread::get_id() == mainThread)
+	{
+		job();
+		return;
+	}
+	Job* posted = make_job(move(job), nullptr);
+	while (!mainJobs.push(posted))
+		this_thread::yield();
+}
+
+void Thread_Pool::run_main_jobs()
+{
+	// jobs these post themselves wait for the next frame
+	Job* job;
+	for (size_t i = 0; i < Queue_Capacity && mainJobs.pop(job); i++)
+		execute(job);
+}
+
+void Thread_Pool::run(int index)
+{
+	currentPool = this;
+	currentWorker = index;
+	Worker& worker = *workers[index];
+
+	while (!stopping)
+	{
+		Job* job = find(index);
+		if (!job)
+		{
+			unique_lock<mutex> guard(lock);
+			sleepers.fetch_add(1, memory_order_seq_cst);
+			wake.wait(guard, [this] { return stopping || queued.load(memory_order_seq_cst) > 0; });
+			sleepers.fetch_sub(1, memory_order_relaxed);
+			continue;
+		}
+
+		auto start = chrono::steady_clock::now();
+		execute(job);
+		worker.busyNs.fetch_add(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count(),
+			memory_order_relaxed);
+		worker.ran.fetch_add(1, memory_order_relaxed);
+	}
+}
+
+void Thread_Pool::report() const
+{
+	double elapsedNs = static_cast<double>(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - started).count());
+	printf("Job workers: %zu threads\n", workers.size());
+	for (size_t i = 0; i < workers.size(); i++)
+	{
+		const Worker& worker = *workers[i];
+		printf("  worker %zu: %.1f%% busy, %llu jobs, %llu stolen\n", i, 100 * worker.busyNs.load() / max(elapsedNs, 1.0),
+			static_cast<unsigned long long>(worker.ran.load()), static_cast<unsigned long long>(worker.stolen.load()));
+	}
+}
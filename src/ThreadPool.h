@@ -0,0 +1,157 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <memory>
+#include <chrono>
+#include "WorkStealingDeque.h"
+#include "MpmcQueue.h"
+#include "ObjectPool.h"
+
+using namespace std;
+
+class Thread_Pool;
+
+// counts the jobs submitted with it that have not finished, jobs submitted after it
+// start once it is back at zero. The last job takes the count to zero and hands out the
+// continuations under the guard and lets go of the guard as its last access, so once
+// done() the counter may go
+class Job_Counter
+{
+public:
+	Job_Counter() = default;
+	~Job_Counter();
+
+	Job_Counter(const Job_Counter&) = delete;
+	Job_Counter& operator=(const Job_Counter&) = delete;
+
+	bool done() const { return pending.load(memory_order_acquire) == 0 && !guard.load(memory_order_acquire); }
+
+private:
+	friend class Thread_Pool;
+	struct Job
+	{
+		function<void()> work;
+		Job_Counter* counter;
+		bool runOnShutdown; // run rather than dropped by ~Thread_Pool
+	};
+
+	atomic<int> pending{ 0 };
+	atomic<bool> guard{ false }; // over continuations and the decrement to zero
+	vector<Job*> continuations;
+
+	void lock()
+	{
+		while (guard.exchange(true, memory_order_acquire))
+			this_thread::yield();
+	}
+	void unlock() { guard.store(false, memory_order_release); }
+};
+
+// The job system: a fixed set of worker threads, each with a work stealing deque. A job
+// submitted by a worker goes on its own deque and is run newest first, idle workers
+// steal the oldest jobs of the others; jobs from other threads come in through a shared
+// queue. The queues take no locks, a worker only locks to go to sleep for lack of work.
+// Jobs run in no particular order and must not touch GL, what has to happen on the GL
+// thread is posted with run_on_main and run by run_main_jobs once per frame.
+class Thread_Pool
+{
+public:
+	// 0 uses one thread less than the hardware has, the main thread keeps a core
+	explicit Thread_Pool(int threads = 0);
+	~Thread_Pool();
+
+	Thread_Pool(const Thread_Pool&) = delete;
+	Thread_Pool& operator=(const Thread_Pool&) = delete;
+
+	// counter, if given, counts the job until it has run
+	void submit(function<void()> job, Job_Counter* counter = nullptr);
+	// job starts once every job counted by dependency has finished
+	void submit_after(Job_Counter& dependency, function<void()> job, Job_Counter* counter = nullptr);
+	// returns once counter is at zero, running other jobs meanwhile
+	void wait(Job_Counter& counter);
+	// runs body(begin, end) over [0, count) in batches of batchSize on the workers and
+	// the calling thread, returns when every batch is done. Batches go to whoever is free
+	// first, a worker still busy with an earlier job does not hold the call up, and the
+	// caller runs nothing but batches of this call
+	template<typename Body>
+	void parallel_for(size_t count, size_t batchSize, const Body& body)
+	{
+		run_batches(count, batchSize, [](const void* context, size_t begin, size_t end)
+		{
+			(*static_cast<const Body*>(context))(begin, end);
+		}, &body);
+	}
+	int size() const { return static_cast<int>(workers.size()); }
+
+	// any thread, job runs on the thread that constructed the pool at its next
+	// run_main_jobs, or right away when called on that thread
+	void run_on_main(function<void()> job);
+	// main thread, once per frame, the jobs posted before the call
+	void run_main_jobs();
+
+	// per worker, the share of the time since construction spent running jobs
+	void report() const;
+
+	static const size_t Deque_Capacity = 4096;
+	static const size_t Queue_Capacity = 4096;
+	// jobs and parallel_for calls kept for reuse once they are done
+	static const size_t Job_Pool_Capacity = 4096;
+	static const size_t Batches_Pool_Capacity = 64;
+
+private:
+	typedef Job_Counter::Job Job;
+	typedef void (*Batch_Function)(const void* body, size_t begin, size_t end);
+
+	// a parallel_for call, shared by the caller and its helper jobs; the last of them to
+	// let go of it returns it to the pool, a helper that starts after the call returned
+	// still finds nothing left to claim
+	struct Batches
+	{
+		Batch_Function run;
+		const void* body;
+		size_t count, batchSize, total;
+		atomic<size_t> next{ 0 };
+		atomic<size_t> done{ 0 };
+		atomic<int> users{ 0 };
+
+		void claim();
+	};
+
+	struct Worker
+	{
+		thread handle;
+		Work_Stealing_Deque<Job, Deque_Capacity> jobs;
+		atomic<uint64_t> busyNs{ 0 };
+		atomic<uint64_t> ran{ 0 };
+		atomic<uint64_t> stolen{ 0 };
+	};
+
+	vector<unique_ptr<Worker>> workers;
+	Object_Pool<Job, Job_Pool_Capacity> jobPool;
+	Object_Pool<Batches, Batches_Pool_Capacity> batchesPool;
+	Mpmc_Queue<Job*, Queue_Capacity> injected;
+	Mpmc_Queue<Job*, Queue_Capacity> mainJobs;
+	thread::id mainThread;
+	chrono::steady_clock::time_point started;
+
+	atomic<bool> stopping{ false };
+	atomic<int> queued{ 0 }; // jobs in the deques and the shared queue
+	atomic<int> sleepers{ 0 };
+	mutex lock; // only for sleeping
+	condition_variable wake;
+
+	Job* make_job(function<void()> work, Job_Counter* counter);
+	void push(Job* job);
+	Job* find(int index);
+	void execute(Job* job);
+	void drop(Job* job);
+	void release(Job_Counter* counter);
+	void run(int index);
+	void run_batches(size_t count, size_t batchSize, Batch_Function run, const void* body);
+	void leave(Batches* batches);
+};
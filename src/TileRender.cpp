@@ -0,0 +1,468 @@
+#include "TileRender.h"
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <iostream>
+
+#ifdef __linux__
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+#ifdef __linux__
+
+static bool send_message(int fd, tileMessage message)
+{
+	message.version = TILE_PROTOCOL_VERSION;
+	return send(fd, &message, sizeof(message), MSG_NOSIGNAL) == static_cast<ssize_t>(sizeof(message));
+}
+
+static bool receive_message(int fd, tileMessage& message)
+{
+	return recv(fd, &message, sizeof(message), 0) == static_cast<ssize_t>(sizeof(message)) &&
+		message.version == TILE_PROTOCOL_VERSION;
+}
+
+static bool socket_address(const string& path, sockaddr_un& address)
+{
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (path.size() >= sizeof(address.sun_path))
+	{
+		cout << "Socket path too long: " << path << endl;
+		return false;
+	}
+	strcpy(address.sun_path, path.c_str());
+	return true;
+}
+
+Tile_Coordinator::Tile_Coordinator(int tileSize)
+	: tileSize(tileSize > 0 ? tileSize : 128)
+{
+}
+
+Tile_Coordinator::~Tile_Coordinator()
+{
+	close();
+}
+
+bool Tile_Coordinator::listen(const string& socketPath)
+{
+	sockaddr_un address;
+	if (!socket_address(socketPath, address))
+		return false;
+	unlink(socketPath.c_str());
+	listenFd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (listenFd < 0 || bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+		::listen(listenFd, 16) != 0)
+	{
+		cout << "Failed to listen on " << socketPath << endl;
+		if (listenFd >= 0)
+			::close(listenFd);
+		listenFd = -1;
+		return false;
+	}
+	this->socketPath = socketPath;
+	printf("Tile coordinator: workers connect to %s\n", socketPath.c_str());
+	return true;
+}
+
+bool Tile_Coordinator::spawn(int count, const vector<string>& args)
+{
+	vector<char*> argv;
+	string name = "rt";
+	argv.push_back(&name[0]);
+	for (const string& arg : args)
+		argv.push_back(const_cast<char*>(arg.c_str()));
+	argv.push_back(nullptr);
+
+	for (int i = 0; i < count; i++)
+	{
+		pid_t child = fork();
+		if (child == 0)
+		{
+			execv("/proc/self/exe", argv.data());
+			_exit(127);
+		}
+		if (child < 0)
+		{
+			cout << "Failed to start a tile worker" << endl;
+			return false;
+		}
+		children.push_back(child);
+	}
+	return true;
+}
+
+// the first worker's canvas decides the frame size
+bool Tile_Coordinator::create_frame(int width, int height)
+{
+	if (width <= 0 || height <= 0)
+		return false;
+	shmName = "/rt_tiles_" + to_string(getpid());
+	pixelBytes = static_cast<size_t>(width) * height * 4;
+	int fd = shm_open(shmName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+	if (fd < 0 || ftruncate(fd, pixelBytes) != 0)
+	{
+		cout << "Failed to create the shared memory " << shmName << endl;
+		if (fd >= 0)
+			::close(fd);
+		shm_unlink(shmName.c_str());
+		shmName.clear();
+		return false;
+	}
+	void* mapped = mmap(nullptr, pixelBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (mapped == MAP_FAILED)
+	{
+		cout << "Failed to map the shared memory " << shmName << endl;
+		return false;
+	}
+	pixels = static_cast<unsigned char*>(mapped);
+	this->width = width;
+	this->height = height;
+
+	for (int y = 0; y < height; y += tileSize)
+		for (int x = 0; x < width; x += tileSize)
+			tiles.push_back({ x, y, min(tileSize, width - x), min(tileSize, height - y) });
+	printf("Tile coordinator: %dx%d canvas in %zu tiles of %d\n", width, height, tiles.size(), tileSize);
+	return true;
+}
+
+void Tile_Coordinator::dispatch(Worker& worker)
+{
+	if (!worker.accepted || worker.tile >= 0 || queued.empty())
+		return;
+	worker.tile = queued.front();
+	queued.pop_front();
+	const Tile& tile = tiles[worker.tile];
+	tileMessage job = {};
+	job.type = TILE_JOB;
+	job.frame = frame;
+	job.time = time;
+	job.x = tile.x;
+	job.y = tile.y;
+	job.width = tile.width;
+	job.height = tile.height;
+	// a failed send shows as a hang up on the next poll, the tile is queued again then
+	send_message(worker.fd, job);
+}
+
+// false if the worker is to be dropped
+bool Tile_Coordinator::receive(Worker& worker, int& finished)
+{
+	tileMessage message;
+	if (!receive_message(worker.fd, message))
+		return false;
+
+	if (message.type == TILE_HELLO && !worker.accepted)
+	{
+		if (!pixels && !create_frame(message.width, message.height))
+			return false;
+		tileMessage reply = {};
+		if (message.width != width || message.height != height)
+		{
+			printf("Tile coordinator: rejected a worker with a %dx%d canvas\n", message.width, message.height);
+			reply.type = TILE_REJECT;
+			send_message(worker.fd, reply);
+			return false;
+		}
+		reply.type = TILE_ACCEPT;
+		strncpy(reply.shm, shmName.c_str(), sizeof(reply.shm) - 1);
+		worker.accepted = send_message(worker.fd, reply);
+		return worker.accepted;
+	}
+	if (message.type == TILE_DONE && worker.tile >= 0 && message.frame == frame)
+	{
+		worker.tile = -1;
+		finished++;
+		return true;
+	}
+	return false;
+}
+
+// reaps the workers that exited, false once none of those started is running
+bool Tile_Coordinator::children_left()
+{
+	for (size_t i = children.size(); i-- > 0;)
+		if (waitpid(children[i], nullptr, WNOHANG) == children[i])
+			children.erase(children.begin() + i);
+	return !children.empty();
+}
+
+bool Tile_Coordinator::render(int frames, float fps, const string& outputPrefix)
+{
+	if (listenFd < 0)
+		return false;
+	bool spawned = !children.empty();
+
+	for (frame = 0; frame < frames; frame++)
+	{
+		time = frame / fps;
+		bool started = false;
+		int finished = 0;
+		while (!started || finished < static_cast<int>(tiles.size()))
+		{
+			if (!started && pixels)
+			{
+				for (size_t i = 0; i < tiles.size(); i++)
+					queued.push_back(static_cast<int>(i));
+				started = true;
+			}
+			for (Worker& worker : workers)
+				dispatch(worker);
+
+			vector<pollfd> fds(1, { listenFd, POLLIN, 0 });
+			for (const Worker& worker : workers)
+				fds.push_back({ worker.fd, POLLIN, 0 });
+			if (poll(fds.data(), fds.size(), 500) <= 0)
+			{
+				if (spawned && workers.empty() && !children_left())
+				{
+					cout << "Tile coordinator: every worker exited, frame " << frame << " is not done" << endl;
+					return false;
+				}
+				continue;
+			}
+
+			for (size_t i = workers.size(); i-- > 0;)
+			{
+				if (!fds[i + 1].revents || receive(workers[i], finished))
+					continue;
+				// its tile goes to the next idle worker
+				if (workers[i].tile >= 0)
+					queued.push_front(workers[i].tile);
+				::close(workers[i].fd);
+				workers.erase(workers.begin() + i);
+			}
+			if (fds[0].revents & POLLIN)
+			{
+				int fd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+				if (fd >= 0)
+					workers.push_back({ fd, false, -1 });
+			}
+		}
+
+		char number[16];
+		snprintf(number, sizeof(number), "_%04d.ppm", frame);
+		if (!write_frame(outputPrefix + number))
+			return false;
+	}
+	return true;
+}
+
+bool Tile_Coordinator::write_frame(const string& path) const
+{
+	FILE* file = fopen(path.c_str(), "wb");
+	if (!file)
+	{
+		cout << "Failed to write " << path << endl;
+		return false;
+	}
+	fprintf(file, "P6\n%d %d\n255\n", width, height);
+	vector<unsigned char> row(static_cast<size_t>(width) * 3);
+	// the rows are bottom up
+	for (int y = height - 1; y >= 0; y--)
+	{
+		const unsigned char* source = pixels + static_cast<size_t>(y) * width * 4;
+		for (int x = 0; x < width; x++)
+			memcpy(&row[x * 3], source + x * 4, 3);
+		fwrite(row.data(), 1, row.size(), file);
+	}
+	bool ok = ferror(file) == 0;
+	ok = fclose(file) == 0 && ok;
+	if (ok)
+		printf("Tile coordinator: frame %d -> %s\n", frame, path.c_str());
+	else
+		cout << "Failed to write " << path << endl;
+	return ok;
+}
+
+void Tile_Coordinator::close()
+{
+	tileMessage finish = {};
+	finish.type = TILE_FINISH;
+	for (Worker& worker : workers)
+	{
+		send_message(worker.fd, finish);
+		::close(worker.fd);
+	}
+	workers.clear();
+	for (pid_t child : children)
+		waitpid(child, nullptr, 0);
+	children.clear();
+
+	if (listenFd >= 0)
+	{
+		::close(listenFd);
+		unlink(socketPath.c_str());
+	}
+	listenFd = -1;
+	if (pixels)
+	{
+		munmap(pixels, pixelBytes);
+		shm_unlink(shmName.c_str());
+	}
+	pixels = nullptr;
+}
+
+Tile_Worker::~Tile_Worker()
+{
+	close();
+}
+
+bool Tile_Worker::connect(const string& socketPath, int width, int height)
+{
+	sockaddr_un address;
+	if (!socket_address(socketPath, address))
+		return false;
+	fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+	{
+		cout << "Tile worker: no coordinator at " << socketPath << endl;
+		close();
+		return false;
+	}
+
+	tileMessage hello = {};
+	hello.type = TILE_HELLO;
+	hello.width = width;
+	hello.height = height;
+	tileMessage reply;
+	if (!send_message(fd, hello) || !receive_message(fd, reply) || reply.type != TILE_ACCEPT)
+	{
+		cout << "Tile worker: the coordinator did not accept a " << width << "x" << height << " canvas" << endl;
+		close();
+		return false;
+	}
+
+	reply.shm[sizeof(reply.shm) - 1] = 0;
+	pixelBytes = static_cast<size_t>(width) * height * 4;
+	int shm = shm_open(reply.shm, O_RDWR, 0);
+	struct stat info;
+	void* mapped = MAP_FAILED;
+	if (shm >= 0 && fstat(shm, &info) == 0 && static_cast<size_t>(info.st_size) == pixelBytes)
+		mapped = mmap(nullptr, pixelBytes, PROT_READ | PROT_WRITE, MAP_SHARED, shm, 0);
+	if (shm >= 0)
+		::close(shm);
+	if (mapped == MAP_FAILED)
+	{
+		cout << "Tile worker: failed to map the shared memory " << reply.shm << endl;
+		close();
+		return false;
+	}
+	pixels = static_cast<unsigned char*>(mapped);
+	this->width = width;
+	this->height = height;
+
+	glGenTextures(1, &colorTex);
+	glBindTexture(GL_TEXTURE_2D, colorTex);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTex, 0);
+	bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if (!complete)
+	{
+		cout << "Tile worker: the offscreen framebuffer is incomplete" << endl;
+		close();
+		return false;
+	}
+	printf("Tile worker %d: connected to %s\n", static_cast<int>(getpid()), socketPath.c_str());
+	return true;
+}
+
+bool Tile_Worker::next(tileMessage& job)
+{
+	return fd >= 0 && receive_message(fd, job) && job.type == TILE_JOB && job.x >= 0 && job.y >= 0 &&
+		job.width > 0 && job.height > 0 && job.x + job.width <= width && job.y + job.height <= height;
+}
+
+void Tile_Worker::begin_tile(const tileMessage& job)
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glViewport(0, 0, width, height);
+	glEnable(GL_SCISSOR_TEST);
+	glScissor(job.x, job.y, job.width, job.height);
+}
+
+bool Tile_Worker::finish_tile(const tileMessage& job)
+{
+	glPixelStorei(GL_PACK_ROW_LENGTH, width);
+	glReadPixels(job.x, job.y, job.width, job.height, GL_RGBA, GL_UNSIGNED_BYTE,
+		pixels + (static_cast<size_t>(job.y) * width + job.x) * 4);
+	glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+	glDisable(GL_SCISSOR_TEST);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	tileMessage done = job;
+	done.type = TILE_DONE;
+	return send_message(fd, done);
+}
+
+bool Tile_Worker::finish_tile(const tileMessage& job, const unsigned char* rgba)
+{
+	size_t rowBytes = static_cast<size_t>(job.width) * 4;
+	for (int row = 0; row < job.height; row++)
+		memcpy(pixels + (static_cast<size_t>(job.y + row) * width + job.x) * 4, rgba + row * rowBytes, rowBytes);
+
+	tileMessage done = job;
+	done.type = TILE_DONE;
+	return send_message(fd, done);
+}
+
+void Tile_Worker::close()
+{
+	if (framebuffer)
+		glDeleteFramebuffers(1, &framebuffer);
+	if (colorTex)
+		glDeleteTextures(1, &colorTex);
+	framebuffer = colorTex = 0;
+	if (pixels)
+		munmap(pixels, pixelBytes);
+	pixels = nullptr;
+	if (fd >= 0)
+		::close(fd);
+	fd = -1;
+}
+
+#else
+
+Tile_Coordinator::Tile_Coordinator(int tileSize) : tileSize(tileSize) {}
+Tile_Coordinator::~Tile_Coordinator() {}
+
+bool Tile_Coordinator::listen(const string&)
+{
+	cout << "Tile rendering needs POSIX shared memory, it is off on this platform" << endl;
+	return false;
+}
+
+bool Tile_Coordinator::spawn(int, const vector<string>&) { return false; }
+bool Tile_Coordinator::render(int, float, const string&) { return false; }
+void Tile_Coordinator::close() {}
+
+Tile_Worker::~Tile_Worker() {}
+
+bool Tile_Worker::connect(const string&, int, int)
+{
+	cout << "Tile rendering needs POSIX shared memory, it is off on this platform" << endl;
+	return false;
+}
+
+bool Tile_Worker::next(tileMessage&) { return false; }
+void Tile_Worker::begin_tile(const tileMessage&) {}
+bool Tile_Worker::finish_tile(const tileMessage&) { return false; }
+bool Tile_Worker::finish_tile(const tileMessage&, const unsigned char*) { return false; }
+void Tile_Worker::close() {}
+
+#endif
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+
+using namespace std;
+
+// Offline frames rendered by several processes, one coordinator and any number of
+// workers on the same machine. The coordinator splits the canvas into tiles and hands
+// them out over an AF_UNIX SOCK_SEQPACKET socket, one tileMessage per packet:
+//   worker HELLO {width, height}, the canvas of the scene it loaded
+//   coordinator ACCEPT {shm}, or REJECT if the canvas differs from the other workers'
+//   coordinator TILE {frame, time, x, y, width, height}
+//   worker DONE with the same fields once the tile's pixels are in the shared memory
+//   coordinator FINISH, no more tiles
+// The shared memory object holds one frame, RGBA8 rows bottom up as glReadPixels
+// returns them. A tile of a worker that disconnects goes to another one. Linux only.
+
+#define TILE_PROTOCOL_VERSION 1
+
+enum tileMessageType : uint32_t
+{
+	TILE_HELLO = 1,
+	TILE_ACCEPT,
+	TILE_REJECT,
+	TILE_JOB,
+	TILE_DONE,
+	TILE_FINISH
+};
+
+struct tileMessage
+{
+	uint32_t type;
+	uint32_t version;
+	int32_t frame;
+	float time; // seconds into the sequence, what the animations are evaluated at
+	int32_t x, y; // from the bottom left, as for glScissor
+	int32_t width, height;
+	char shm[32]; // ACCEPT, zero terminated
+};
+
+// the process that splits frames into tiles and writes the finished frames
+class Tile_Coordinator
+{
+public:
+	explicit Tile_Coordinator(int tileSize = 128);
+	~Tile_Coordinator();
+
+	Tile_Coordinator(const Tile_Coordinator&) = delete;
+	Tile_Coordinator& operator=(const Tile_Coordinator&) = delete;
+
+	// false with a message if the socket cannot be created
+	bool listen(const string& socketPath);
+	// starts count workers running this executable with args, workers started by hand
+	// connect to the socket the same way
+	bool spawn(int count, const vector<string>& args);
+	// frame f at time f / fps, written to outputPrefix_0000.ppm and on, false if every
+	// worker is gone before the sequence is done
+	bool render(int frames, float fps, const string& outputPrefix);
+	// tells the workers to finish, waits for the ones it started and removes the socket
+	// and the shared memory
+	void close();
+
+private:
+	struct Worker
+	{
+		int fd;
+		bool accepted;
+		int tile; // index into tiles, -1 while idle
+	};
+
+	struct Tile
+	{
+		int x, y, width, height;
+	};
+
+	int tileSize;
+	string socketPath;
+	int listenFd = -1;
+	vector<Worker> workers;
+	vector<int> children;
+
+	string shmName;
+	int width = 0, height = 0; // of the canvas, set by the first HELLO
+	unsigned char* pixels = nullptr;
+	size_t pixelBytes = 0;
+
+	vector<Tile> tiles;
+	deque<int> queued;
+	int frame = 0;
+	float time = 0;
+
+	bool create_frame(int width, int height);
+	void dispatch(Worker& worker);
+	bool receive(Worker& worker, int& finished);
+	bool children_left();
+	bool write_frame(const string& path) const;
+};
+
+// the process side of a worker, renders the tiles it is handed on the GL context current
+// when connect() is called, into an offscreen framebuffer of the canvas size, or hands
+// over tiles drawn on the CPU
+class Tile_Worker
+{
+public:
+	Tile_Worker() = default;
+	~Tile_Worker();
+
+	Tile_Worker(const Tile_Worker&) = delete;
+	Tile_Worker& operator=(const Tile_Worker&) = delete;
+
+	// false with a message if the coordinator is unreachable or rejects the canvas
+	bool connect(const string& socketPath, int width, int height);
+	// waits for the next tile, false once the coordinator is done
+	bool next(tileMessage& job);
+	// binds the framebuffer, the viewport and the scissor, draw the frame after this
+	void begin_tile(const tileMessage& job);
+	// copies the tile into the shared memory and reports it done
+	bool finish_tile(const tileMessage& job);
+	// the same for a tile drawn without GL, rgba holds its RGBA8 rows bottom up
+	bool finish_tile(const tileMessage& job, const unsigned char* rgba);
+
+private:
+	int fd = -1;
+	int width = 0, height = 0;
+	unsigned char* pixels = nullptr;
+	size_t pixelBytes = 0;
+	GLuint framebuffer = 0;
+	GLuint colorTex = 0;
+
+	void close();
+};
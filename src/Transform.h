@@ -0,0 +1,45 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// World to object rotation of one primitive, recomputed only when its quaternion changes.
+// The quaternion is normalized first, so the inverse is the transpose:
+// v * rows takes world to object space and rows * v takes object back to world.
+struct Compiled_Rotation
+{
+	glm::quat quat = glm::quat(0, 0, 0, 0);
+	glm::mat3 rows;
+
+	const glm::mat3& update(const glm::quat& q)
+	{
+		if (q != quat)
+		{
+			quat = q;
+			rows = glm::transpose(glm::mat3_cast(glm::normalize(q)));
+		}
+		return rows;
+	}
+};
+
+// three vec4 rows with the translation in w, dot(row.xyz, p) + row.w is p in object space
+inline void pack_transform(const glm::mat3& rows, glm::vec3 pos, glm::vec4* out)
+{
+	for (int r = 0; r < 3; r++)
+		out[r] = glm::vec4(rows[r], -glm::dot(rows[r], pos));
+}
+
+inline glm::vec3 to_object(const glm::vec4* rows, glm::vec3 p)
+{
+	return glm::vec3(glm::dot(glm::vec3(rows[0]), p) + rows[0].w, glm::dot(glm::vec3(rows[1]), p) + rows[1].w, glm::dot(glm::vec3(rows[2]), p) + rows[2].w);
+}
+
+inline glm::vec3 to_object_dir(const glm::vec4* rows, glm::vec3 d)
+{
+	return glm::vec3(glm::dot(glm::vec3(rows[0]), d), glm::dot(glm::vec3(rows[1]), d), glm::dot(glm::vec3(rows[2]), d));
+}
+
+inline glm::vec3 to_world_dir(const glm::vec4* rows, glm::vec3 d)
+{
+	return glm::vec3(rows[0]) * d.x + glm::vec3(rows[1]) * d.y + glm::vec3(rows[2]) * d.z;
+}
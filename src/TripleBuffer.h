@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+
+using namespace std;
+
+// Hands the newest of a stream of values from one producer thread to one consumer
+// thread, neither ever waits. Of the three slots the producer writes the back one, the
+// consumer reads the front one and the middle one holds the last published value;
+// publish() and acquire() trade their slot for the middle one in a single exchange.
+// Values the consumer did not get to in time are skipped, it always sees the newest.
+template<typename T>
+class Triple_Buffer
+{
+public:
+	// producer, the slot to fill before publish(), holds what was in it three publishes ago
+	T& back() { return slots[backSlot]; }
+	void publish()
+	{
+		backSlot = middle.exchange(backSlot | Fresh, memory_order_acq_rel) & Slot_Mask;
+	}
+
+	// consumer, false if nothing was published since the last acquire, front() stays
+	bool acquire()
+	{
+		if (!(middle.load(memory_order_relaxed) & Fresh))
+			return false;
+		// only the consumer clears Fresh, the slot taken is published even if the
+		// producer swapped again in between
+		frontSlot = middle.exchange(frontSlot, memory_order_acq_rel) & Slot_Mask;
+		return true;
+	}
+	T& front() { return slots[frontSlot]; }
+
+private:
+	static const unsigned Slot_Mask = 3;
+	static const unsigned Fresh = 4; // the middle slot was published and not acquired yet
+
+	T slots[3];
+	atomic<unsigned> middle{ 1 };
+	unsigned backSlot = 0; // producer only
+	unsigned frontSlot = 2; // consumer only
+};
@@ -0,0 +1,393 @@
+#include "VirtualTexture.h"
+#include "GLutility.h"
+#include "FrameArena.h"
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+
+using namespace std;
+
+const uint64_t Virtual_Texture::No_Tile;
+const uint32_t Virtual_Texture::Pinned;
+
+static bool read_at(FILE* file, uint64_t offset, void* out, size_t size)
+{
+#ifdef _WIN32
+	if (_fseeki64(file, static_cast<long long>(offset), SEEK_SET) != 0)
+#else
+	if (fseeko(file, static_cast<off_t>(offset), SEEK_SET) != 0)
+#endif
+		return false;
+	return fread(out, 1, size, file) == size;
+}
+
+static uint64_t file_size(FILE* file)
+{
+#ifdef _WIN32
+	_fseeki64(file, 0, SEEK_END);
+	return static_cast<uint64_t>(_ftelli64(file));
+#else
+	fseeko(file, 0, SEEK_END);
+	return static_cast<uint64_t>(ftello(file));
+#endif
+}
+
+Virtual_Texture::Shared::~Shared()
+{
+	if (file)
+		fclose(file);
+}
+
+bool Virtual_Texture::Shared::read(uint64_t offset, void* out, size_t count)
+{
+	if (!file)
+	{
+		if (offset > packed.size() || count > packed.size() - offset)
+			return false;
+		memcpy(out, packed.data() + offset, count);
+		return true;
+	}
+	lock_guard<mutex> guard(fileLock);
+	return read_at(file, offset, out, count);
+}
+
+uint64_t Virtual_Texture::Shared::size()
+{
+	if (!file)
+		return packed.size();
+	lock_guard<mutex> guard(fileLock);
+	return file_size(file);
+}
+
+Virtual_Texture::Virtual_Texture(Thread_Pool& pool, int cachePages, int uploadsPerFrame)
+	: pool(pool), shared(make_shared<Shared>()), cachePages(cachePages), uploadsPerFrame(uploadsPerFrame)
+{
+}
+
+Virtual_Texture::~Virtual_Texture()
+{
+	glDeleteTextures(1, &cacheTex);
+	glDeleteTextures(1, &indirectionTex);
+	glDeleteBuffers(1, &indirectionTbo);
+	glDeleteTextures(1, &feedbackTex);
+	glDeleteFramebuffers(1, &feedbackFbo);
+	glDeleteBuffers(2, feedbackPbo);
+}
+
+// name as for File_System, a loose file is read with positioned reads and a file in
+// the pack through its mapping, either way only the tiles that are asked for are read in
+bool Virtual_Texture::open(const string& name)
+{
+	const File_System& files = File_System::assets();
+	string path = files.loose_path(name);
+	if (!path.empty())
+	{
+		shared->file = fopen(path.c_str(), "rb");
+		if (!shared->file)
+			return false;
+	}
+	else if (!files.open(name, shared->packed, false))
+		return false;
+
+	rvtHeader h;
+	bool ok = shared->read(0, &h, sizeof(h)) && rvt_header_valid(h);
+	if (ok)
+	{
+		levels.resize(h.levels);
+		ok = shared->read(sizeof(h), levels.data(), levels.size() * sizeof(rvtLevel)) && rvt_levels_valid(h, levels.data(), shared->size());
+	}
+	if (!ok)
+	{
+		cout << "Malformed virtual texture: " << name << endl;
+		shared = make_shared<Shared>();
+		levels.clear();
+		return false;
+	}
+	header = h;
+
+	uint32_t entries = 0;
+	for (const rvtLevel& level : levels)
+	{
+		levelFirst.push_back(entries);
+		entries += level.tilesX * level.tilesY;
+	}
+	indirection.assign(entries * 4, 0);
+	pageTile.assign(cachePages * cachePages, No_Tile);
+	pageUsed.assign(cachePages * cachePages, 0);
+
+	int size = cachePages * (header.tile + 2 * header.border);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glGenTextures(1, &cacheTex);
+	glActiveTexture(GL_TEXTURE0 + Cache_Unit);
+	glBindTexture(GL_TEXTURE_2D, cacheTex);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	glGenBuffers(1, &indirectionTbo);
+	glBindBuffer(GL_TEXTURE_BUFFER, indirectionTbo);
+	glBufferData(GL_TEXTURE_BUFFER, indirection.size(), indirection.data(), GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	glGenTextures(1, &indirectionTex);
+	glActiveTexture(GL_TEXTURE0 + Indirection_Unit);
+	glBindTexture(GL_TEXTURE_BUFFER, indirectionTex);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA8UI, indirectionTbo);
+	glActiveTexture(GL_TEXTURE0);
+
+	glGenBuffers(2, feedbackPbo);
+
+	// the single tile levels are what everything else falls back to, they are read
+	// right away and never evicted, at most half the cache
+	for (int level = static_cast<int>(levels.size()) - 1; level >= 0; level--)
+	{
+		if (levels[level].tilesX * levels[level].tilesY != 1 || static_cast<int>(resident.size()) >= cachePages * cachePages / 2)
+			break;
+		vector<unsigned char> texels(rvt_tile_bytes(header));
+		if (!shared->read(levels[level].offset, texels.data(), texels.size()))
+			break;
+		uint64_t key = tile_key(level, 0, 0);
+		place(key, texels.data());
+		pageUsed[resident[key]] = Pinned;
+	}
+
+	printf("Virtual texture '%s': %ux%u, %u levels, %ux%u tiles at level 0, %zu bytes resident\n", name.c_str(), header.width,
+		header.height, header.levels, levels[0].tilesX, levels[0].tilesY, memory_bytes());
+	return true;
+}
+
+void Virtual_Texture::bind(GL_Utility& util) const
+{
+	// the samplers are set even when nothing is open, unset samplers of different types would share unit 0
+	util.set_int("vt_cache", Cache_Unit);
+	util.set_int("vt_indirection", Indirection_Unit);
+	util.set_ivec4("vt_params", header.width, header.height, header.tile, header.border);
+	util.set_int("vt_levels", header.levels);
+}
+
+uint64_t Virtual_Texture::tile_key(int level, int x, int y)
+{
+	// level in the high bits, so keys sort coarse to fine in reverse
+	return static_cast<uint64_t>(level) << 48 | static_cast<uint64_t>(y) << 24 | static_cast<uint64_t>(x);
+}
+
+uint32_t Virtual_Texture::entry(uint64_t key) const
+{
+	int level = static_cast<int>(key >> 48);
+	uint32_t y = static_cast<uint32_t>(key >> 24) & 0xffffff, x = static_cast<uint32_t>(key) & 0xffffff;
+	return levelFirst[level] + y * levels[level].tilesX + x;
+}
+
+void Virtual_Texture::create_feedback(int width, int height)
+{
+	feedbackWidth = width;
+	feedbackHeight = height;
+	feedbackPending[0] = feedbackPending[1] = false;
+
+	if (!feedbackFbo)
+	{
+		glGenFramebuffers(1, &feedbackFbo);
+		glGenTextures(1, &feedbackTex);
+	}
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, feedbackTex);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, feedbackFbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, feedbackTex, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	for (GLuint pbo : feedbackPbo)
+	{
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+		glBufferData(GL_PIXEL_PACK_BUFFER, static_cast<size_t>(width) * height * 4, nullptr, GL_STREAM_READ);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void Virtual_Texture::render_feedback(GL_Utility& util, GLuint quadVAO)
+{
+	if (!is_open())
+		return;
+
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	int width = max(1, viewport[2] / Feedback_Scale), height = max(1, viewport[3] / Feedback_Scale);
+	if (width != feedbackWidth || height != feedbackHeight)
+		create_feedback(width, height);
+
+	// the other buffer holds the previous pass, its transfer has had a frame to finish
+	int index = pass++ & 1;
+	if (feedbackPending[index ^ 1])
+		read_feedback(index ^ 1);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, feedbackFbo);
+	glViewport(0, 0, width, height);
+	util.set_int("feedback_pass", Feedback_Scale);
+	util.draw(quadVAO);
+	util.set_int("feedback_pass", 0);
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, feedbackPbo[index]);
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	feedbackPending[index] = true;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
+// each pixel is the tile its first virtual lookup wanted: x and y low bytes,
+// their high nibbles, level + 1 (0 where nothing was sampled)
+void Virtual_Texture::read_feedback(int index)
+{
+	frame++;
+	feedbackPending[index] = false;
+
+	size_t bytes = static_cast<size_t>(feedbackWidth) * feedbackHeight * 4;
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, feedbackPbo[index]);
+	const unsigned char* p = static_cast<const unsigned char*>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT));
+	// built and consumed here, the frame arena keeps it off the heap
+	vector<uint64_t, Frame_Allocator<uint64_t>> wanted(Frame_Allocator<uint64_t>(Frame_Arena::render()));
+	if (p)
+	{
+		wanted.reserve(bytes / 4);
+		for (size_t i = 0; i < bytes; i += 4)
+		{
+			if (p[i + 3] == 0)
+				continue;
+			uint32_t level = p[i + 3] - 1u;
+			uint32_t x = p[i] | (p[i + 2] & 15u) << 8, y = p[i + 1] | (p[i + 2] >> 4u) << 8;
+			if (level < levels.size() && x < levels[level].tilesX && y < levels[level].tilesY)
+				wanted.push_back(tile_key(level, x, y));
+		}
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	// coarse tiles first, they are the fallback for the finer ones
+	sort(wanted.begin(), wanted.end(), greater<uint64_t>());
+	wanted.erase(unique(wanted.begin(), wanted.end()), wanted.end());
+	feedbackMissing = 0;
+	for (uint64_t key : wanted)
+	{
+		if (!resident.count(key))
+			feedbackMissing++;
+		request(key);
+	}
+}
+
+void Virtual_Texture::request(uint64_t key)
+{
+	// the tile and the coarser ones it falls back to stay in use
+	int level = static_cast<int>(key >> 48);
+	uint32_t y = static_cast<uint32_t>(key >> 24) & 0xffffff, x = static_cast<uint32_t>(key) & 0xffffff;
+	for (int l = level; l < static_cast<int>(levels.size()); l++, x /= 2, y /= 2)
+	{
+		auto it = resident.find(tile_key(l, x, y));
+		if (it != resident.end() && pageUsed[it->second] != Pinned)
+			pageUsed[it->second] = frame;
+	}
+
+	if (resident.count(key) || inFlight.count(key) || static_cast<int>(inFlight.size()) >= 2 * uploadsPerFrame)
+		return;
+	inFlight.insert(key);
+
+	x = static_cast<uint32_t>(key) & 0xffffff;
+	y = static_cast<uint32_t>(key >> 24) & 0xffffff;
+	size_t size = rvt_tile_bytes(header);
+	uint64_t offset = levels[level].offset + (static_cast<uint64_t>(y) * levels[level].tilesX + x) * size;
+	shared_ptr<Shared> target = shared;
+	pool.submit([target, key, offset, size]
+	{
+		Loaded tile = { key, vector<unsigned char>(size) };
+		if (!target->read(offset, tile.texels.data(), size))
+			tile.texels.clear();
+		lock_guard<mutex> guard(target->lock);
+		target->done.push_back(move(tile));
+	});
+}
+
+void Virtual_Texture::update()
+{
+	if (!is_open())
+		return;
+
+	vector<Loaded, Frame_Allocator<Loaded>> loaded(Frame_Allocator<Loaded>(Frame_Arena::render()));
+	{
+		lock_guard<mutex> guard(shared->lock);
+		int count = min(static_cast<int>(shared->done.size()), uploadsPerFrame);
+		loaded.reserve(count);
+		move(shared->done.begin(), shared->done.begin() + count, back_inserter(loaded));
+		shared->done.erase(shared->done.begin(), shared->done.begin() + count);
+	}
+
+	for (Loaded& tile : loaded)
+	{
+		inFlight.erase(tile.key);
+		if (tile.texels.empty())
+			cout << "Virtual texture tile read failed, level " << (tile.key >> 48) << endl;
+		else
+			place(tile.key, tile.texels.data());
+	}
+}
+
+// an empty page, else the least recently wanted one that the last feedback did not ask for
+int Virtual_Texture::free_page()
+{
+	int best = -1;
+	for (int page = 0; page < static_cast<int>(pageTile.size()); page++)
+	{
+		if (pageTile[page] == No_Tile)
+			return page;
+		if (pageUsed[page] < frame && (best < 0 || pageUsed[page] < pageUsed[best]))
+			best = page;
+	}
+	if (best >= 0)
+	{
+		resident.erase(pageTile[best]);
+		set_entry(pageTile[best], -1);
+		pageTile[best] = No_Tile;
+	}
+	return best;
+}
+
+void Virtual_Texture::place(uint64_t key, const unsigned char* texels)
+{
+	// with every page in use the tile is dropped, the feedback asks for it again
+	int page = free_page();
+	if (page < 0)
+		return;
+
+	int size = header.tile + 2 * header.border;
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glActiveTexture(GL_TEXTURE0 + Cache_Unit);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, (page % cachePages) * size, (page / cachePages) * size, size, size, GL_RGBA, GL_UNSIGNED_BYTE, texels);
+	glActiveTexture(GL_TEXTURE0);
+
+	pageTile[page] = key;
+	pageUsed[page] = frame;
+	resident[key] = page;
+	set_entry(key, page);
+}
+
+void Virtual_Texture::set_entry(uint64_t key, int page)
+{
+	uint32_t index = entry(key);
+	unsigned char* e = &indirection[index * 4];
+	e[0] = page < 0 ? 0 : static_cast<unsigned char>(page % cachePages);
+	e[1] = page < 0 ? 0 : static_cast<unsigned char>(page / cachePages);
+	e[2] = page < 0 ? 0 : 1;
+	glBindBuffer(GL_TEXTURE_BUFFER, indirectionTbo);
+	glBufferSubData(GL_TEXTURE_BUFFER, index * 4, 4, e);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+size_t Virtual_Texture::memory_bytes() const
+{
+	size_t page = rvt_tile_bytes(header);
+	return page * pageTile.size() + indirection.size() + static_cast<size_t>(feedbackWidth) * feedbackHeight * 4 * 3;
+}
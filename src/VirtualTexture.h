@@ -0,0 +1,115 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include "ThreadPool.h"
+#include "TextureFile.h"
+#include "FileSystem.h"
+
+using namespace std;
+
+class GL_Utility;
+
+// Sparse residency for textures too large to upload whole, read from cooked .rvt files.
+// Each frame the shader is run once more at 1/Feedback_Scale resolution into a small
+// framebuffer that records the tile and mip every pixel wants, the result is read back
+// a frame later through a pixel buffer. Missing tiles are read from disk on the worker
+// pool and copied into a fixed cache texture of pages, least recently used pages are
+// recycled. The indirection table maps tile and mip to a page, tiles that are not in
+// yet fall back to the nearest coarser resident level, the single tile levels at the
+// bottom of the chain are always resident. GPU memory is the cache and the table,
+// independent of the texture size.
+class Virtual_Texture
+{
+public:
+	static const int Cache_Unit = 2;
+	static const int Indirection_Unit = 15;
+	static const int Feedback_Scale = 8;
+
+	// cachePages along each side of the cache texture
+	explicit Virtual_Texture(Thread_Pool& pool, int cachePages = 8, int uploadsPerFrame = 16);
+	~Virtual_Texture();
+
+	Virtual_Texture(const Virtual_Texture&) = delete;
+	Virtual_Texture& operator=(const Virtual_Texture&) = delete;
+
+	// false if the file is missing or malformed, the texture then stays unused
+	bool open(const string& name);
+	bool is_open() const { return cacheTex != 0; }
+
+	// samplers and parameters for sample_Virtual, after create_shaders
+	void bind(GL_Utility& util) const;
+	// GL thread, before the frame is drawn: runs the feedback pass and reads back the previous one
+	void render_feedback(GL_Utility& util, GLuint quadVAO);
+	// GL thread, once per frame: copies streamed tiles into the cache
+	void update();
+	// every tile the last feedback read back asked for was resident and no read is in
+	// flight, what that pass saw is drawn at full detail
+	bool settled() const { return feedbackMissing == 0 && inFlight.empty(); }
+
+	size_t memory_bytes() const;
+
+private:
+	static const uint64_t No_Tile = ~0ull;
+	static const uint32_t Pinned = ~0u;
+
+	struct Loaded
+	{
+		uint64_t key;
+		vector<unsigned char> texels; // empty if the read failed
+	};
+
+	// shared with reads still in flight, which may outlive the texture
+	struct Shared
+	{
+		mutex lock;
+		deque<Loaded> done;
+		mutex fileLock; // one seek and read at a time
+		FILE* file = nullptr; // loose files
+		Asset_Span packed; // files in the pack
+
+		~Shared();
+		bool read(uint64_t offset, void* out, size_t count);
+		uint64_t size();
+	};
+
+	Thread_Pool& pool;
+	shared_ptr<Shared> shared;
+	rvtHeader header = {};
+	vector<rvtLevel> levels;
+	vector<uint32_t> levelFirst; // first indirection entry of each level
+
+	int cachePages;
+	int uploadsPerFrame;
+	vector<uint64_t> pageTile; // per page: key of the tile in it
+	vector<uint32_t> pageUsed; // per page: last frame it was asked for
+	unordered_map<uint64_t, int> resident; // tile key to page
+	unordered_set<uint64_t> inFlight;
+	vector<unsigned char> indirection; // per tile: page x, page y, resident, 0
+	uint32_t frame = 0; // feedback read backs so far
+	size_t feedbackMissing = 0; // tiles the last read back asked for that were not resident
+
+	GLuint cacheTex = 0;
+	GLuint indirectionTbo = 0, indirectionTex = 0;
+	GLuint feedbackFbo = 0, feedbackTex = 0;
+	GLuint feedbackPbo[2] = {};
+	int feedbackWidth = 0, feedbackHeight = 0;
+	bool feedbackPending[2] = {};
+	int pass = 0;
+
+	static uint64_t tile_key(int level, int x, int y);
+	uint32_t entry(uint64_t key) const;
+	void create_feedback(int width, int height);
+	void read_feedback(int index);
+	void request(uint64_t key);
+	void place(uint64_t key, const unsigned char* texels);
+	int free_page();
+	void set_entry(uint64_t key, int page);
+};
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+using namespace std;
+
+// Chase-Lev deque of pointers: the owner thread pushes and pops at the bottom, any
+// thread steals from the top, without locks. The owner works on its newest items while
+// thieves take the oldest. Capacity is a power of two, push() fails when it is full.
+template<typename T, size_t Capacity>
+class Work_Stealing_Deque
+{
+	static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+	Work_Stealing_Deque()
+	{
+		for (atomic<T*>& item : items)
+			item.store(nullptr, memory_order_relaxed);
+	}
+
+	// owner
+	bool push(T* item)
+	{
+		int64_t b = bottom.load(memory_order_relaxed);
+		int64_t t = top.load(memory_order_acquire);
+		if (b - t >= static_cast<int64_t>(Capacity))
+			return false;
+		items[b & (Capacity - 1)].store(item, memory_order_relaxed);
+		atomic_thread_fence(memory_order_release);
+		bottom.store(b + 1, memory_order_relaxed);
+		return true;
+	}
+
+	// owner, nullptr if empty or a thief took the last item
+	T* pop()
+	{
+		int64_t b = bottom.load(memory_order_relaxed) - 1;
+		bottom.store(b, memory_order_relaxed);
+		atomic_thread_fence(memory_order_seq_cst);
+		int64_t t = top.load(memory_order_relaxed);
+		if (t > b)
+		{
+			bottom.store(b + 1, memory_order_relaxed);
+			return nullptr;
+		}
+		T* item = items[b & (Capacity - 1)].load(memory_order_relaxed);
+		if (t == b)
+		{
+			// the last item, the owner and the thieves race for it on top
+			if (!top.compare_exchange_strong(t, t + 1, memory_order_seq_cst, memory_order_relaxed))
+				item = nullptr;
+			bottom.store(b + 1, memory_order_relaxed);
+		}
+		return item;
+	}
+
+	// any thread, nullptr if empty or another thread got there first
+	T* steal()
+	{
+		int64_t t = top.load(memory_order_acquire);
+		atomic_thread_fence(memory_order_seq_cst);
+		int64_t b = bottom.load(memory_order_acquire);
+		if (t >= b)
+			return nullptr;
+		T* item = items[t & (Capacity - 1)].load(memory_order_relaxed);
+		if (!top.compare_exchange_strong(t, t + 1, memory_order_seq_cst, memory_order_relaxed))
+			return nullptr;
+		return item;
+	}
+
+private:
+	// apart, thieves write top and the owner bottom; padded rather than aligned, the
+	// deque lives in heap allocated workers
+	atomic<int64_t> top{ 0 };
+	char pad[64 - sizeof(atomic<int64_t>)];
+	atomic<int64_t> bottom{ 0 };
+	atomic<T*> items[Capacity];
+};
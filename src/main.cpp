@@ -2,38 +2,42 @@
 #include <GLFW/glfw3.h>
 #include "GLutility.h"
 #include "SceneManager.h"
+#include "SceneBuilder.h"
 #include "Surface.h"
+#include "TextureLoader.h"
+#include "SceneFile.h"
+#include "SceneText.h"
+#include "SceneStreamer.h"
+#include "FileSystem.h"
+#include "ShaderReloader.h"
+#include "Simulation.h"
+#include "Animation.h"
+#include "FramePacer.h"
+#include "TileRender.h"
+#include "FrameCapture.h"
+#include "AllocationCounter.h"
+#include "FrameArena.h"
+#include "CpuRender.h"
+#include <cstring>
+#include <thread>
+#include <unistd.h>
 
 using namespace std;
 
+#ifndef COOKED_DIR
+#define COOKED_DIR ASSETS_DIR "/cooked"
+#endif
+#ifndef PACK_FILE
+#define PACK_FILE "assets.rpak"
+#endif
+#ifndef SHADER_CACHE_DIR
+#define SHADER_CACHE_DIR "shader_cache"
+#endif
+
 int screen_width = 1280;
 int screen_height = 720;
-
-int earth_spherenum = -1, box_num = -1;
-
-int scene_update_box(sceneContainer& scene, float delta_Time, float time)
-{
-	if (box_num != -1)
-	{
-		raytBox* box = &scene.boxes[box_num];
-		glm::quat q = glm::angleAxis(delta_Time, glm::vec3(0.5774, 0.5774, 0.5774));
-		box->quat_rotation *= q;
-	}
-	return 0;
-}
-
-int scene_update_earth(sceneContainer& scene, float delta_Time, float time)
-{
-	if (earth_spherenum != -1) {
-		raytSphere* earth = &scene.spheres[earth_spherenum];
-		float earthSpeed = 0.50;
-		earth->obj.x = cos(time * earthSpeed) * 2000;
-		earth->obj.z = sin(time * earthSpeed) * 2000;
-
-		earth->quat_rotation *= glm::angleAxis(delta_Time, glm::vec3(0, 1, 0));
-	}
-	return 0;
-}
+// feedback passes an offline frame waits at most for the virtual texture to settle
+static const int Max_Feedback_Passes = 128;
 
 float quadVertices[] = 
 {
@@ -46,81 +50,345 @@ float quadVertices[] =
 	-1.0f,  1.0f, 0.0f, 1.0f
 };
 
-int main()
+// Shaders, textures and models come from the pack written by the pack_assets target. With
+// LOOSE_ASSETS, or when there is no pack, the source and cooked directories are
+// mounted too and their files win over the pack's.
+static void mount_assets()
 {
-	GL_Utility glutil(screen_width, screen_height, false);
-	
-	// Setup window
-    glutil.setup_window();
-    glfwSwapInterval(1); // vsync
-
-	sceneContainer scene = {};
+	File_System& files = File_System::assets();
+#ifdef LOOSE_ASSETS
+	files.mount_pack(PACK_FILE);
+#else
+	if (files.mount_pack(PACK_FILE))
+		return;
+#endif
+	files.mount_dir("shaders/", ASSETS_DIR "/shaders");
+	files.mount_dir("textures/", ASSETS_DIR "/textures");
+	files.mount_dir("models/", ASSETS_DIR "/models");
+	files.mount_dir("cooked/", COOKED_DIR);
+}
 
+// the built in scene, assets/scenes/default.scene describes the same one
+static void create_default_scene(sceneContainer& scene, Texture_Loader& texture_loader, Animation_System& animations)
+{
 	scene.scene = Scene_Manager::createScene(screen_width, screen_height);
 	scene.scene.camera_pos = { 0, 0, -5 };
 	scene.shadow_ambient = glm::vec3{ 0.1, 0.1, 0.1 };
 	scene.ambient_color = glm::vec3{ 0.25, 0.25, 0.25 };
 
+	Scene_Builder build(scene);
+	build.reserve(3, 2, 2, 9, 9);
+
 	// lights
-	scene.lights_point.push_back(Scene_Manager::createLightPoint({ 3, 5, 0, 0.1 }, { 1, 1, 1 }, 25.5));
-	scene.lights_direct.push_back(Scene_Manager::createLightDirect({ 3, -1, 1 }, { 1, 1, 1 }, 1.5));
+	build.light_point({ 3, 5, 0, 0.1 }, { 1, 1, 1 }, 25.5);
+	build.light_direct({ 3, -1, 1 }, { 1, 1, 1 }, 1.5);
 
 	// red sphere
-	scene.spheres.push_back(Scene_Manager::createSphere({ 6.7, 0, 3.8 }, 1,
-		Scene_Manager::createMaterial({ 1, 0, 0 }, 100, 0.2), true));
+	build.sphere({ 6.7, 0, 3.8 }, 1, build.material({ 1, 0, 0 }, 100, 0.2), true);
 
 	// transparent sphere
-	scene.spheres.push_back(Scene_Manager::createSphere({ 0.5, 1, 4 }, 1,
-		Scene_Manager::createMaterial({ 0, 0, 0.8 }, 200, 0.1, 1.125, { 1, 0, 2 }, 1), true));
+	build.sphere({ 0.5, 1, 4 }, 1, build.material({ 0, 0, 0.8 }, 200, 0.1, 1.125, { 1, 0, 2 }, 1), true);
 
 
 	// earth
-	raytSphere earth = Scene_Manager::createSphere({}, 500, Scene_Manager::createMaterial({}, 0, 0.0f));
-	earth.textureNum = 1;
-	scene.spheres.push_back(earth);
-	earth_spherenum = scene.spheres.size() - 1;
+	sphereHandle earth = build.sphere({}, 500, build.material({}, 0, 0.0f));
+	build.edit(earth).textureNum = texture_loader.load_virtual("Earth Texture.jpg");
+	// orbits the scene at a distance, turning once every 2 pi seconds
+	int earth_Animation = animations.add(scene, earth);
+	animations.set_orbit(earth_Animation, {}, { 0, 1, 0 }, 2000, 0.5f);
+	animations.set_spin(earth_Animation, { 0, 1, 0 }, 1);
 
 	// cylinder
-	raytMaterial cylinder_Material = Scene_Manager::createMaterial({ 150 / 255.0f, 255 / 255.0f, 50 / 255.0f }, 200, 0.2);
-	raytSurface cylinder = Surfaces::Elliptic_Cylinder(1 / 2.0f, 1 / 2.0f, cylinder_Material);
+	materialHandle cylinder_Material = build.material({ 150 / 255.0f, 255 / 255.0f, 50 / 255.0f }, 200, 0.2);
+	raytSurface& cylinder = build.edit(build.surface(Surfaces::Elliptic_Cylinder(1 / 2.0f, 1 / 2.0f, cylinder_Material.index)));
 	cylinder.pos = { -2, 0, 6 };
 	cylinder.quat_rotation = glm::quat(glm::vec3(glm::radians(90.f), 0, 0));
 	cylinder.yMin = -1;
 	cylinder.yMax = 1;
-	scene.surfaces.push_back(cylinder);
 
 	// cone
-	raytMaterial cone_Material = Scene_Manager::createMaterial({ 210 / 255.0f, 30 / 255.0f, 60 / 255.0f }, 200, 0.2);
-	raytSurface cone = Surfaces::Elliptic_Cone(1 / 3.0f, 1 / 3.0f, 1, cone_Material);
+	materialHandle cone_Material = build.material({ 210 / 255.0f, 30 / 255.0f, 60 / 255.0f }, 200, 0.2);
+	raytSurface& cone = build.edit(build.surface(Surfaces::Elliptic_Cone(1 / 3.0f, 1 / 3.0f, 1, cone_Material.index)));
 	cone.pos = { -6, 4, 6 };
 	cone.quat_rotation = glm::quat(glm::vec3(glm::radians(90.f), 0, 0));
 	cone.yMin = -1;
 	cone.yMax = 4;
-	scene.surfaces.push_back(cone);
 
 	// floor
-	scene.boxes.push_back(Scene_Manager::createBox({ 0, -1.2, 6 }, { 10, 0.2, 5 },
-		Scene_Manager::createMaterial({ 0.9, 0.7, 0 }, 100, 0.15)));
+	build.box({ 0, -1.2, 6 }, { 10, 0.2, 5 }, build.material({ 0.9, 0.7, 0 }, 100, 0.15));
 
 	// box
-	raytBox box = Scene_Manager::createBox({ 4.2, 1, 6 }, { 1, 1, 1 },
-		Scene_Manager::createMaterial({}, 50, 0.0));
-	box.textureNum = 2;
-	scene.boxes.push_back(box);
-	box_num = scene.boxes.size() - 1;
+	boxHandle box = build.box({ 4.2, 1, 6 }, { 1, 1, 1 }, build.material({}, 50, 0.0));
+	build.edit(box).textureNum = texture_loader.load("container.png");
+	animations.set_spin(animations.add(scene, box), { 1, 1, 1 }, 1);
 
-	raytDefines defines = scene.get_defines();
-	glutil.create_shaders(defines);
+	// icosahedron instances sharing one mesh, the model is an asset like the textures
+	const char* model = "models/icosahedron.obj";
+	Asset_Span file;
+	Mesh icosahedron;
+	if (!File_System::assets().open(model, file))
+		printf("Mesh failed to load: %s\n", model);
+	else if (Mesh::load_obj_from_memory(model, reinterpret_cast<const char*>(file.data()), file.size(), icosahedron))
+	{
+		meshHandle geometry = build.mesh(move(icosahedron));
+		materialHandle blue = build.material({ 0.2, 0.6, 0.9 }, 150, 0.25);
+		materialHandle white = build.material({ 0.9, 0.9, 0.9 }, 50, 0.05);
+
+		build.mesh_instance(geometry, { 2.4, -0.05, 8 }, blue);
+		build.mesh_instances(8, [geometry, white](size_t i, raytMeshInstance& instance)
+		{
+			instance.geometry = geometry.index;
+			instance.pos = { -8 + i * 2.3f, -0.05, 10.5 };
+			instance.material = white.index;
+			instance.quat_rotation = glm::angleAxis(i * 0.7f, glm::vec3(0, 1, 0));
+		});
+	}
+}
+
+// .rscn files stream in while rendering, anything else is parsed as a text description
+static bool load_scene_file(const string& path, sceneContainer& scene, Texture_Loader& texture_loader, Scene_Streamer& streamer)
+{
+	bool binary = path.size() > 5 && path.compare(path.size() - 5, 5, ".rscn") == 0;
+	if (!(binary ? streamer.open(path.c_str(), scene) : parse_scene_text(path.c_str(), scene)))
+		return false;
+	scene.scene.canvas_width = screen_width;
+	scene.scene.canvas_height = screen_height;
+
+	// textureNums in the file index scene.textures, point them at what the loader hands out
+	vector<int> remap(1, 0);
+	for (const sceneTexture& texture : scene.textures)
+		remap.push_back(texture.streamed ? texture_loader.load_virtual(texture.name) : texture_loader.load(texture.name));
+	for (raytSphere& sphere : scene.spheres)
+		sphere.textureNum = sphere.textureNum > 0 && sphere.textureNum < static_cast<int>(remap.size()) ? remap[sphere.textureNum] : 0;
+	for (raytBox& box : scene.boxes)
+		box.textureNum = box.textureNum > 0 && box.textureNum < static_cast<int>(remap.size()) ? remap[box.textureNum] : 0;
+	streamer.remap_textures(remap);
+	return true;
+}
+
+// the coordinator of --tiles, starts the workers and writes the frames they render
+static int coordinate_tiles(int workers, const string& socketPath, int tileSize, int frames, float fps, const char* output,
+	const char* scenePath, bool cpu)
+{
+	Tile_Coordinator coordinator(tileSize);
+	if (!coordinator.listen(socketPath))
+		return 1;
+	vector<string> args = { "--worker", socketPath };
+	if (cpu)
+		args.push_back("--cpu");
+	if (scenePath)
+		args.push_back(scenePath);
+	bool ok = coordinator.spawn(workers, args) && coordinator.render(frames, fps, output);
+	coordinator.close();
+	return ok ? 0 : 1;
+}
+
+static void stream_whole_scene(sceneContainer& scene, Scene_Streamer& streamer)
+{
+	while (!streamer.done())
+	{
+		streamer.update(scene);
+		this_thread::yield();
+	}
+}
+
+// brings the scene to time for an offline frame, with the whole scene streamed in and
+// every texture resident
+static void prepare_offline_frame(sceneContainer& scene, float time, bool first, Scene_Manager& scene_manager, GL_Utility& glutil,
+	Thread_Pool& workers, Texture_Loader& texture_loader, Animation_System& animations, Scene_Streamer& streamer, GLuint quadVAO)
+{
+	stream_whole_scene(scene, streamer);
+	animations.update(scene, time);
+	scene_manager.update(&scene, first ? static_cast<unsigned>(DIRTY_ALL) : scene.dirty);
+	scene.dirty = 0;
+	// every round of uploads and feedback counts as a frame of the arena
+	do
+	{
+		Frame_Arena::render().begin_frame();
+		workers.run_main_jobs();
+		texture_loader.update();
+		this_thread::sleep_for(chrono::milliseconds(1));
+	} while (texture_loader.pending());
+	// the virtual texture pages in what the feedback passes of this frame's scene ask for,
+	// until a pass asks for nothing that is not resident. A pass is read back during the
+	// next one, so the first to count is the second; the bound covers a view that wants
+	// more tiles than the cache holds
+	for (int pass = 0; pass < Max_Feedback_Passes; pass++)
+	{
+		Frame_Arena::render().begin_frame();
+		texture_loader.render_feedback(glutil, quadVAO);
+		glFinish();
+		workers.run_main_jobs();
+		texture_loader.update();
+		if (pass > 0 && texture_loader.virtual_settled())
+			break;
+		this_thread::sleep_for(chrono::milliseconds(1));
+	}
+}
 
-	Scene_Manager scene_manager(screen_width, screen_height, &scene, &glutil);
+// the same for a frame drawn on the CPU
+static void prepare_cpu_frame(sceneContainer& scene, float time, bool first, Cpu_Renderer& renderer, Animation_System& animations,
+	Scene_Streamer& streamer)
+{
+	stream_whole_scene(scene, streamer);
+	animations.update(scene, time);
+	renderer.update(scene, first ? static_cast<unsigned>(DIRTY_ALL) : scene.dirty);
+	scene.dirty = 0;
+	scene.clear_patches();
+}
+
+// a worker of --tiles, draws the tiles the coordinator hands out until it is done, with
+// the fragment shader or with cpu on the CPU
+static int render_tiles(const char* socketPath, bool cpu, sceneContainer& scene, GL_Utility& glutil, Thread_Pool& workers,
+	Texture_Loader& texture_loader, Animation_System& animations, Scene_Streamer& streamer, GLuint quadVAO)
+{
+	Tile_Worker tiles;
+	if (!tiles.connect(socketPath, scene.scene.canvas_width, scene.scene.canvas_height))
+		return 1;
+	Scene_Manager scene_manager(scene.scene.canvas_width, scene.scene.canvas_height, &scene, &glutil);
+	Cpu_Renderer cpu_renderer(workers);
+	vector<unsigned char> tilePixels;
+	if (!cpu)
+		scene_manager.init();
+
+	tileMessage job;
+	int frame = -1;
+	while (tiles.next(job))
+	{
+		if (job.frame != frame)
+		{
+			if (cpu)
+				prepare_cpu_frame(scene, job.time, frame < 0, cpu_renderer, animations, streamer);
+			else
+				prepare_offline_frame(scene, job.time, frame < 0, scene_manager, glutil, workers, texture_loader, animations,
+					streamer, quadVAO);
+			frame = job.frame;
+		}
+
+		if (cpu)
+		{
+			tilePixels.resize(static_cast<size_t>(job.width) * job.height * 4);
+			cpu_renderer.render(scene, job.x, job.y, job.width, job.height, tilePixels.data());
+			if (!tiles.finish_tile(job, tilePixels.data()))
+				return 1;
+			continue;
+		}
+		tiles.begin_tile(job);
+		glutil.draw(quadVAO);
+		if (!tiles.finish_tile(job))
+			return 1;
+	}
+	return 0;
+}
+
+// --batch, frames of the animated scene straight to image files
+static int render_batch(int frames, float fps, const string& output, sceneContainer& scene, GL_Utility& glutil, Thread_Pool& workers,
+	Texture_Loader& texture_loader, Animation_System& animations, Scene_Streamer& streamer, GLuint quadVAO)
+{
+	Frame_Capture capture(workers, scene.scene.canvas_width, scene.scene.canvas_height, output);
+	if (!capture.init())
+		return 1;
+	Scene_Manager scene_manager(scene.scene.canvas_width, scene.scene.canvas_height, &scene, &glutil);
 	scene_manager.init();
 
-	auto earth_Tex = glutil.load_texture(1, "Earth Texture.jpg", "texture_sphere_1");
-	auto box_Tex = glutil.load_texture(2, "container.png", "texture_box");
+	auto start = chrono::steady_clock::now();
+	for (int frame = 0; frame < frames; frame++)
+	{
+		prepare_offline_frame(scene, frame / fps, frame == 0, scene_manager, glutil, workers, texture_loader, animations, streamer,
+			quadVAO);
+		capture.begin_frame();
+		glutil.draw(quadVAO);
+		capture.end_frame();
+	}
+	bool ok = capture.finish();
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	printf("Batch: %d frames in %.2f s, %.2f frames/s\n", frames, seconds, frames / seconds);
+	workers.report();
+	return ok ? 0 : 1;
+}
+
+int main(int argc, char** argv)
+{
+	// rt [--frames-in-flight n] [--record input.rinp | --replay input.rinp] [scene]
+	// rt --tiles workers [--cpu] [--frames n] [--fps f] [--tile-size n] [--socket path] [--output prefix] [scene]
+	// rt --batch [--frames n] [--fps f] [--output prefix.png | prefix.exr] [scene]
+	const char* scenePath = nullptr;
+	const char* recordPath = nullptr;
+	const char* replayPath = nullptr;
+	const char* workerSocket = nullptr;
+	int framesInFlight = -1;
+	int tileWorkers = -1;
+	bool batch = false;
+	bool cpu = false;
+	int tileSize = 128;
+	int frames = 1;
+	float fps = 30;
+	string socketPath = "/tmp/rt_tiles_" + to_string(getpid()) + ".sock";
+	const char* output = "frame";
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--frames-in-flight") == 0 && i + 1 < argc)
+			framesInFlight = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+			recordPath = argv[++i];
+		else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+			replayPath = argv[++i];
+		else if (strcmp(argv[i], "--tiles") == 0 && i + 1 < argc)
+			tileWorkers = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--batch") == 0)
+			batch = true;
+		else if (strcmp(argv[i], "--cpu") == 0)
+			cpu = true;
+		else if (strcmp(argv[i], "--worker") == 0 && i + 1 < argc)
+			workerSocket = argv[++i];
+		else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+			frames = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc)
+			fps = static_cast<float>(atof(argv[++i]));
+		else if (strcmp(argv[i], "--tile-size") == 0 && i + 1 < argc)
+			tileSize = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--socket") == 0 && i + 1 < argc)
+			socketPath = argv[++i];
+		else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+			output = argv[++i];
+		else
+			scenePath = argv[i];
+	}
 
-	float current_Time = glfwGetTime();
-	float last_Frame = current_Time;
-	float frames_Count = 0;
+	// the coordinator only splits and composites, it has no context of its own
+	if (fps <= 0)
+		fps = 30;
+	if (tileWorkers >= 0)
+		return coordinate_tiles(tileWorkers, socketPath, tileSize, frames, fps, output, scenePath, cpu);
+
+	mount_assets();
+	GL_Utility glutil(screen_width, screen_height, false);
+	
+	// Setup window
+    glutil.setup_window(!workerSocket && !batch);
+    glfwSwapInterval(1); // vsync
+	glutil.open_program_cache(SHADER_CACHE_DIR);
+
+	// textures decode in the background, until then they sample a placeholder
+	Thread_Pool workers;
+	Texture_Loader texture_loader(workers);
+	// animation batches share the workers with texture decoding
+	Animation_System animations(workers);
+
+	sceneContainer scene = {};
+	Scene_Streamer streamer;
+
+	if (scenePath)
+	{
+		if (!load_scene_file(scenePath, scene, texture_loader, streamer))
+			return 1;
+	}
+	else
+		create_default_scene(scene, texture_loader, animations);
+
+	raytDefines defines = scene.get_defines();
+	glutil.create_shaders(defines);
+	texture_loader.bind(glutil);
 
 	// quad VAO
 	GLuint quadVAO, quadVBO;
@@ -135,26 +403,74 @@ int main()
 	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
 	glBindVertexArray(0);
 
+	if (workerSocket || batch)
+	{
+		// offline frames show the view the interactive renderer starts with
+		scene.scene.quat_camera_rotation = cameraState().rotation();
+		int status = workerSocket ? render_tiles(workerSocket, cpu, scene, glutil, workers, texture_loader, animations, streamer, quadVAO)
+			: render_batch(frames, fps, output, scene, glutil, workers, texture_loader, animations, streamer, quadVAO);
+		glfwDestroyWindow(glutil.window);
+		glfwTerminate();
+		return status;
+	}
+
+	// the scene is updated on the simulation thread from here on, the render loop draws
+	// the newest snapshot of it
+	Simulation simulation(scene);
+	simulation.add_update([&animations](sceneContainer& scene, float, float time) { animations.update(scene, time); });
+	simulation.add_update([&streamer](sceneContainer& scene, float, float) { streamer.update(scene); });
+	if (replayPath)
+	{
+		if (!simulation.replay(replayPath))
+			return 1;
+		// frame times of a replay are measured without waiting for vsync
+		glfwSwapInterval(0);
+	}
+	else if (recordPath && !simulation.record(recordPath))
+		return 1;
+	simulation.start();
+
+	unsigned dirty;
+	Scene_Manager scene_manager(screen_width, screen_height, &simulation.acquire(dirty).scene, &glutil);
+	scene_manager.init();
+	simulation.init_input(glutil.window);
+
+	// edits to the loose shaders are rebuilt in the background and swapped in
+	Shader_Reloader shader_reloader(glutil);
+	shader_reloader.start();
+
+	Frame_Pacer pacer(framesInFlight);
+	Allocation_Counter allocation_counter;
 	while (!glfwWindowShouldClose(glutil.window))
 	{
-		frames_Count++;
-		float new_Time = glfwGetTime();
-		float delta_Time = new_Time - current_Time;
-		current_Time = new_Time;
-
-		scene_update_box(scene, delta_Time, new_Time);
-		scene_update_earth(scene, delta_Time, new_Time);
-		scene_manager.update(delta_Time);
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, earth_Tex);
-		glActiveTexture(GL_TEXTURE2);
-		glBindTexture(GL_TEXTURE_2D, box_Tex);
+		pacer.begin_frame();
+		Frame_Arena::render().begin_frame();
+		shader_reloader.update();
 
+		// input as late as possible, the cursor turns the camera of this very frame
+		glfwPollEvents();
+		sceneSnapshot& snapshot = simulation.acquire(dirty);
+		if (simulation.finished())
+			break;
+		simulation.latch_input(snapshot);
+		scene_manager.update(&snapshot.scene, dirty);
+		// GL work the jobs finished for this frame, decoded textures among it
+		workers.run_main_jobs();
+		texture_loader.update();
+
+		texture_loader.render_feedback(glutil, quadVAO);
 		glutil.draw(quadVAO);
 
 		glfwSwapBuffers(glutil.window);
-		glfwPollEvents();
+		pacer.presented(simulation.take_shown_input(snapshot));
+		allocation_counter.frame();
 	}
+	shader_reloader.stop();
+	simulation.stop();
+	pacer.report();
+	workers.report();
+	Frame_Arena::render().report();
+	allocation_counter.report();
     glfwDestroyWindow(glutil.window);
     glfwTerminate();   // close window
 
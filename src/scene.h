@@ -1,21 +1,45 @@
 #pragma once
 
 #include <vector>
+#include <string>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
+#include "Mesh.h"
+#include "SlotMap.h"
 
 using namespace std;
 
+// optional parts of the fragment shader, a variant is compiled with only the ones set
+enum shaderFeatures
+{
+	// used by the scene
+	FEATURE_REFRACTION = 1 << 0,
+	FEATURE_TEXTURES = 1 << 1,
+	FEATURE_SURFACES = 1 << 2,
+	FEATURE_LIGHTS_DIRECT = 1 << 3,
+	// quality switches, the last three only matter with refraction
+	FEATURE_SHADOWS = 1 << 4,
+	FEATURE_FRESNEL = 1 << 5,
+	FEATURE_TOTAL_INTERNAL_REFLECTION = 1 << 6,
+	FEATURE_REFRACTION_FREE_ITERATION = 1 << 7, // a refraction does not use up an iteration
+};
+
 struct raytDefines
 {
 	int sphere_size;
 	int surface_size;
 	int box_size;
+	int mesh_instance_size;
+	int material_size;
 	int light_point_size;
 	int light_direct_size;
 	int iterations;
 	glm::vec3 ambient_color;
 	glm::vec3 shadow_ambient;
+	unsigned features; // shaderFeatures
 };
 
 typedef struct {
@@ -44,34 +68,37 @@ typedef struct {
 
 	int canvas_height;
 	int reflect_depth;
-	float _padding[2];
+	// how many of the compiled in array sizes are filled, set by Scene_Manager
+	int sphere_count;
+	int box_count;
+
+	int mesh_instance_count;
+	float _padding[3];
 } raytScene;
 
 typedef struct {
-	raytMaterial material;
 	glm::vec4 obj; // pos + radius
 	glm::quat quat_rotation = glm::quat(1, 0, 0, 0);
 	int textureNum;
 	bool hollow;
-	float _padding[2];
+	int material; // index into sceneContainer::materials
+	float _p1;
 } raytSphere;
 
 typedef struct {
-	raytMaterial mat;
 	glm::quat quat_rotation = glm::quat(1, 0, 0, 0);
 	glm::vec3 pos; 
-	float _p1;
+	int material;
 	glm::vec3 form;
 	int textureNum;
 } raytBox;
 
 typedef struct {
-	raytMaterial mat;
 	glm::quat quat_rotation = glm::quat(1, 0, 0, 0);
 	float xMin = -FLT_MAX;
 	float yMin = -FLT_MAX;
 	float zMin = -FLT_MAX;
-	float _p0;
+	int material;
 	float xMax = FLT_MAX;
 	float yMax = FLT_MAX;
 	float zMax = FLT_MAX;
@@ -87,8 +114,116 @@ typedef struct {
 	float _padding[3];
 } raytSurface;
 
+// 48 bytes, uploaded as three RGBA32F texels
+typedef struct {
+	glm::quat quat_rotation = glm::quat(1, 0, 0, 0);
+	glm::vec3 pos;
+	int geometry; // index into sceneContainer::mesh_data
+
+	int material; // index into sceneContainer::materials
+	// filled in when the mesh buffers are uploaded
+	int node_offset;
+	int tri_offset;
+	int vertex_offset;
+} raytMeshInstance;
+
 typedef enum { sphere, light } primitiveType;
 
+// which sceneContainer arrays changed since the last upload
+enum dirtyFlags {
+	DIRTY_SPHERES = 1 << 0,
+	DIRTY_SURFACES = 1 << 1,
+	DIRTY_BOXES = 1 << 2,
+	DIRTY_MESH_INSTANCES = 1 << 3,
+	DIRTY_MATERIALS = 1 << 4,
+	DIRTY_LIGHTS = 1 << 5,
+	DIRTY_ALL = 0xff
+};
+
+// the elements [first, end) of one of the arrays
+struct sceneRange
+{
+	uint32_t first = 0;
+	uint32_t end = 0;
+
+	bool empty() const { return first >= end; }
+};
+
+// The changed elements of one array as disjoint ranges in order, each uploaded on its
+// own. Ranges closer than Merge_Gap are joined, one upload costs more than a few
+// elements more; past Max_Ranges the two closest neighbours are joined, so an edit at
+// either end of a large array still uploads two small ranges and not all in between.
+struct sceneRangeList
+{
+	static const int Max_Ranges = 8;
+	static const uint32_t Merge_Gap = 16;
+
+	int count = 0;
+	sceneRange ranges[Max_Ranges + 1]; // one over while adding
+
+	bool empty() const { return count == 0; }
+	const sceneRange* begin() const { return ranges; }
+	const sceneRange* end() const { return ranges + count; }
+	void clear() { count = 0; }
+
+	void add(sceneRange range)
+	{
+		if (range.empty())
+			return;
+		// the ranges before do not come near range, those from first to last are joined into it
+		int first = 0;
+		while (first < count && static_cast<uint64_t>(ranges[first].end) + Merge_Gap < range.first)
+			first++;
+		int last = first;
+		while (last < count && ranges[last].first <= static_cast<uint64_t>(range.end) + Merge_Gap)
+		{
+			range.first = min(range.first, ranges[last].first);
+			range.end = max(range.end, ranges[last].end);
+			last++;
+		}
+		if (last == first)
+		{
+			for (int i = count; i > first; i--)
+				ranges[i] = ranges[i - 1];
+			count++;
+		}
+		else
+		{
+			for (int i = last; i < count; i++)
+				ranges[i - (last - first - 1)] = ranges[i];
+			count -= last - first - 1;
+		}
+		ranges[first] = range;
+
+		if (count > Max_Ranges)
+		{
+			int closest = 0;
+			for (int i = 1; i + 1 < count; i++)
+				if (ranges[i + 1].first - ranges[i].end < ranges[closest + 1].first - ranges[closest].end)
+					closest = i;
+			ranges[closest].end = ranges[closest + 1].end;
+			for (int i = closest + 1; i + 1 < count; i++)
+				ranges[i] = ranges[i + 1];
+			count--;
+		}
+	}
+
+	void add(const sceneRangeList& other)
+	{
+		for (const sceneRange& range : other)
+			add(range);
+	}
+};
+
+// 0 to 7, the index of a single DIRTY_ flag
+inline int dirty_bit(unsigned flag)
+{
+	int bit = 0;
+	while (bit < 7 && !(flag & (1u << bit)))
+		bit++;
+	return bit;
+}
+
 struct raytLightDirect {
 	glm::vec3 direction; 
 	float _p1;
@@ -107,6 +242,34 @@ struct raytLightPoint {
 	float _padding[2];
 };
 
+// an object of a sceneContainer as handed out by Scene_Builder, it keeps referring to
+// the same object while others are added and removed. For the arrays with a Slot_Map
+// index is the slot, materials and meshes are never removed and use their array index
+template<typename T>
+struct sceneHandle
+{
+	int index = -1;
+	uint32_t generation = 0;
+
+	sceneHandle() = default;
+	explicit sceneHandle(int index, uint32_t generation = 0) : index(index), generation(generation) {}
+	bool valid() const { return index >= 0; }
+};
+
+typedef sceneHandle<raytSphere> sphereHandle;
+typedef sceneHandle<raytSurface> surfaceHandle;
+typedef sceneHandle<raytBox> boxHandle;
+typedef sceneHandle<raytMeshInstance> meshInstanceHandle;
+typedef sceneHandle<raytMaterial> materialHandle;
+typedef sceneHandle<Mesh> meshHandle;
+
+// a texture the scene's textureNums refer to, loaded through Texture_Loader
+struct sceneTexture
+{
+	string name; // relative to assets/textures
+	bool streamed; // load_virtual instead of load
+};
+
 struct sceneContainer
 {
 	raytScene scene;
@@ -115,17 +278,122 @@ struct sceneContainer
 	vector<raytSphere> spheres;
 	vector<raytSurface> surfaces;
 	vector<raytBox> boxes;
+	vector<raytMeshInstance> mesh_instances;
+	vector<Mesh> mesh_data;
+	vector<raytMaterial> materials;
+	unordered_multimap<size_t, int> material_lookup;
 	vector<raytLightPoint> lights_point;
 	vector<raytLightDirect> lights_direct;
+	vector<sceneTexture> textures; // textureNum i + 1 is textures[i], for scenes loaded from files
+	unsigned dirty = DIRTY_ALL;
+	// DIRTY_ bits of arrays of which only patches[bit] changed, see patch(); a dirty bit
+	// set as well means the whole array
+	unsigned patched = 0;
+	sceneRangeList patches[8];
+	// handles of spheres, surfaces, boxes and mesh instances, see Scene_Builder
+	Slot_Map sphere_slots;
+	Slot_Map surface_slots;
+	Slot_Map box_slots;
+	Slot_Map mesh_instance_slots;
+	// room the shader and buffers are sized for, for arrays that grow while the scene streams in
+	size_t sphere_capacity = 0;
+	size_t box_capacity = 0;
+	size_t mesh_instance_capacity = 0;
+
+	// elements [first, end) of the array of flag changed, or only its length if the range
+	// is empty; uploads then go to just that part of the buffers
+	void patch(unsigned flag, size_t first, size_t end)
+	{
+		sceneRange range;
+		range.first = static_cast<uint32_t>(first);
+		range.end = static_cast<uint32_t>(end);
+		patches[dirty_bit(flag)].add(range);
+		patched |= flag;
+	}
+
+	void clear_patches()
+	{
+		patched = 0;
+		for (sceneRangeList& list : patches)
+			list.clear();
+	}
+
+	// slots for objects appended to the arrays directly, by loaders and the streamer
+	void sync_slots()
+	{
+		sphere_slots.sync(spheres.size());
+		surface_slots.sync(surfaces.size());
+		box_slots.sync(boxes.size());
+		mesh_instance_slots.sync(mesh_instances.size());
+	}
+
+	// the arrays that grow while streaming take all they will hold up front, appends and
+	// the copies into snapshots then never reallocate them
+	void reserve_capacity()
+	{
+		spheres.reserve(sphere_capacity);
+		boxes.reserve(box_capacity);
+		mesh_instances.reserve(mesh_instance_capacity);
+	}
 
 	raytDefines get_defines()
 	{
-		int sphs = static_cast<int>(spheres.size());
+		int sphs = static_cast<int>(max(spheres.size(), sphere_capacity));
 	    int surs = static_cast<int>(surfaces.size());
-	    int boxs = static_cast<int>(boxes.size());
+	    int boxs = static_cast<int>(max(boxes.size(), box_capacity));
+	    int mshs = static_cast<int>(max(mesh_instances.size(), mesh_instance_capacity));
+	    int mats = static_cast<int>(materials.size());
 	    int lps = static_cast<int>(lights_point.size());
 	    int lds = static_cast<int>(lights_direct.size());
 
-		return { sphs, surs, boxs, lps, lds, scene.reflect_depth, ambient_color, shadow_ambient };
+		return { sphs, surs, boxs, mshs, mats, lps, lds, scene.reflect_depth, ambient_color, shadow_ambient, get_features() };
+	}
+
+	// what the shader needs for this scene, the materials, lights, surfaces and the texture
+	// list are complete before the shader is built, also for a streamed scene
+	unsigned get_features() const
+	{
+		unsigned features = FEATURE_SHADOWS;
+		for (const raytMaterial& material : materials)
+			if (material.refract > 0)
+				features |= FEATURE_REFRACTION | FEATURE_FRESNEL | FEATURE_TOTAL_INTERNAL_REFLECTION |
+					FEATURE_REFRACTION_FREE_ITERATION;
+		if (!textures.empty())
+			features |= FEATURE_TEXTURES;
+		for (const raytSphere& sphere : spheres)
+			if (sphere.textureNum != 0)
+				features |= FEATURE_TEXTURES;
+		for (const raytBox& box : boxes)
+			if (box.textureNum != 0)
+				features |= FEATURE_TEXTURES;
+		if (!surfaces.empty())
+			features |= FEATURE_SURFACES;
+		if (!lights_direct.empty())
+			features |= FEATURE_LIGHTS_DIRECT;
+		return features;
+	}
+
+	static size_t material_hash(const raytMaterial& material)
+	{
+		size_t hash = 14695981039346656037ull;
+		const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&material);
+		for (size_t i = 0; i < sizeof(raytMaterial); i++)
+			hash = (hash ^ bytes[i]) * 1099511628211ull;
+		return hash;
+	}
+
+	// identical materials share one entry
+	int add_material(const raytMaterial& material)
+	{
+		size_t hash = material_hash(material);
+		auto range = material_lookup.equal_range(hash);
+		for (auto it = range.first; it != range.second; ++it)
+			if (memcmp(&materials[it->second], &material, sizeof(raytMaterial)) == 0)
+				return it->second;
+
+		materials.push_back(material);
+		int index = static_cast<int>(materials.size()) - 1;
+		material_lookup.insert({ hash, index });
+		return index;
 	}
 };
\ No newline at end of file
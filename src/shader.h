@@ -19,24 +19,49 @@ public:
 	}
 	
 	void createShader(const char* vertexSrc, const char* fragmentSrc) {
+		std::string errors;
+		ID = build(vertexSrc, fragmentSrc, errors);
+		if (!ID)
+		{
+			std::cout << errors << std::endl;
+			exit(1);
+		}
+	}
+
+	// the linked program, or 0 with the compile or link log in errors
+	static unsigned int build(const char* vertexSrc, const char* fragmentSrc, std::string& errors) {
 		// 2. compile shaders
 		unsigned int vertex, fragment;
 		// vertex shader
 		vertex = glCreateShader(GL_VERTEX_SHADER);
 		glShaderSource(vertex, 1, &vertexSrc, NULL);
 		glCompileShader(vertex);
-		checkCompileErrors(vertex, "VERTEX");
 		// fragment Shader
 		fragment = glCreateShader(GL_FRAGMENT_SHADER);
 		glShaderSource(fragment, 1, &fragmentSrc, NULL);
 		glCompileShader(fragment);
-		checkCompileErrors(fragment, "FRAGMENT");
+		if (!checkCompileErrors(vertex, "VERTEX", errors) || !checkCompileErrors(fragment, "FRAGMENT", errors))
+		{
+			glDeleteShader(vertex);
+			glDeleteShader(fragment);
+			return 0;
+		}
 		// shader Program
-		ID = glCreateProgram();
-		glAttachShader(ID, vertex);
-		glAttachShader(ID, fragment);
-		glLinkProgram(ID);
-		checkCompileErrors(ID, "PROGRAM");
+		unsigned int program = glCreateProgram();
+		glAttachShader(program, vertex);
+		glAttachShader(program, fragment);
+		// lets Shader_Cache read the binary back on drivers that need to be told
+		if (glProgramParameteri)
+			glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		glLinkProgram(program);
+		glDeleteShader(vertex);
+		glDeleteShader(fragment);
+		if (!checkCompileErrors(program, "PROGRAM", errors))
+		{
+			glDeleteProgram(program);
+			return 0;
+		}
+		return program;
 	}
 
 	// activate the shader
@@ -50,10 +75,15 @@ public:
 		glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
 	}
 
+	void setIVec4(const std::string& name, int x, int y, int z, int w) const
+	{
+		glUniform4i(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+	}
+
 private:
 	// utility function for checking shader compilation/linking errors.
 	// ------------------------------------------------------------------------
-	void checkCompileErrors(unsigned int shader, std::string type)
+	static bool checkCompileErrors(unsigned int shader, std::string type, std::string& errors)
 	{
 		int success;
 		char infoLog[1024];
@@ -63,8 +93,7 @@ private:
 			if (!success)
 			{
 				glGetProgramInfoLog(shader, 1024, NULL, infoLog);
-				std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
-				exit(1);
+				errors = "ERROR::PROGRAM_LINKING_ERROR of type: " + type + "\n" + infoLog + "\n -- --------------------------------------------------- -- ";
 			} 
 		}
 		else
@@ -73,10 +102,10 @@ private:
 			if (!success)
 			{
 				glGetShaderInfoLog(shader, 1024, NULL, infoLog);
-				std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
-				exit(1);
+				errors = "ERROR::SHADER_COMPILATION_ERROR of type: " + type + "\n" + infoLog + "\n -- --------------------------------------------------- -- ";
 			}
 		}
+		return success != 0;
 	}
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,342 @@
+// Test for the CPU render path: the intersection routines of Scene_Geometry, Mesh and
+// Instance_Tree against brute force references written from scratch here, the shadow
+// test against the closest hit, and Cpu_Renderer drawing the same pixels whole and in
+// tiles. Every run uses the same seed.
+//
+//   cpu_render_test
+
+#include <cstdio>
+#include <cmath>
+#include <cfloat>
+#include <random>
+#include <vector>
+#include "SceneBuilder.h"
+#include "SceneGeometry.h"
+#include "CpuRender.h"
+
+using namespace std;
+
+static int failures = 0;
+
+static void check(bool ok, const char* what)
+{
+	if (!ok)
+	{
+		printf("FAILED: %s\n", what);
+		failures++;
+	}
+}
+
+static mt19937 rng(1234);
+
+static float uniform(float lo, float hi)
+{
+	return uniform_real_distribution<float>(lo, hi)(rng);
+}
+
+static glm::vec3 random_vec3(float lo, float hi)
+{
+	return glm::vec3(uniform(lo, hi), uniform(lo, hi), uniform(lo, hi));
+}
+
+static glm::quat random_rotation()
+{
+	return glm::normalize(glm::quat(uniform(-1, 1), uniform(-1, 1), uniform(-1, 1), uniform(-1, 1)));
+}
+
+// a ray from a point on a sphere of radius around the origin towards a point near it
+static void random_ray(float radius, glm::vec3& ro, glm::vec3& rd)
+{
+	ro = glm::normalize(random_vec3(-1, 1)) * radius;
+	rd = glm::normalize(random_vec3(-radius / 4, radius / 4) - ro);
+}
+
+static bool ref_sphere(glm::vec3 ro, glm::vec3 rd, glm::vec3 center, float radius, float& t)
+{
+	glm::vec3 oc = ro - center;
+	float b = glm::dot(oc, rd);
+	float disc = b * b - (glm::dot(oc, oc) - radius * radius);
+	if (disc < 0)
+		return false;
+	t = -b - sqrt(disc);
+	return t > 0;
+}
+
+// slabs in box space, the box is rotated by the inverse of its quaternion like every
+// primitive, see Compiled_Rotation
+static bool ref_box(glm::vec3 ro, glm::vec3 rd, const raytBox& box, float& t)
+{
+	glm::quat q = glm::normalize(box.quat_rotation);
+	glm::vec3 o = q * (ro - box.pos), d = q * rd;
+	float tnear = -FLT_MAX, tfar = FLT_MAX;
+	for (int a = 0; a < 3; a++)
+	{
+		float t1 = (-box.form[a] - o[a]) / d[a], t2 = (box.form[a] - o[a]) / d[a];
+		tnear = max(tnear, min(t1, t2));
+		tfar = min(tfar, max(t1, t2));
+	}
+	t = tnear;
+	return tnear <= tfar && tnear > 0;
+}
+
+// Moller-Trumbore in double precision
+static bool ref_triangle(glm::vec3 ro, glm::vec3 rd, glm::vec3 a, glm::vec3 b, glm::vec3 c, float& t)
+{
+	glm::dvec3 o(ro), d(rd), v0(a), e1 = glm::dvec3(b) - v0, e2 = glm::dvec3(c) - v0;
+	glm::dvec3 p = glm::cross(d, e2);
+	double det = glm::dot(e1, p);
+	if (fabs(det) < 1e-12)
+		return false;
+	glm::dvec3 s = o - v0;
+	double u = glm::dot(s, p) / det;
+	glm::dvec3 q = glm::cross(s, e1);
+	double v = glm::dot(d, q) / det;
+	if (u < 0 || v < 0 || u + v > 1)
+		return false;
+	t = static_cast<float>(glm::dot(e2, q) / det);
+	return t > 0;
+}
+
+static Mesh random_mesh(int triangles)
+{
+	Mesh mesh;
+	for (int i = 0; i < triangles; i++)
+	{
+		glm::vec3 center = random_vec3(-4, 4);
+		for (int v = 0; v < 3; v++)
+			mesh.vertices.push_back(glm::vec4(center + random_vec3(-1, 1), 1));
+		mesh.triangles.push_back({ 3 * i, 3 * i + 1, 3 * i + 2, 0 });
+	}
+	mesh.build_bvh();
+	return mesh;
+}
+
+// the closest of the hits, within a relative tolerance for the float paths
+static bool same_hit(bool hit, float t, bool refHit, float refT)
+{
+	return hit == refHit && (!hit || fabs(t - refT) <= 1e-3f * max(1.0f, refT));
+}
+
+static void test_surface_beyond_light()
+{
+	// the plane z = 10, its quadratic terms vanish for every ray
+	sceneContainer scene = {};
+	Scene_Builder build(scene);
+	raytSurface plane = {};
+	plane.d = 1;
+	plane.f = -10;
+	build.surface(plane);
+	Scene_Geometry geometry;
+	geometry.build(scene, DIRTY_ALL);
+
+	glm::vec3 ro(0), rd(0, 0, 1);
+	int num = -1, type = -1;
+	glm::vec3 normal;
+	float t = geometry.intersect(scene, ro, rd, num, type, normal);
+	check(type == HIT_SURFACE && fabs(t - 10) < 1e-4f, "a ray hits the plane surface at its distance");
+	check(!geometry.occluded(scene, ro, rd, 5), "a surface beyond the light casts no shadow");
+	check(geometry.occluded(scene, ro, rd, 20), "a surface before the light casts a shadow");
+	check(!geometry.occluded(scene, ro, -rd, 20), "a surface behind the ray casts no shadow");
+}
+
+static void test_scene_intersect()
+{
+	sceneContainer scene = {};
+	Scene_Builder build(scene);
+	materialHandle material = build.material({ 1, 1, 1 }, 0, 0);
+	for (int i = 0; i < 20; i++)
+		build.sphere(random_vec3(-8, 8), uniform(0.3f, 2), material);
+	for (int i = 0; i < 20; i++)
+	{
+		boxHandle box = build.box(random_vec3(-8, 8), random_vec3(0.3f, 1.5f), material);
+		build.edit(box).quat_rotation = random_rotation();
+	}
+	Scene_Geometry geometry;
+	geometry.build(scene, DIRTY_ALL);
+
+	int wrong = 0, shadowWrong = 0, hits = 0;
+	for (int i = 0; i < 5000; i++)
+	{
+		glm::vec3 ro, rd;
+		random_ray(30, ro, rd);
+		bool refHit = false;
+		float refT = FLT_MAX, t;
+		for (const raytSphere& sphere : scene.spheres)
+			if (ref_sphere(ro, rd, glm::vec3(sphere.obj), sphere.obj.w, t) && t < refT)
+			{
+				refHit = true;
+				refT = t;
+			}
+		for (const raytBox& box : scene.boxes)
+			if (ref_box(ro, rd, box, t) && t < refT)
+			{
+				refHit = true;
+				refT = t;
+			}
+
+		int num, type;
+		glm::vec3 normal;
+		t = geometry.intersect(scene, ro, rd, num, type, normal);
+		bool hit = t < Scene_Geometry::Max_Dist;
+		hits += hit;
+		wrong += !same_hit(hit, t, refHit, refT);
+
+		// occluded() agrees with the closest hit, away from the hit itself
+		float dist = uniform(1, 60);
+		if (!hit || fabs(t - dist) > 1e-3f)
+			shadowWrong += geometry.occluded(scene, ro, rd, dist) != (hit && t < dist);
+	}
+	check(hits > 500, "the random rays hit the scene");
+	check(wrong == 0, "Scene_Geometry::intersect finds the closest sphere or box");
+	check(shadowWrong == 0, "Scene_Geometry::occluded agrees with the closest hit");
+}
+
+static void test_mesh()
+{
+	Mesh mesh = random_mesh(300);
+	check(mesh.valid(), "the built bvh is valid");
+
+	int wrong = 0, hits = 0;
+	for (int i = 0; i < 5000; i++)
+	{
+		glm::vec3 ro, rd;
+		random_ray(20, ro, rd);
+		bool refHit = false;
+		float refT = FLT_MAX, t;
+		for (const raytTriangle& tri : mesh.triangles)
+			if (ref_triangle(ro, rd, glm::vec3(mesh.vertices[tri.v0]), glm::vec3(mesh.vertices[tri.v1]), glm::vec3(mesh.vertices[tri.v2]), t) &&
+				t < refT)
+			{
+				refHit = true;
+				refT = t;
+			}
+
+		glm::vec3 normal;
+		bool hit = mesh.intersect(ro, rd, FLT_MAX, t, normal);
+		hits += hit;
+		wrong += !same_hit(hit, t, refHit, refT) || (hit && fabs(glm::length(normal) - 1) > 1e-4f);
+	}
+	check(hits > 500, "the random rays hit the mesh");
+	check(wrong == 0, "Mesh::intersect finds the closest triangle");
+}
+
+static void test_instances()
+{
+	sceneContainer scene = {};
+	Scene_Builder build(scene);
+	materialHandle material = build.material({ 1, 1, 1 }, 0, 0);
+	meshHandle mesh = build.mesh(random_mesh(60));
+	for (int i = 0; i < 12; i++)
+		build.mesh_instance(mesh, random_vec3(-10, 10), material, random_rotation());
+	Scene_Geometry geometry;
+	geometry.build(scene, DIRTY_ALL);
+
+	// every instance's triangles in world space
+	vector<glm::vec3> world;
+	vector<int> owner;
+	for (size_t i = 0; i < scene.mesh_instances.size(); i++)
+	{
+		const raytMeshInstance& instance = scene.mesh_instances[i];
+		glm::quat toWorld = glm::inverse(glm::normalize(instance.quat_rotation));
+		const Mesh& m = scene.mesh_data[instance.geometry];
+		for (const raytTriangle& tri : m.triangles)
+		{
+			for (int v : { tri.v0, tri.v1, tri.v2 })
+				world.push_back(toWorld * glm::vec3(m.vertices[v]) + instance.pos);
+			owner.push_back(static_cast<int>(i));
+		}
+	}
+
+	int wrong = 0, hits = 0;
+	for (int i = 0; i < 5000; i++)
+	{
+		glm::vec3 ro, rd;
+		random_ray(40, ro, rd);
+		bool refHit = false;
+		float refT = FLT_MAX, t;
+		int refOwner = -1;
+		for (size_t tri = 0; tri < owner.size(); tri++)
+			if (ref_triangle(ro, rd, world[tri * 3], world[tri * 3 + 1], world[tri * 3 + 2], t) && t < refT)
+			{
+				refHit = true;
+				refT = t;
+				refOwner = owner[tri];
+			}
+
+		int num, type;
+		glm::vec3 normal;
+		t = geometry.intersect(scene, ro, rd, num, type, normal);
+		bool hit = t < Scene_Geometry::Max_Dist;
+		hits += hit;
+		if (!same_hit(hit, t, refHit, refT))
+			wrong++;
+		else if (hit)
+		{
+			// the instance is reported in leaf order, its position tells which one it is
+			const raytMeshInstance& found = geometry.instance_tree.instances[num];
+			wrong += type != HIT_MESH || found.pos != scene.mesh_instances[refOwner].pos;
+		}
+	}
+	check(hits > 500, "the random rays hit the instances");
+	check(wrong == 0, "Instance_Tree::intersect finds the closest instance");
+}
+
+static void test_cpu_renderer()
+{
+	sceneContainer scene = {};
+	scene.scene.quat_camera_rotation = glm::quat(1, 0, 0, 0);
+	scene.scene.camera_pos = glm::vec3(0, 0, -5);
+	scene.scene.canvas_width = 48;
+	scene.scene.canvas_height = 32;
+	scene.scene.reflect_depth = 5;
+	scene.ambient_color = glm::vec3(0.1f);
+	scene.shadow_ambient = glm::vec3(0.2f);
+	Scene_Builder build(scene);
+	build.sphere({ 0, 0, 2 }, 1, build.material({ 1, 0, 0 }, 50, 0));
+	build.box({ 0, -1.5f, 2 }, { 4, 0.2f, 4 }, build.material({ 0.9f, 0.9f, 0.9f }, 0, 0.3f));
+	build.sphere({ 1.5f, 0.5f, 0.5f }, 0.5f, build.material({ 1, 1, 1 }, 100, 0.1f, 1.5f, { 0.1f, 0.1f, 0.1f }));
+	build.light_point({ 2, 3, -2, 0.1f }, { 1, 1, 1 }, 1);
+
+	Thread_Pool pool(2);
+	Cpu_Renderer renderer(pool);
+	renderer.update(scene, DIRTY_ALL);
+
+	int width = scene.scene.canvas_width, height = scene.scene.canvas_height;
+	vector<unsigned char> whole(width * height * 4);
+	renderer.render(scene, 0, 0, width, height, whole.data());
+
+	// the same canvas as four uneven tiles
+	vector<unsigned char> tiled(whole.size()), tile;
+	const int xs[] = { 0, 20, width }, ys[] = { 0, 13, height };
+	for (int i = 0; i < 2; i++)
+		for (int j = 0; j < 2; j++)
+		{
+			int w = xs[i + 1] - xs[i], h = ys[j + 1] - ys[j];
+			tile.resize(w * h * 4);
+			renderer.render(scene, xs[i], ys[j], w, h, tile.data());
+			for (int row = 0; row < h; row++)
+				copy(tile.begin() + row * w * 4, tile.begin() + (row + 1) * w * 4, tiled.begin() + ((ys[j] + row) * width + xs[i]) * 4);
+		}
+	check(whole == tiled, "Cpu_Renderer draws the same pixels whole and in tiles");
+
+	const unsigned char* center = &whole[((height / 2) * width + width / 2) * 4];
+	check(center[0] > 40 && center[1] < center[0] / 2 && center[2] < center[0] / 2 && center[3] == 255,
+		"the pixel at the center shows the red sphere");
+	const unsigned char* corner = &whole[((height - 1) * width) * 4];
+	check(corner[0] == 0 && corner[1] == 0 && corner[2] == 0, "a pixel that misses everything is black");
+	check(Cpu_Renderer::ray_dir(scene.scene, width / 2.0f, height / 2.0f) == glm::vec3(0, 0, 1),
+		"the ray through the canvas center looks along the camera");
+}
+
+int main()
+{
+	test_surface_beyond_light();
+	test_scene_intersect();
+	test_mesh();
+	test_instances();
+	test_cpu_renderer();
+
+	if (failures == 0)
+		printf("All CPU render tests passed\n");
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,337 @@
+// Stress test for the lock-free containers and the job system: every test runs its
+// threads against each other for a number of rounds and checks that nothing was lost,
+// duplicated or seen torn. Meant to be run under -fsanitize=thread or address as well.
+//
+//   job_system_test [rounds]
+
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <memory>
+#include "WorkStealingDeque.h"
+#include "MpmcQueue.h"
+#include "SpscQueue.h"
+#include "TripleBuffer.h"
+#include "ObjectPool.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+static int failures = 0;
+
+static void check(bool ok, const char* what)
+{
+	if (!ok)
+	{
+		printf("FAILED: %s\n", what);
+		failures++;
+	}
+}
+
+// the owner pushes and pops at the bottom while thieves steal from the top, every item
+// is taken exactly once
+static void test_deque()
+{
+	const int Items = 100000, Thieves = 3;
+	static Work_Stealing_Deque<int, 1024> deque;
+	vector<int> values(Items);
+	vector<atomic<int>> taken(Items);
+	for (int i = 0; i < Items; i++)
+		values[i] = i;
+
+	atomic<bool> finished{ false };
+	vector<thread> thieves;
+	for (int t = 0; t < Thieves; t++)
+		thieves.emplace_back([&]
+		{
+			while (!finished.load())
+				if (int* item = deque.steal())
+					taken[*item]++;
+		});
+
+	for (int i = 0; i < Items; i++)
+	{
+		while (!deque.push(&values[i]))
+			if (int* item = deque.pop())
+				taken[*item]++;
+		if (i % 3 == 0)
+			if (int* item = deque.pop())
+				taken[*item]++;
+	}
+	while (int* item = deque.pop())
+		taken[*item]++;
+	finished = true;
+	for (thread& thief : thieves)
+		thief.join();
+
+	bool once = true;
+	for (int i = 0; i < Items; i++)
+		once = once && taken[i] == 1;
+	check(once, "Work_Stealing_Deque takes every item exactly once");
+}
+
+static void test_mpmc()
+{
+	const int Producers = 2, Consumers = 2, PerProducer = 100000;
+	static Mpmc_Queue<int, 256> queue;
+	vector<atomic<int>> taken(Producers * PerProducer);
+	atomic<int> consumed{ 0 };
+
+	vector<thread> threads;
+	for (int p = 0; p < Producers; p++)
+		threads.emplace_back([&, p]
+		{
+			for (int i = 0; i < PerProducer; i++)
+				while (!queue.push(p * PerProducer + i))
+					this_thread::yield();
+		});
+	for (int c = 0; c < Consumers; c++)
+		threads.emplace_back([&]
+		{
+			int value;
+			while (consumed.load() < Producers * PerProducer)
+				if (queue.pop(value))
+				{
+					taken[value]++;
+					consumed++;
+				}
+		});
+	for (thread& t : threads)
+		t.join();
+
+	bool once = true;
+	for (atomic<int>& count : taken)
+		once = once && count == 1;
+	check(once, "Mpmc_Queue delivers every value exactly once");
+}
+
+static void test_spsc()
+{
+	const int Values = 200000;
+	static Spsc_Queue<int, 64> queue;
+	bool ordered = true;
+	thread consumer([&]
+	{
+		int expected = 0, value;
+		while (expected < Values)
+			if (queue.pop(value))
+				ordered = ordered && value == expected++;
+	});
+	for (int i = 0; i < Values; i++)
+		while (!queue.push(i))
+			this_thread::yield();
+	consumer.join();
+	check(ordered, "Spsc_Queue delivers every value in order");
+}
+
+// the consumer never sees a value torn or older than one it saw before
+static void test_triple_buffer()
+{
+	struct value
+	{
+		int a = 0;
+		int b = 0;
+	};
+	const int Values = 200000;
+	static Triple_Buffer<value> buffer;
+	bool consistent = true;
+	atomic<bool> finished{ false };
+	thread consumer([&]
+	{
+		int last = 0;
+		while (!finished.load())
+			if (buffer.acquire())
+			{
+				const value& v = buffer.front();
+				consistent = consistent && v.b == -v.a && v.a >= last;
+				last = v.a;
+			}
+	});
+	for (int i = 1; i <= Values; i++)
+	{
+		buffer.back().a = i;
+		buffer.back().b = -i;
+		buffer.publish();
+	}
+	finished = true;
+	consumer.join();
+	check(consistent, "Triple_Buffer hands over whole values, newest last");
+}
+
+// no object is held by two threads at once
+static void test_object_pool()
+{
+	struct pooled
+	{
+		atomic<int> holders{ 0 };
+	};
+	const int Threads = 4, Rounds = 50000;
+	static Object_Pool<pooled, 16> pool;
+	atomic<bool> shared{ false };
+	vector<thread> threads;
+	for (int t = 0; t < Threads; t++)
+		threads.emplace_back([&]
+		{
+			for (int i = 0; i < Rounds; i++)
+			{
+				pooled* object = pool.acquire();
+				if (object->holders.fetch_add(1) != 0)
+					shared = true;
+				object->holders.fetch_sub(1);
+				pool.release(object);
+			}
+		});
+	for (thread& t : threads)
+		t.join();
+	check(!shared, "Object_Pool hands an object to one thread at a time");
+}
+
+// counters live on the heap only for the sanitizers to catch a touch after wait()
+static void test_counters(Thread_Pool& pool, int rounds)
+{
+	const int Jobs = 64, Nested = 4;
+	bool complete = true;
+	for (int round = 0; round < rounds; round++)
+	{
+		unique_ptr<Job_Counter> counter(new Job_Counter());
+		unique_ptr<atomic<int>> ran(new atomic<int>(0));
+		Job_Counter* c = counter.get();
+		atomic<int>* r = ran.get();
+		for (int i = 0; i < Jobs; i++)
+			pool.submit([&pool, c, r]
+			{
+				// submitted from a worker, onto its own deque, counted by the same counter
+				for (int j = 0; j < Nested; j++)
+					pool.submit([r] { (*r)++; }, c);
+				(*r)++;
+			}, c);
+		pool.wait(*counter);
+		complete = complete && *ran == Jobs * (Nested + 1);
+		counter.reset();
+		ran.reset();
+	}
+	check(complete, "Job_Counter wait returns once every counted job ran");
+
+	// waits on workers, for counters of their own
+	Job_Counter outer;
+	atomic<int> inner{ 0 };
+	for (int i = 0; i < Jobs; i++)
+		pool.submit([&pool, &inner]
+		{
+			Job_Counter counter;
+			for (int j = 0; j < Nested; j++)
+				pool.submit([&inner] { inner++; }, &counter);
+			pool.wait(counter);
+		}, &outer);
+	pool.wait(outer);
+	check(inner == Jobs * Nested, "Job_Counter waits nest on workers");
+}
+
+static void test_continuations(Thread_Pool& pool, int rounds)
+{
+	const int Jobs = 32, Stages = 4;
+	bool ordered = true, complete = true;
+	for (int round = 0; round < rounds; round++)
+	{
+		// each stage starts after the one before, its jobs find that one finished
+		Job_Counter stages[Stages];
+		atomic<int> ran[Stages];
+		atomic<bool> early{ false };
+		for (int stage = 0; stage < Stages; stage++)
+		{
+			ran[stage] = 0;
+			for (int i = 0; i < Jobs; i++)
+			{
+				auto job = [&ran, &early, stage]
+				{
+					if (stage > 0 && ran[stage - 1] != Jobs)
+						early = true;
+					ran[stage]++;
+				};
+				if (stage == 0)
+					pool.submit(job, &stages[0]);
+				else
+					pool.submit_after(stages[stage - 1], job, &stages[stage]);
+			}
+		}
+		pool.wait(stages[Stages - 1]);
+		ordered = ordered && !early;
+		for (int stage = 0; stage < Stages; stage++)
+			complete = complete && ran[stage] == Jobs;
+	}
+	check(ordered, "continuations start after every job of their dependency");
+	check(complete, "every continuation of a stage chain runs");
+
+	// the dependency goes as soon as its wait returns, while its last job may still be
+	// handing out continuations made from the jobs themselves and from this thread
+	bool released = true;
+	for (int round = 0; round < rounds; round++)
+	{
+		unique_ptr<Job_Counter> dependency(new Job_Counter());
+		Job_Counter after;
+		atomic<int> ran{ 0 };
+		Job_Counter* d = dependency.get();
+		for (int i = 0; i < Jobs; i++)
+		{
+			pool.submit([&pool, &ran, &after, d]
+			{
+				pool.submit_after(*d, [&ran] { ran++; }, &after);
+			}, d);
+			pool.submit_after(*d, [&ran] { ran++; }, &after);
+		}
+		pool.wait(*dependency);
+		dependency.reset();
+		pool.wait(after);
+		released = released && ran == 2 * Jobs;
+	}
+	check(released, "a counter destroyed right after its wait still hands out its continuations");
+
+	Job_Counter idle, counter;
+	atomic<int> ran{ 0 };
+	pool.submit_after(idle, [&ran] { ran++; }, &counter);
+	pool.wait(counter);
+	check(ran == 1, "a continuation of a counter at zero runs right away");
+}
+
+static void test_parallel_for(Thread_Pool& pool, int rounds)
+{
+	const size_t Count = 10000;
+	vector<int> hits(Count);
+	bool once = true;
+	for (int round = 0; round < rounds; round++)
+	{
+		pool.parallel_for(Count, 64, [&hits](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+				hits[i]++;
+		});
+		for (size_t i = 0; i < Count; i++)
+			once = once && hits[i] == round + 1;
+	}
+	check(once, "parallel_for runs every index exactly once");
+}
+
+int main(int argc, char** argv)
+{
+	int rounds = argc > 1 ? atoi(argv[1]) : 200;
+
+	test_deque();
+	test_mpmc();
+	test_spsc();
+	test_triple_buffer();
+	test_object_pool();
+	{
+		// at least two workers, so that jobs are stolen even on a single core
+		Thread_Pool pool(max(2, static_cast<int>(thread::hardware_concurrency()) - 1));
+		test_counters(pool, rounds);
+		test_continuations(pool, rounds);
+		test_parallel_for(pool, rounds);
+	}
+
+	if (failures == 0)
+		printf("All job system tests passed\n");
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,155 @@
+// Unit test for Slot_Map: handles follow their objects through removals, removed handles
+// stop resolving, freed slots come back with a new generation and sync() takes in objects
+// added or dropped behind the map's back.
+//
+//   slot_map_test
+
+#include <cstdio>
+#include <vector>
+#include "SlotMap.h"
+
+using namespace std;
+
+static int failures = 0;
+
+static void check(bool ok, const char* what)
+{
+	if (!ok)
+	{
+		printf("FAILED: %s\n", what);
+		failures++;
+	}
+}
+
+// an array kept dense the way Scene_Builder keeps it, each object holds its own tag
+struct trackedArray
+{
+	Slot_Map slots;
+	vector<int> objects;
+
+	int add(int tag)
+	{
+		objects.push_back(tag);
+		return slots.add();
+	}
+
+	bool remove(int slot, uint32_t generation)
+	{
+		size_t index, last;
+		if (!slots.remove(slot, generation, index, last))
+			return false;
+		objects[index] = objects[last];
+		objects.pop_back();
+		return true;
+	}
+};
+
+static void test_add()
+{
+	trackedArray array;
+	bool found = true;
+	for (int i = 0; i < 10; i++)
+	{
+		int slot = array.add(i);
+		found = found && slot == i && array.slots.generation_of(slot) == 0;
+	}
+	for (int i = 0; i < 10; i++)
+		found = found && array.slots.find(i, 0) == i && array.slots.slot_of(i) == i;
+	check(found, "add hands out slots in order, each finds its object");
+	check(array.slots.size() == 10, "size counts the objects");
+	check(array.slots.find(10, 0) == -1 && array.slots.find(-1, 0) == -1, "find of a slot never handed out is -1");
+	check(array.slots.find(3, 1) == -1, "find with a wrong generation is -1");
+}
+
+static void test_remove()
+{
+	trackedArray array;
+	for (int i = 0; i < 5; i++)
+		array.add(i);
+
+	// the last object moves into the removed one's place
+	check(array.remove(1, 0), "remove of a live handle");
+	check(array.slots.find(1, 0) == -1, "a removed handle does not resolve");
+	check(array.slots.find(4, 0) == 1 && array.objects[1] == 4, "the last object takes the removed one's index");
+	check(array.slots.slot_of(1) == 4, "slot_of follows the moved object");
+	check(!array.remove(1, 0), "a second remove of the same handle fails");
+
+	// removing the last object moves nothing
+	check(array.remove(3, 0), "remove of the last object");
+	bool unmoved = array.objects.size() == 3;
+	for (int slot : { 0, 2, 4 })
+	{
+		int index = array.slots.find(slot, 0);
+		unmoved = unmoved && index >= 0 && array.objects[index] == slot;
+	}
+	check(unmoved, "the other handles still find their objects");
+}
+
+static void test_reuse()
+{
+	trackedArray array;
+	for (int i = 0; i < 3; i++)
+		array.add(i);
+	array.remove(2, 0);
+	array.remove(0, 0);
+
+	// the free list hands out the last freed slot first, one generation on
+	int slot = array.add(10);
+	check(slot == 0 && array.slots.generation_of(slot) == 1, "a freed slot comes back with its generation bumped");
+	check(array.slots.find(0, 0) == -1, "the old handle to a reused slot does not resolve");
+	check(array.objects[array.slots.find(0, 1)] == 10, "the new handle finds the new object");
+	slot = array.add(11);
+	check(slot == 2 && array.slots.generation_of(slot) == 1, "the next freed slot comes back after it");
+	slot = array.add(12);
+	check(slot == 3 && array.slots.generation_of(slot) == 0, "new slots follow once the free list is empty");
+
+	bool found = true;
+	for (int round = 0; round < 100; round++)
+	{
+		int tag = array.objects[array.slots.find(1, 0)];
+		uint32_t generation = array.slots.generation_of(0);
+		array.remove(0, generation);
+		array.add(100 + round);
+		found = found && array.slots.generation_of(0) == generation + 1 && array.objects[array.slots.find(0, generation + 1)] == 100 + round
+			&& array.objects[array.slots.find(1, 0)] == tag;
+	}
+	check(found, "a slot removed and added again many times keeps counting up");
+}
+
+static void test_sync()
+{
+	trackedArray array;
+	for (int i = 0; i < 4; i++)
+		array.add(i);
+
+	// appended without add()
+	array.objects.push_back(4);
+	array.objects.push_back(5);
+	array.slots.sync(array.objects.size());
+	check(array.slots.size() == 6 && array.slots.find(5, 0) == 5, "sync gives appended objects slots");
+	check(array.slots.find(2, 0) == 2, "sync keeps the handles of the objects it had");
+
+	// a shorter array was replaced, the old handles are gone
+	array.remove(1, 0);
+	array.objects.resize(2);
+	array.slots.sync(array.objects.size());
+	check(array.slots.size() == 2, "sync after a shrink counts the objects left");
+	check(array.slots.find(0, 0) == 0 && array.slots.find(1, 0) == 1, "sync after a shrink starts over with new handles");
+	check(array.slots.find(2, 0) == -1 && array.slots.find(5, 0) == -1, "handles past the shrunk array do not resolve");
+	check(array.add(6) == 2, "slots are handed out in order again after a shrink");
+
+	array.slots.sync(array.objects.size());
+	check(array.slots.size() == 3, "sync of an unchanged array keeps it");
+}
+
+int main()
+{
+	test_add();
+	test_remove();
+	test_reuse();
+	test_sync();
+
+	if (failures == 0)
+		printf("All slot map tests passed\n");
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,318 @@
+// Offline texture cooking: decodes images once, builds the mip chain on the CPU
+// and writes .rtex files (see src/TextureFile.h) that the renderer uploads as is.
+//
+//   cook [--bc1 | --virtual] <output dir> <image>...
+//
+// Each <image> is written to <output dir>/<file name>.rtex. --bc1 block compresses
+// every level, 8 bytes per 4x4 block instead of 64, alpha is dropped.
+// --virtual writes <file name>.rvt instead, every level cut into bordered tiles
+// that the renderer streams in on demand.
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stb_image.h>
+#include "TextureFile.h"
+
+using namespace std;
+
+struct Image
+{
+	int width, height;
+	vector<unsigned char> rgba;
+};
+
+static Image downsample(const Image& src)
+{
+	Image dst;
+	dst.width = max(1, src.width / 2);
+	dst.height = max(1, src.height / 2);
+	dst.rgba.resize(static_cast<size_t>(dst.width) * dst.height * 4);
+	rtex_downsample(src.rgba.data(), src.width, src.height, dst.rgba.data());
+	return dst;
+}
+
+static uint16_t to_565(const int* c)
+{
+	return static_cast<uint16_t>(((c[0] * 31 + 127) / 255) << 11 | ((c[1] * 63 + 127) / 255) << 5 | ((c[2] * 31 + 127) / 255));
+}
+
+static void from_565(uint16_t v, int* c)
+{
+	c[0] = ((v >> 11) & 31) * 255 / 31;
+	c[1] = ((v >> 5) & 63) * 255 / 63;
+	c[2] = (v & 31) * 255 / 31;
+}
+
+// bounding box endpoints inset by 1/16, every texel snapped to the nearest of the four palette colors
+static void encode_bc1_block(const unsigned char block[16][4], unsigned char* out)
+{
+	int lo[3] = { 255, 255, 255 }, hi[3] = { 0, 0, 0 };
+	for (int i = 0; i < 16; i++)
+		for (int c = 0; c < 3; c++)
+		{
+			lo[c] = min(lo[c], static_cast<int>(block[i][c]));
+			hi[c] = max(hi[c], static_cast<int>(block[i][c]));
+		}
+	for (int c = 0; c < 3; c++)
+	{
+		int inset = (hi[c] - lo[c]) / 16;
+		lo[c] += inset;
+		hi[c] -= inset;
+	}
+
+	uint16_t c0 = to_565(hi), c1 = to_565(lo);
+	// c0 > c1 selects the four color mode
+	if (c0 < c1)
+		swap(c0, c1);
+
+	int palette[4][3];
+	from_565(c0, palette[0]);
+	from_565(c1, palette[1]);
+	for (int c = 0; c < 3; c++)
+	{
+		palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+		palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+	}
+
+	uint32_t indices = 0;
+	if (c0 != c1)
+	{
+		for (int i = 0; i < 16; i++)
+		{
+			int best = 0, bestDist = 1 << 30;
+			for (int p = 0; p < 4; p++)
+			{
+				int dr = block[i][0] - palette[p][0], dg = block[i][1] - palette[p][1], db = block[i][2] - palette[p][2];
+				int dist = dr * dr + dg * dg + db * db;
+				if (dist < bestDist)
+				{
+					bestDist = dist;
+					best = p;
+				}
+			}
+			indices |= static_cast<uint32_t>(best) << (2 * i);
+		}
+	}
+
+	out[0] = c0 & 0xff; out[1] = c0 >> 8;
+	out[2] = c1 & 0xff; out[3] = c1 >> 8;
+	for (int i = 0; i < 4; i++)
+		out[4 + i] = (indices >> (8 * i)) & 0xff;
+}
+
+static vector<unsigned char> encode_bc1(const Image& image)
+{
+	int bw = (image.width + 3) / 4, bh = (image.height + 3) / 4;
+	vector<unsigned char> out(static_cast<size_t>(bw) * bh * 8);
+	unsigned char block[16][4];
+
+	for (int by = 0; by < bh; by++)
+		for (int bx = 0; bx < bw; bx++)
+		{
+			// blocks past the edge repeat the last texel
+			for (int i = 0; i < 16; i++)
+			{
+				int x = min(bx * 4 + i % 4, image.width - 1);
+				int y = min(by * 4 + i / 4, image.height - 1);
+				memcpy(block[i], &image.rgba[(y * image.width + x) * 4], 4);
+			}
+			encode_bc1_block(block, &out[(by * bw + bx) * 8]);
+		}
+	return out;
+}
+
+static bool load(const string& input, Image& image, int& components)
+{
+	unsigned char* pixels = stbi_load(input.c_str(), &image.width, &image.height, &components, 4);
+	if (!pixels)
+	{
+		fprintf(stderr, "cook: failed to load %s\n", input.c_str());
+		return false;
+	}
+	image.rgba.assign(pixels, pixels + static_cast<size_t>(image.width) * image.height * 4);
+	stbi_image_free(pixels);
+	return true;
+}
+
+static bool cook(const string& input, const string& output, bool bc1)
+{
+	Image image;
+	int components;
+	if (!load(input, image, components))
+		return false;
+	if (bc1 && components == 4)
+		printf("cook: %s has alpha, BC1 drops it\n", input.c_str());
+
+	vector<vector<unsigned char>> levels;
+	vector<rtexLevel> table;
+	while (true)
+	{
+		levels.push_back(bc1 ? encode_bc1(image) : image.rgba);
+		rtexLevel level = {};
+		level.size = levels.back().size();
+		level.width = image.width;
+		level.height = image.height;
+		table.push_back(level);
+		if (image.width == 1 && image.height == 1)
+			break;
+		image = downsample(image);
+	}
+
+	rtexHeader header = {};
+	header.magic = RTEX_MAGIC;
+	header.version = RTEX_VERSION;
+	header.format = bc1 ? RTEX_BC1 : RTEX_RGBA8;
+	header.width = table[0].width;
+	header.height = table[0].height;
+	header.levels = static_cast<uint32_t>(table.size());
+
+	uint64_t offset = sizeof(rtexHeader) + table.size() * sizeof(rtexLevel);
+	for (rtexLevel& level : table)
+	{
+		offset = (offset + 15) & ~static_cast<uint64_t>(15);
+		level.offset = offset;
+		offset += level.size;
+	}
+
+	FILE* file = fopen(output.c_str(), "wb");
+	if (!file)
+	{
+		fprintf(stderr, "cook: failed to write %s\n", output.c_str());
+		return false;
+	}
+	fwrite(&header, sizeof(header), 1, file);
+	fwrite(table.data(), sizeof(rtexLevel), table.size(), file);
+	const unsigned char zeros[16] = {};
+	for (size_t i = 0; i < levels.size(); i++)
+	{
+		long pad = static_cast<long>(table[i].offset) - ftell(file);
+		fwrite(zeros, 1, pad, file);
+		fwrite(levels[i].data(), 1, levels[i].size(), file);
+	}
+	bool ok = ferror(file) == 0;
+	fclose(file);
+
+	printf("cook: %s -> %s, %ux%u, %u levels, %s, %llu bytes\n", input.c_str(), output.c_str(), header.width, header.height,
+		header.levels, bc1 ? "bc1" : "rgba8", static_cast<unsigned long long>(offset));
+	return ok;
+}
+
+// one tile of one level with its border, texel coordinates wrap like GL_REPEAT
+static void cut_tile(const Image& image, int tileX, int tileY, int tile, int border, unsigned char* out)
+{
+	int page = tile + 2 * border;
+	for (int y = 0; y < page; y++)
+	{
+		int sy = ((tileY * tile + y - border) % image.height + image.height) % image.height;
+		for (int x = 0; x < page; x++)
+		{
+			int sx = ((tileX * tile + x - border) % image.width + image.width) % image.width;
+			memcpy(out + (static_cast<size_t>(y) * page + x) * 4, &image.rgba[(static_cast<size_t>(sy) * image.width + sx) * 4], 4);
+		}
+	}
+}
+
+static bool cook_virtual(const string& input, const string& output, int tile, int border)
+{
+	Image image;
+	int components;
+	if (!load(input, image, components))
+		return false;
+
+	FILE* file = fopen(output.c_str(), "wb");
+	if (!file)
+	{
+		fprintf(stderr, "cook: failed to write %s\n", output.c_str());
+		return false;
+	}
+
+	rvtHeader header = {};
+	header.magic = RVT_MAGIC;
+	header.version = RVT_VERSION;
+	header.width = image.width;
+	header.height = image.height;
+	header.tile = tile;
+	header.border = border;
+	for (int w = image.width, h = image.height; ; w = max(1, w / 2), h = max(1, h / 2))
+	{
+		header.levels++;
+		if (w == 1 && h == 1)
+			break;
+	}
+
+	vector<rvtLevel> table(header.levels);
+	uint64_t offset = sizeof(rvtHeader) + table.size() * sizeof(rvtLevel);
+	offset = (offset + 15) & ~static_cast<uint64_t>(15);
+	for (int w = image.width, h = image.height, i = 0; i < static_cast<int>(header.levels); w = max(1, w / 2), h = max(1, h / 2), i++)
+	{
+		rvtLevel& level = table[i];
+		level.offset = offset;
+		level.width = w;
+		level.height = h;
+		level.tilesX = (w + tile - 1) / tile;
+		level.tilesY = (h + tile - 1) / tile;
+		offset += static_cast<uint64_t>(level.tilesX) * level.tilesY * rvt_tile_bytes(header);
+	}
+
+	// levels are written as they are built, only one of them is in memory at a time
+	fwrite(&header, sizeof(header), 1, file);
+	fwrite(table.data(), sizeof(rvtLevel), table.size(), file);
+	const unsigned char zeros[16] = {};
+	fwrite(zeros, 1, static_cast<long>(table[0].offset) - ftell(file), file);
+	vector<unsigned char> tileData(rvt_tile_bytes(header));
+	for (size_t i = 0; i < table.size(); i++)
+	{
+		if (i > 0)
+			image = downsample(image);
+		for (uint32_t y = 0; y < table[i].tilesY; y++)
+			for (uint32_t x = 0; x < table[i].tilesX; x++)
+			{
+				cut_tile(image, x, y, tile, border, tileData.data());
+				fwrite(tileData.data(), 1, tileData.size(), file);
+			}
+	}
+	bool ok = ferror(file) == 0;
+	fclose(file);
+
+	printf("cook: %s -> %s, %ux%u, %u levels, %dpx tiles, %llu bytes\n", input.c_str(), output.c_str(), header.width, header.height,
+		header.levels, tile, static_cast<unsigned long long>(offset));
+	return ok;
+}
+
+int main(int argc, char** argv)
+{
+	bool bc1 = false, virtualTexture = false;
+	int arg = 1;
+	if (arg < argc && strcmp(argv[arg], "--bc1") == 0)
+	{
+		bc1 = true;
+		arg++;
+	}
+	else if (arg < argc && strcmp(argv[arg], "--virtual") == 0)
+	{
+		virtualTexture = true;
+		arg++;
+	}
+	if (argc - arg < 2)
+	{
+		fprintf(stderr, "usage: cook [--bc1 | --virtual] <output dir> <image>...\n");
+		return 1;
+	}
+
+	string outputDir = argv[arg++];
+	int failed = 0;
+	for (; arg < argc; arg++)
+	{
+		string input = argv[arg];
+		size_t slash = input.find_last_of("/\\");
+		string name = slash == string::npos ? input : input.substr(slash + 1);
+		bool ok = virtualTexture ? cook_virtual(input, outputDir + "/" + name + ".rvt", 128, 4)
+			: cook(input, outputDir + "/" + name + ".rtex", bc1);
+		if (!ok)
+			failed++;
+	}
+	return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,182 @@
+// Asset packing: bundles directories into one .rpak file (see src/PackFile.h) that the
+// renderer maps once instead of opening every shader and texture on its own.
+//
+//   pack <output.rpak> <prefix>=<dir>...
+//
+// Every file under <dir>, recursively, is stored as <prefix>/<path relative to dir>,
+// so "shaders=assets/shaders" stores assets/shaders/fshader.fs as "shaders/fshader.fs".
+// Hidden files and other .rpak files are skipped.
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "PackFile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+using namespace std;
+
+struct Input
+{
+	string name;
+	string path;
+};
+
+static bool skipped(const string& file)
+{
+	return file.empty() || file[0] == '.' || (file.size() > 5 && file.compare(file.size() - 5, 5, ".rpak") == 0);
+}
+
+#ifdef _WIN32
+
+static void walk(const string& dir, const string& name, vector<Input>& inputs)
+{
+	WIN32_FIND_DATAA found;
+	HANDLE search = FindFirstFileA((dir + "\\*").c_str(), &found);
+	if (search == INVALID_HANDLE_VALUE)
+		return;
+	do
+	{
+		string file = found.cFileName;
+		if (skipped(file))
+			continue;
+		if (found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+			walk(dir + "\\" + file, name + "/" + file, inputs);
+		else
+			inputs.push_back({ name + "/" + file, dir + "\\" + file });
+	} while (FindNextFileA(search, &found));
+	FindClose(search);
+}
+
+#else
+
+static void walk(const string& dir, const string& name, vector<Input>& inputs)
+{
+	DIR* d = opendir(dir.c_str());
+	if (!d)
+		return;
+	while (dirent* e = readdir(d))
+	{
+		string file = e->d_name;
+		if (skipped(file))
+			continue;
+		string path = dir + "/" + file;
+		struct stat info;
+		if (stat(path.c_str(), &info) != 0)
+			continue;
+		if (S_ISDIR(info.st_mode))
+			walk(path, name + "/" + file, inputs);
+		else if (S_ISREG(info.st_mode))
+			inputs.push_back({ name + "/" + file, path });
+	}
+	closedir(d);
+}
+
+#endif
+
+static bool read_file(const string& path, vector<unsigned char>& bytes)
+{
+	FILE* file = fopen(path.c_str(), "rb");
+	if (!file)
+		return false;
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	bytes.resize(size > 0 ? size : 0);
+	bool ok = size >= 0 && fread(bytes.data(), 1, bytes.size(), file) == bytes.size();
+	fclose(file);
+	return ok;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		fprintf(stderr, "usage: pack <output.rpak> <prefix>=<dir>...\n");
+		return 1;
+	}
+
+	vector<Input> inputs;
+	for (int arg = 2; arg < argc; arg++)
+	{
+		string mount = argv[arg];
+		size_t equals = mount.find('=');
+		if (equals == string::npos || equals == 0)
+		{
+			fprintf(stderr, "pack: expected <prefix>=<dir>, got '%s'\n", argv[arg]);
+			return 1;
+		}
+		size_t before = inputs.size();
+		walk(mount.substr(equals + 1), mount.substr(0, equals), inputs);
+		if (inputs.size() == before)
+			fprintf(stderr, "pack: no files in %s\n", mount.substr(equals + 1).c_str());
+	}
+
+	sort(inputs.begin(), inputs.end(), [](const Input& a, const Input& b) { return a.name < b.name; });
+	for (size_t i = 0; i < inputs.size(); i++)
+	{
+		if (inputs[i].name.size() >= sizeof(rpakEntry::name))
+		{
+			fprintf(stderr, "pack: name too long: %s\n", inputs[i].name.c_str());
+			return 1;
+		}
+		if (i > 0 && inputs[i].name == inputs[i - 1].name)
+		{
+			fprintf(stderr, "pack: %s and %s have the same name %s\n", inputs[i - 1].path.c_str(), inputs[i].path.c_str(),
+				inputs[i].name.c_str());
+			return 1;
+		}
+	}
+
+	rpakHeader header = { RPAK_MAGIC, RPAK_VERSION, static_cast<uint32_t>(inputs.size()), 0 };
+	vector<rpakEntry> entries(inputs.size());
+	vector<vector<unsigned char>> contents(inputs.size());
+	uint64_t offset = sizeof(rpakHeader) + entries.size() * sizeof(rpakEntry);
+	for (size_t i = 0; i < inputs.size(); i++)
+	{
+		if (!read_file(inputs[i].path, contents[i]))
+		{
+			fprintf(stderr, "pack: failed to read %s\n", inputs[i].path.c_str());
+			return 1;
+		}
+		offset = (offset + 15) & ~15ull;
+		entries[i].offset = offset;
+		entries[i].size = contents[i].size();
+		strcpy(entries[i].name, inputs[i].name.c_str());
+		offset += contents[i].size();
+	}
+
+	FILE* file = fopen(argv[1], "wb");
+	if (!file)
+	{
+		fprintf(stderr, "pack: failed to write %s\n", argv[1]);
+		return 1;
+	}
+	fwrite(&header, sizeof(header), 1, file);
+	fwrite(entries.data(), sizeof(rpakEntry), entries.size(), file);
+	uint64_t written = sizeof(rpakHeader) + entries.size() * sizeof(rpakEntry);
+	const unsigned char zeros[16] = {};
+	for (size_t i = 0; i < inputs.size(); i++)
+	{
+		fwrite(zeros, 1, static_cast<size_t>(entries[i].offset - written), file);
+		fwrite(contents[i].data(), 1, contents[i].size(), file);
+		written = entries[i].offset + entries[i].size;
+	}
+	bool ok = ferror(file) == 0;
+	ok = fclose(file) == 0 && ok;
+	if (!ok)
+	{
+		fprintf(stderr, "pack: failed to write %s\n", argv[1]);
+		return 1;
+	}
+
+	printf("pack: %zu files, %llu bytes -> %s\n", inputs.size(), static_cast<unsigned long long>(written), argv[1]);
+	return 0;
+}
@@ -0,0 +1,125 @@
+// Load time benchmark for large scenes: generates a scene of <objects> spheres, boxes
+// and mesh instances, writes it as text and as .rscn into <dir>, then times parsing
+// the text against mapping the binary file.
+//
+//   scene_bench [objects] [dir]
+//
+// Defaults to a million objects in the current directory. The binary load is run a
+// few times and the best is reported, the first run may include reading from disk.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <chrono>
+#include <string>
+#include <algorithm>
+#include "SceneText.h"
+#include "SceneFile.h"
+
+using namespace std;
+
+static double elapsed_ms(chrono::steady_clock::time_point since)
+{
+	return chrono::duration<double, milli>(chrono::steady_clock::now() - since).count();
+}
+
+static long file_bytes(const string& path)
+{
+	FILE* file = fopen(path.c_str(), "rb");
+	if (!file)
+		return 0;
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fclose(file);
+	return size;
+}
+
+static bool generate(const string& dir, long objects)
+{
+	FILE* obj = fopen((dir + "/bench_tetrahedron.obj").c_str(), "w");
+	FILE* file = fopen((dir + "/bench.scene").c_str(), "w");
+	if (!obj || !file)
+	{
+		if (obj)
+			fclose(obj);
+		if (file)
+			fclose(file);
+		return false;
+	}
+	fprintf(obj, "v 1 1 1\nv -1 -1 1\nv -1 1 -1\nv 1 -1 -1\nf 1 2 3\nf 1 4 2\nf 1 3 4\nf 2 4 3\n");
+	fclose(obj);
+
+	fprintf(file, "settings camera 0 0 -5\n");
+	fprintf(file, "light_point pos 3 5 0 color 1 1 1 intensity 25\n");
+	fprintf(file, "mesh tetrahedron bench_tetrahedron.obj\n");
+	for (int i = 0; i < 16; i++)
+		fprintf(file, "material m%d color %g %g %g specular %d reflect %g\n", i, (i & 1) * 0.8 + 0.1, (i >> 1 & 1) * 0.8 + 0.1,
+			(i >> 2 & 1) * 0.8 + 0.1, 10 + i * 10, (i >> 3) * 0.2);
+
+	// half spheres, a quarter each boxes and mesh instances on a grid
+	int side = static_cast<int>(cbrt(static_cast<double>(objects))) + 1;
+	for (long i = 0; i < objects; i++)
+	{
+		float x = static_cast<float>(i % side) * 3, y = static_cast<float>(i / side % side) * 3, z = static_cast<float>(i / side / side) * 3;
+		int material = static_cast<int>(i % 16);
+		switch (i % 4)
+		{
+		case 0:
+		case 1:
+			fprintf(file, "sphere pos %g %g %g radius 1 material m%d\n", x, y, z, material);
+			break;
+		case 2:
+			fprintf(file, "box pos %g %g %g size 1 0.5 1 rotation 0 %ld 0 material m%d\n", x, y, z, i % 360, material);
+			break;
+		case 3:
+			fprintf(file, "instance tetrahedron pos %g %g %g rotation %ld 0 0 material m%d\n", x, y, z, i % 360, material);
+			break;
+		}
+	}
+	bool ok = ferror(file) == 0;
+	fclose(file);
+	return ok;
+}
+
+int main(int argc, char** argv)
+{
+	long objects = argc > 1 ? atol(argv[1]) : 1000000;
+	string dir = argc > 2 ? argv[2] : ".";
+	string text = dir + "/bench.scene", binary = dir + "/bench.rscn";
+
+	printf("scene_bench: generating %ld objects\n", objects);
+	if (objects <= 0 || !generate(dir, objects))
+	{
+		fprintf(stderr, "scene_bench: failed to write %s\n", text.c_str());
+		return 1;
+	}
+
+	sceneContainer scene = {};
+	auto start = chrono::steady_clock::now();
+	if (!parse_scene_text(text.c_str(), scene))
+		return 1;
+	double parseMs = elapsed_ms(start);
+	if (!save_scene(binary.c_str(), scene))
+	{
+		fprintf(stderr, "scene_bench: failed to write %s\n", binary.c_str());
+		return 1;
+	}
+
+	double loadMs = 1e30;
+	for (int run = 0; run < 3; run++)
+	{
+		sceneContainer loaded = {};
+		start = chrono::steady_clock::now();
+		if (!load_scene(binary.c_str(), loaded))
+			return 1;
+		loadMs = min(loadMs, elapsed_ms(start));
+	}
+
+	long textBytes = file_bytes(text), binaryBytes = file_bytes(binary);
+	printf("scene_bench: %ld objects\n", objects);
+	printf("  text   %10ld bytes, parsed in %9.1f ms, %6.1f M objects/s\n", textBytes, parseMs, objects / parseMs / 1e3);
+	printf("  binary %10ld bytes, loaded in %9.1f ms, %6.1f M objects/s, %.1f GB/s\n", binaryBytes, loadMs, objects / loadMs / 1e3,
+		binaryBytes / loadMs / 1e6);
+	printf("  %.0fx faster\n", parseMs / loadMs);
+	return 0;
+}
@@ -0,0 +1,28 @@
+// Converts a text scene description (see src/SceneText.h) into a binary .rscn file
+// (see src/SceneFile.h) that rt maps and uploads without parsing.
+//
+//   scene_convert <input scene> <output .rscn>
+
+#include <cstdio>
+#include "SceneText.h"
+#include "SceneFile.h"
+
+int main(int argc, char** argv)
+{
+	if (argc != 3)
+	{
+		fprintf(stderr, "usage: scene_convert <input scene> <output .rscn>\n");
+		return 1;
+	}
+
+	sceneContainer scene = {};
+	if (!parse_scene_text(argv[1], scene))
+		return 1;
+	if (!save_scene(argv[2], scene))
+	{
+		fprintf(stderr, "scene_convert: failed to write %s\n", argv[2]);
+		return 1;
+	}
+	printf("scene_convert: %s -> %s\n", argv[1], argv[2]);
+	return 0;
+}